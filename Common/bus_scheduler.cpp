@@ -0,0 +1,361 @@
+/* cooperative scheduler of one i2c bus */
+#include "bus_scheduler.h"																						// own header file
+#include "bus_trace.h"																							// the bus thread traces the transfers
+
+BusScheduler::BusScheduler(HAL *_hal){
+	BusScheduler::_hal = _hal;
+	for (int i = 0; i < BUS_SCHEDULER_DEVICES; i++){
+		BusScheduler::_devices[i].handle = -1;																	// all slots are free
+	}
+	BusScheduler::_thread = std::thread(&BusScheduler::Run, this);
+}
+
+BusScheduler::~BusScheduler(){
+	{
+		std::lock_guard<std::mutex> lock(BusScheduler::_lock);
+		BusScheduler::_stop = true;																				// the bus thread ends, when all jobs are sent
+	}
+	BusScheduler::_wake.notify_all();
+	BusScheduler::_thread.join();
+}
+
+int BusScheduler::Attach(int _handle, unsigned _addr, int _merge){
+	std::lock_guard<std::mutex> lock(BusScheduler::_lock);
+	device *dev = BusScheduler::Find(_handle);
+
+	if (dev == NULL){																							// new device: take a free slot
+		for (int i = 0; i < BUS_SCHEDULER_DEVICES && dev == NULL; i++){
+			if (BusScheduler::_devices[i].handle < 0){
+				dev = &BusScheduler::_devices[i];
+			}
+		}
+		if (dev == NULL){
+			return -1;
+		}
+		dev->handle = _handle;
+		dev->i2c = _handle;
+		dev->generation = BusScheduler::_hal->I2C_Generation(_handle);
+		dev->ready_at = BusScheduler::_hal->Tick();
+		dev->busy = false;
+		dev->errors = 0;
+		dev->recovered = 0;
+		dev->error = 0;
+	}
+	dev->addr = _addr;
+	dev->merge = _merge;
+	return 0;
+}
+
+int BusScheduler::Detach(int _handle){
+	std::unique_lock<std::mutex> lock(BusScheduler::_lock);
+	device *dev = BusScheduler::Find(_handle);
+
+	if (dev != NULL){
+		BusScheduler::_done.wait(lock, [dev]{ return dev->queue.empty() && dev->busy == false; });		// send the rest first
+		dev->handle = -1;
+		_handle = dev->i2c;
+	}
+	return _handle;
+}
+
+int BusScheduler::Write(int _handle, int _reg, const uint8_t _data[], unsigned _count, int _priority){
+	std::lock_guard<std::mutex> lock(BusScheduler::_lock);
+	device *dev = BusScheduler::Find(_handle);
+
+	if (dev == NULL){
+		return -1;
+	}
+	if (_count > HAL_BLOCK_MAX){
+		_count = HAL_BLOCK_MAX;
+	}
+
+	if (dev->queue.empty() == false && _reg != BUS_REG_NONE){												// try to continue the last queued write
+		job &last = dev->queue.back();
+		bool next = (dev->merge == BUS_MERGE_SAME && _reg == last.reg) || (dev->merge == BUS_MERGE_NEXT && _reg == last.reg + (int)last.count);
+		if (next && last.reg != BUS_REG_NONE && last.read == false && last.pause == 0 && last.priority == _priority && last.count + _count <= HAL_BLOCK_MAX){
+			for (unsigned i = 0; i < _count; i++){
+				last.data[last.count++] = _data[i];
+			}
+			BusScheduler::_merged++;
+			return 1;																							// the bus thread is woken up by the first part already
+		}
+	}
+
+	job j;
+	j.reg = _reg;
+	j.count = _count;
+	j.pause = 0;
+	j.priority = _priority;
+	j.read = false;
+	for (unsigned i = 0; i < _count; i++){
+		j.data[i] = _data[i];
+	}
+	dev->queue.push_back(j);
+	BusScheduler::_wake.notify_one();
+	return 0;
+}
+
+void BusScheduler::Pause(int _handle, uint32_t _us){
+	std::lock_guard<std::mutex> lock(BusScheduler::_lock);
+	device *dev = BusScheduler::Find(_handle);
+
+	if (dev == NULL){
+		return;
+	}
+	if (dev->queue.empty() == false){
+		dev->queue.back().pause += _us;																			// after the last queued job
+	}
+	else {
+		uint32_t until = BusScheduler::_hal->Tick() + _us;														// from now on
+		if ((int32_t)(until - dev->ready_at) > 0){
+			dev->ready_at = until;
+		}
+	}
+}
+
+int BusScheduler::Read(int _handle, uint8_t _reg){
+	return BusScheduler::Read(_handle, _reg, NULL, 1);
+}
+
+int BusScheduler::Read(int _handle, uint8_t _reg, uint8_t _data[], unsigned _count){
+	std::unique_lock<std::mutex> lock(BusScheduler::_lock);
+	device *dev = BusScheduler::Find(_handle);
+	int value = -1;
+	bool done = false;
+
+	if (dev == NULL){
+		return -1;
+	}
+	if (_count > HAL_BLOCK_MAX){
+		_count = HAL_BLOCK_MAX;
+	}
+	job j;
+	j.reg = _reg;
+	j.count = _count;
+	j.pause = 0;
+	j.priority = BUS_PRIO_HIGH;																					// the caller waits
+	j.read = true;
+	j.dest = _data;
+	j.result = &value;
+	j.done = &done;
+	dev->queue.push_back(j);																					// after the queued writes: the read sees them
+	BusScheduler::_wake.notify_one();
+	BusScheduler::_done.wait(lock, [&done]{ return done; });													// the bus thread reads it
+	return value;
+}
+
+int BusScheduler::Wait(int _handle){
+	std::unique_lock<std::mutex> lock(BusScheduler::_lock);
+	device *dev = BusScheduler::Find(_handle);
+	int error = 0;
+
+	if (dev != NULL){
+		BusScheduler::_done.wait(lock, [dev]{ return dev->queue.empty() && dev->busy == false; });
+		error = dev->error;																						// reported once
+		dev->error = 0;
+	}
+	return error;
+}
+
+int BusScheduler::Flush(){
+	std::unique_lock<std::mutex> lock(BusScheduler::_lock);
+	int error = 0;
+
+	BusScheduler::_done.wait(lock, [this]{
+		for (int i = 0; i < BUS_SCHEDULER_DEVICES; i++){
+			if (BusScheduler::_devices[i].handle >= 0 && (BusScheduler::_devices[i].queue.empty() == false || BusScheduler::_devices[i].busy)){
+				return false;
+			}
+		}
+		return true;
+	});
+	for (int i = 0; i < BUS_SCHEDULER_DEVICES; i++){
+		device &dev = BusScheduler::_devices[i];
+		if (dev.handle >= 0 && dev.error < 0){
+			if (error == 0){
+				error = dev.error;
+			}
+			dev.error = 0;
+		}
+	}
+	return error;
+}
+
+unsigned BusScheduler::Errors(int _handle){
+	std::lock_guard<std::mutex> lock(BusScheduler::_lock);
+	device *dev = BusScheduler::Find(_handle);
+
+	return dev != NULL ? dev->errors : 0;
+}
+
+unsigned BusScheduler::Recovered(int _handle){
+	std::lock_guard<std::mutex> lock(BusScheduler::_lock);
+	device *dev = BusScheduler::Find(_handle);
+
+	return dev != NULL ? dev->recovered : 0;
+}
+
+unsigned BusScheduler::Transfers(){
+	std::lock_guard<std::mutex> lock(BusScheduler::_lock);
+	return BusScheduler::_transfers;
+}
+
+unsigned BusScheduler::Merged(){
+	std::lock_guard<std::mutex> lock(BusScheduler::_lock);
+	return BusScheduler::_merged;
+}
+
+unsigned BusScheduler::Pending(){
+	std::lock_guard<std::mutex> lock(BusScheduler::_lock);
+	unsigned count = 0;
+	for (int i = 0; i < BUS_SCHEDULER_DEVICES; i++){
+		if (BusScheduler::_devices[i].handle >= 0){
+			count += BusScheduler::_devices[i].queue.size();
+		}
+	}
+	return count;
+}
+
+void BusScheduler::Run(){
+	std::unique_lock<std::mutex> lock(BusScheduler::_lock);
+
+	while (true){
+		uint32_t now = BusScheduler::_hal->Tick();
+		uint32_t wait = BUS_SCHEDULER_SLICE;
+		bool paused = false;															// a device has jobs, but is paused
+		int best = -1;
+
+		for (int k = 1; k <= BUS_SCHEDULER_DEVICES; k++){							// start after the last device: round robin
+			int i = (BusScheduler::_last + k) % BUS_SCHEDULER_DEVICES;
+			device &dev = BusScheduler::_devices[i];
+
+			if (dev.handle < 0 || dev.queue.empty() || dev.busy){
+				continue;
+			}
+			if (BusScheduler::Ready(dev, now) == false){
+				paused = true;
+				if (dev.ready_at - now < wait){
+					wait = dev.ready_at - now;
+				}
+				continue;
+			}
+			if (best < 0 || dev.queue.front().priority < BusScheduler::_devices[best].queue.front().priority){
+				best = i;																// first one of the highest priority
+			}
+		}
+
+		if (best < 0){																	// nothing to send now
+			if (paused){
+				lock.unlock();
+				BusScheduler::_hal->Delay(wait);										// wait for the next device, but max one slice
+				lock.lock();
+			}
+			else if (BusScheduler::_stop){
+				break;																	// all jobs are sent
+			}
+			else {
+				BusScheduler::_wake.wait(lock);
+			}
+			continue;
+		}
+
+		device &dev = BusScheduler::_devices[best];
+		job j = dev.queue.front();
+		dev.queue.pop_front();
+		dev.busy = true;																// Detach / Read wait for it
+		BusScheduler::_last = best;
+		lock.unlock();
+
+		int status = BusScheduler::Send(dev, j);
+
+		lock.lock();
+		dev.busy = false;
+		BusScheduler::_transfers++;
+		if (j.read){																	// the caller of Read gets the status
+			*j.result = status;
+			*j.done = true;
+		}
+		else if (status < 0){															// the write is lost: the driver sees it by Errors, Wait and Flush report it
+			dev.errors++;
+			if (dev.error == 0){
+				dev.error = status;
+			}
+		}
+		if (j.pause > 0){
+			uint32_t until = BusScheduler::_hal->Tick() + j.pause;
+			if ((int32_t)(until - dev.ready_at) > 0){
+				dev.ready_at = until;
+			}
+		}
+		BusScheduler::_done.notify_all();
+	}
+}
+
+BusScheduler::device *BusScheduler::Find(int _handle){
+	for (int i = 0; i < BUS_SCHEDULER_DEVICES; i++){
+		if (BusScheduler::_devices[i].handle >= 0 && BusScheduler::_devices[i].handle == _handle){
+			return &BusScheduler::_devices[i];
+		}
+	}
+	return NULL;
+}
+
+bool BusScheduler::Ready(device &_dev, uint32_t _now){
+	return (int32_t)(_now - _dev.ready_at) >= 0;										// also right if the tick wraps around
+}
+
+int BusScheduler::Send(device &_dev, const job &_job){
+	uint8_t op = BUS_TRACE_BLOCK;
+
+	if (_job.read){																		// Read: one register or a block
+		return BusScheduler::Transfer(_dev, BUS_TRACE_READ, _job.reg, NULL, _job.dest, _job.count);
+	}
+	if (_job.reg == BUS_REG_NONE){														// single byte command
+		op = BUS_TRACE_COMMAND;
+	}
+	else if (_job.count == 1){
+		op = BUS_TRACE_WRITE;
+	}
+	return BusScheduler::Transfer(_dev, op, _job.reg, _job.data, NULL, _job.count);
+}
+
+int BusScheduler::Transfer(device &_dev, uint8_t _op, int _reg, const uint8_t _data[], uint8_t _read[], unsigned _count){
+	int status = -1;
+
+	for (int t = 0; t < HAL_I2C_RETRIES; t++){											// only the bus thread uses the device
+		if (t > 0){																		// bus glitch: wait and open the device again
+			BusScheduler::_hal->Delay(HAL_I2C_RETRY_US);
+			int handle = BusScheduler::_hal->I2C_Reopen(_dev.i2c, 1, _dev.addr, _dev.generation);
+			if (handle >= 0){
+				_dev.i2c = handle;
+			}
+		}
+		uint32_t start = BusTrace::Enabled() ? BusScheduler::_hal->Tick() : 0;
+		if (_op == BUS_TRACE_COMMAND){
+			status = BusScheduler::_hal->I2C_WriteByte(_dev.i2c, _data[0]);
+		}
+		else if (_op == BUS_TRACE_WRITE){
+			status = BusScheduler::_hal->I2C_WriteByteData(_dev.i2c, _reg, _data[0]);
+		}
+		else if (_op == BUS_TRACE_BLOCK){
+			status = BusScheduler::_hal->I2C_WriteBlockData(_dev.i2c, _reg, _data, _count);
+		}
+		else if (_read == NULL){														// one register
+			status = BusScheduler::_hal->I2C_ReadByteData(_dev.i2c, _reg);
+		}
+		else {
+			status = BusScheduler::_hal->I2C_ReadBlockData(_dev.i2c, _reg, _read, _count);
+		}
+		if (BusTrace::Enabled()){
+			BusTrace::Record(_dev.addr, _op, _op == BUS_TRACE_COMMAND ? 1 : _count + 1, status, start, BusScheduler::_hal->Tick());
+		}
+		if (status >= 0){
+			if (t > 0){
+				std::lock_guard<std::mutex> lock(BusScheduler::_lock);
+				_dev.recovered++;
+			}
+			return status;
+		}
+	}
+	return status;																		// given up: Run counts it as error of the device
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include "hal.h"														// the scheduler uses the bus by the HAL
+#include <inttypes.h>													// used for the int types like uint8_t
+#include <deque>														// queue of every device
+#include <thread>														// the bus thread
+#include <mutex>
+#include <condition_variable>
+
+#define BUS_SCHEDULER_DEVICES		8										// max count of devices on the scheduled bus
+#define BUS_SCHEDULER_SLICE			1000									// max µs the bus thread waits for a paused device, before it looks for new jobs
+#define BUS_REG_NONE				-1										// register of a job without register (single byte command)
+
+#define BUS_PRIO_HIGH				0										// priorities of the jobs, the lowest value is sent first
+#define BUS_PRIO_NORMAL				1
+#define BUS_PRIO_LOW				2
+
+#define BUS_MERGE_NONE				0										// device can't merge writes
+#define BUS_MERGE_SAME				1										// back-to-back writes to the same register are one block (MCP23008 with IOCON.SEQOP)
+#define BUS_MERGE_NEXT				2										// a write to the register after the last one continues the block (HT16K33 auto increment)
+
+class BusScheduler {
+	/* cooperative scheduler of one i2c bus, shared by the LCD and 7-segment driver.
+	 * The drivers queue their writes instead of sending them on the caller's thread.
+	 * One bus thread sends the jobs of all devices:
+	 *  - every device has its own queue, the jobs of one device keep their order
+	 *  - a device can be paused after a job (e.g. LCD clear or the delay of Print),
+	 *    the other devices are sent in the meantime
+	 *  - of all devices ready to send, the job with the highest priority goes first,
+	 *    devices with the same priority take turns (round robin)
+	 *  - a write, which continues the last queued write of the same device
+	 *    (see BUS_MERGE_*), is added to it and sent as one block transfer
+	 *  - a read is queued like a write and the caller waits for it, so only the
+	 *    bus thread uses the bus and the read sees the queued writes of the device
+	 *  - a failed transfer is tried again up to HAL_I2C_RETRIES times, the device
+	 *    is opened again before each retry (HAL::I2C_Reopen)
+	 *
+	 * The handle of Attach stays the id of the device, also when the bus thread
+	 * had to open the device again. While a driver is attached, all its transfers
+	 * go through the scheduler, Detach returns the handle to use afterwards.
+	 *
+	 * The drivers must leave the scheduler (Term / Scheduler(NULL)) before it is destroyed.
+	 *
+	*/
+public:
+	BusScheduler(HAL *_hal=HAL::Default());
+	/* start the bus thread, _hal is the backend of the bus
+	*/
+	virtual ~BusScheduler();
+	/* send all queued jobs and stop the bus thread
+	*/
+
+	int Attach(int _handle, unsigned _addr, int _merge);
+	/* schedule the device with the i2c _handle (of HAL::I2C_Open) and the address _addr (for the bus trace)
+	 * _merge = BUS_MERGE_NONE, BUS_MERGE_SAME or BUS_MERGE_NEXT
+	 *
+	 * return >= 0 = okay
+	 *        <  0 = no free device slot
+	 *
+	*/
+	int Detach(int _handle);
+	/* send the queued jobs of the device and remove it from the scheduler
+	 *
+	 * return the i2c handle of the device now (an other one, if it was opened again)
+	 *
+	*/
+	int Write(int _handle, int _reg, const uint8_t _data[], unsigned _count, int _priority);
+	/* queue a write of _count bytes (max HAL_BLOCK_MAX) to the register _reg,
+	 * _reg = BUS_REG_NONE sends _data[0] as single byte command
+	 *
+	 * return 1 = merged into the last queued write
+	 *        0 = queued as new job
+	 *      < 0 = device not attached
+	 *
+	*/
+	void Pause(int _handle, uint32_t _us);
+	/* the device gets no transfer for _us µs after the last queued job
+	*/
+	int Read(int _handle, uint8_t _reg);
+	/* queue a read of the register after the jobs of the device (with BUS_PRIO_HIGH, the caller
+	 * waits) and wait till the bus thread has read it
+	 *
+	 * return the register value or < 0 on error
+	 *
+	*/
+	int Read(int _handle, uint8_t _reg, uint8_t _data[], unsigned _count);
+	/* like Read, but _count bytes beginning at _reg in one transfer
+	 *
+	 * return the count of bytes read or < 0 on error
+	 *
+	*/
+	int Wait(int _handle);
+	/* wait till all jobs of the device are sent
+	 *
+	 * return 0 = okay
+	 *      < 0 = first error of a job of the device, which failed since the last Wait / Flush
+	 *
+	*/
+	int Flush();
+	/* wait till all jobs of all devices are sent
+	 *
+	 * return 0 = okay
+	 *      < 0 = first error of a job, which failed since the last Wait / Flush
+	 *
+	*/
+	unsigned Errors(int _handle);
+	/* return the count of failed jobs of the device since Attach. A driver, which sees it
+	 * grow, knows that a queued write didn't reach the chip (e.g. to invalidate its shadow copy)
+	*/
+	unsigned Recovered(int _handle);
+	/* return the count of transfers of the device since Attach, which worked after a retry
+	*/
+	unsigned Transfers();												// count of i2c transfers sent by the bus thread
+	unsigned Merged();													// count of writes merged into an other transfer
+	unsigned Pending();													// count of queued jobs
+
+private:
+	struct job {
+		int reg;
+		uint8_t data[HAL_BLOCK_MAX];
+		unsigned count;
+		uint32_t pause;													// µs the device waits after this job
+		int priority;
+		bool read;														// read of Read, the caller waits for it
+		uint8_t *dest;													// read: bytes of a block read, NULL = one register
+		int *result;													// read: status or register value for the caller
+		bool *done;														// read: set when the read was on the bus
+	};
+	struct device {
+		int handle;														// id of the device (handle of Attach), -1 = slot is free
+		int i2c;														// handle of the bus transfers, changed by a reopen
+		unsigned generation;											// reopens of the device known by the scheduler, see HAL::I2C_Reopen
+		unsigned addr;
+		int merge;
+		std::deque<job> queue;
+		uint32_t ready_at;												// HAL tick the device may get the next transfer
+		bool busy;														// a job or read of the device is on the bus
+		unsigned errors;												// failed jobs since Attach
+		unsigned recovered;												// transfers, which worked after a retry
+		int error;														// first error since the last Wait / Flush, 0 = none
+	};
+
+	void Run();															// the bus thread
+	device *Find(int _handle);											// attached device of the handle or NULL
+	bool Ready(device &_dev, uint32_t _now);							// true if the pause of the device is over
+	int Send(device &_dev, const job &_job);							// send one job on the bus
+	int Transfer(device &_dev, uint8_t _op, int _reg, const uint8_t _data[], uint8_t _read[], unsigned _count);	// one transfer (BUS_TRACE_*) with retries, return like the HAL
+
+	HAL *_hal;
+	std::mutex _lock;													// guards all values below
+	std::condition_variable _wake;										// new job or stop for the bus thread
+	std::condition_variable _done;										// a job was sent, for Wait / Read / Flush
+	device _devices[BUS_SCHEDULER_DEVICES];
+	int _last = 0;														// device of the last transfer (round robin)
+	bool _stop = false;
+	unsigned _transfers = 0;
+	unsigned _merged = 0;
+	std::thread _thread;
+};
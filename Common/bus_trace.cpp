@@ -0,0 +1,170 @@
+/* lock-free bus trace of the JoyPi drivers */
+#include "bus_trace.h"																							// own header file
+
+static const char *trace_ops[5] = {"write", "read", "block", "command", "sensor"};
+
+static struct {
+	std::atomic<unsigned> device;																				// device + 1, 0 = slot is free
+	std::atomic<uint32_t> transactions;
+	std::atomic<uint32_t> bytes;
+	std::atomic<uint32_t> errors;
+	std::atomic<uint64_t> latency_sum;
+	std::atomic<uint32_t> latency_max;
+	std::atomic<uint32_t> histogram[BUS_TRACE_BUCKETS];
+} trace_devices[BUS_TRACE_DEVICES];
+
+static struct {
+	std::atomic<uint32_t> seq;																					// index + 1 of the event, 0 while it is written
+	std::atomic<uint32_t> tick;
+	std::atomic<uint32_t> info;																					// device << 16 | op << 8 | bytes
+	std::atomic<int32_t> status;
+	std::atomic<uint32_t> latency;
+} trace_events[BUS_TRACE_EVENTS];
+
+static std::atomic<uint32_t> trace_head(0);																		// count of recorded events, next index to write
+
+std::atomic<bool> BusTrace::_enabled(false);
+
+void BusTrace::Enable(bool _on){
+	BusTrace::_enabled.store(_on, std::memory_order_relaxed);
+}
+
+static int trace_slot(unsigned _device, bool _claim){
+	for (int i = 0; i < BUS_TRACE_DEVICES; i++){
+		unsigned id = trace_devices[i].device.load(std::memory_order_acquire);
+		if (id == _device + 1){																					// device has a slot
+			return i;
+		}
+		if (id == 0){																							// slots are claimed in order, so the device has none
+			if (_claim == false){
+				return -1;
+			}
+			if (trace_devices[i].device.compare_exchange_strong(id, _device + 1, std::memory_order_acq_rel) || id == _device + 1){
+				return i;																						// claimed, or an other thread claimed it for the same device
+			}
+		}
+	}
+	return -1;																									// all slots used by other devices
+}
+
+void BusTrace::Record(unsigned _device, uint8_t _op, unsigned _bytes, int _status, uint32_t _start, uint32_t _end){
+	uint32_t latency = _end - _start;																			// also right if the tick wraps around
+	int slot = trace_slot(_device, true);
+
+	if (slot >= 0){
+		int bucket = 0;
+		while (bucket < BUS_TRACE_BUCKETS - 1 && (latency >> bucket) > 0){										// bucket n: latency < 2^n µs
+			bucket++;
+		}
+		trace_devices[slot].transactions.fetch_add(1, std::memory_order_relaxed);
+		trace_devices[slot].bytes.fetch_add(_bytes, std::memory_order_relaxed);
+		if (_status < 0){
+			trace_devices[slot].errors.fetch_add(1, std::memory_order_relaxed);
+		}
+		trace_devices[slot].latency_sum.fetch_add(latency, std::memory_order_relaxed);
+		trace_devices[slot].histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+		uint32_t max = trace_devices[slot].latency_max.load(std::memory_order_relaxed);
+		while (latency > max && !trace_devices[slot].latency_max.compare_exchange_weak(max, latency, std::memory_order_relaxed)){
+		}
+	}
+
+	uint32_t index = trace_head.fetch_add(1, std::memory_order_relaxed);										// own place in the ring buffer
+	auto &event = trace_events[index & (BUS_TRACE_EVENTS - 1)];
+	event.seq.store(0, std::memory_order_relaxed);																// mark as being written
+	std::atomic_thread_fence(std::memory_order_release);
+	event.tick.store(_start, std::memory_order_relaxed);
+	event.info.store((_device << 16) | ((uint32_t)_op << 8) | (_bytes > 0xFF ? 0xFF : _bytes), std::memory_order_relaxed);
+	event.status.store(_status, std::memory_order_relaxed);
+	event.latency.store(latency, std::memory_order_relaxed);
+	event.seq.store(index + 1, std::memory_order_release);														// publish the event
+}
+
+int BusTrace::Get(unsigned _device, BusTrace_counters &_counters){
+	int slot = trace_slot(_device, false);
+
+	if (slot < 0){
+		_counters = BusTrace_counters();
+		return 0;
+	}
+	_counters.transactions = trace_devices[slot].transactions.load(std::memory_order_relaxed);
+	_counters.bytes = trace_devices[slot].bytes.load(std::memory_order_relaxed);
+	_counters.errors = trace_devices[slot].errors.load(std::memory_order_relaxed);
+	_counters.latency_sum = trace_devices[slot].latency_sum.load(std::memory_order_relaxed);
+	_counters.latency_max = trace_devices[slot].latency_max.load(std::memory_order_relaxed);
+	for (int i = 0; i < BUS_TRACE_BUCKETS; i++){
+		_counters.histogram[i] = trace_devices[slot].histogram[i].load(std::memory_order_relaxed);
+	}
+	return 1;
+}
+
+void BusTrace::Reset(){
+	for (int i = 0; i < BUS_TRACE_DEVICES; i++){
+		trace_devices[i].transactions.store(0, std::memory_order_relaxed);
+		trace_devices[i].bytes.store(0, std::memory_order_relaxed);
+		trace_devices[i].errors.store(0, std::memory_order_relaxed);
+		trace_devices[i].latency_sum.store(0, std::memory_order_relaxed);
+		trace_devices[i].latency_max.store(0, std::memory_order_relaxed);
+		for (int k = 0; k < BUS_TRACE_BUCKETS; k++){
+			trace_devices[i].histogram[k].store(0, std::memory_order_relaxed);
+		}
+	}
+	for (int i = 0; i < BUS_TRACE_EVENTS; i++){
+		trace_events[i].seq.store(0, std::memory_order_relaxed);
+	}
+	trace_head.store(0, std::memory_order_relaxed);
+}
+
+void BusTrace::Dump(FILE *_file){
+	fprintf(_file, "device      transactions      bytes  errors    avg us    max us\n");
+	for (int i = 0; i < BUS_TRACE_DEVICES; i++){
+		unsigned id = trace_devices[i].device.load(std::memory_order_acquire);
+		BusTrace_counters c;
+
+		if (id == 0){																							// no more devices
+			break;
+		}
+		BusTrace::Get(id - 1, c);
+		if (id - 1 >= BUS_TRACE_GPIO){
+			fprintf(_file, "GPIO %-6u", id - 1 - BUS_TRACE_GPIO);
+		}
+		else {
+			fprintf(_file, "i2c 0x%02X   ", id - 1);
+		}
+		fprintf(_file, " %12u %10u %7u %9.1f %9u\n", c.transactions, c.bytes, c.errors, c.transactions > 0 ? c.latency_sum/(double)c.transactions : 0.0, c.latency_max);
+		for (int k = 0; k < BUS_TRACE_BUCKETS; k++){
+			if (c.histogram[k] == 0){
+				continue;
+			}
+			if (k == BUS_TRACE_BUCKETS - 1){
+				fprintf(_file, "    >= %6u us: %u\n", 1u << (k - 1), c.histogram[k]);
+			}
+			else {
+				fprintf(_file, "    <  %6u us: %u\n", 1u << k, c.histogram[k]);
+			}
+		}
+	}
+}
+
+int BusTrace::Export(FILE *_file){
+	uint32_t head = trace_head.load(std::memory_order_acquire);
+	uint32_t first = head > BUS_TRACE_EVENTS ? head - BUS_TRACE_EVENTS : 0;										// the older events are overwritten
+	int count = 0;
+
+	fprintf(_file, "tick,device,op,bytes,status,latency\n");
+	for (uint32_t index = first; index != head; index++){
+		auto &event = trace_events[index & (BUS_TRACE_EVENTS - 1)];
+		uint32_t seq = event.seq.load(std::memory_order_acquire);
+		uint32_t tick = event.tick.load(std::memory_order_relaxed);
+		uint32_t info = event.info.load(std::memory_order_relaxed);
+		int32_t status = event.status.load(std::memory_order_relaxed);
+		uint32_t latency = event.latency.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (seq != index + 1 || event.seq.load(std::memory_order_relaxed) != seq){							// still written or already overwritten
+			continue;
+		}
+		fprintf(_file, "%u,0x%X,%s,%u,%d,%u\n", tick, info >> 16, trace_ops[((info >> 8) & 0xFF) % 5], info & 0xFF, status, latency);
+		count++;
+	}
+	return count;
+}
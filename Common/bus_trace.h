@@ -0,0 +1,72 @@
+#pragma once
+#include <inttypes.h>													// used for the int types like uint8_t
+#include <stdio.h>														// FILE for Dump / Export
+#include <atomic>														// the trace is written by every driver thread without lock
+
+#define BUS_TRACE_DEVICES			16										// max count of traced devices
+#define BUS_TRACE_EVENTS			256										// size of the event ring buffer (must be a power of 2)
+#define BUS_TRACE_BUCKETS			16										// latency histogram: bucket n counts latencies < 2^n µs, the last one all longer
+#define BUS_TRACE_GPIO				0x100									// device of a GPIO sensor = BUS_TRACE_GPIO + BCM number, i2c devices use the address
+
+#define BUS_TRACE_WRITE				0										// register write (reg + 1 byte)
+#define BUS_TRACE_READ				1										// register read
+#define BUS_TRACE_BLOCK				2										// block write
+#define BUS_TRACE_COMMAND			3										// single byte without register
+#define BUS_TRACE_SENSOR			4										// whole reading of a GPIO sensor, errors = wrong checksum
+
+struct BusTrace_counters {
+	uint32_t transactions;
+	uint32_t bytes;
+	uint32_t errors;													// transactions with status < 0
+	uint64_t latency_sum;												// µs
+	uint32_t latency_max;												// µs
+	uint32_t histogram[BUS_TRACE_BUCKETS];
+};
+
+class BusTrace {
+	/* opt-in tracing of the bus transactions of all JoyPi drivers.
+	 * Disabled by default, then every traced call costs only the check of Enabled().
+	 * Enabled, every transaction is added to the counters of its device and to a
+	 * ring buffer of the last BUS_TRACE_EVENTS events. Both are fixed size and
+	 * lock-free, so the drivers can be used by many threads while tracing.
+	 *
+	*/
+public:
+	static inline bool Enabled(){ return BusTrace::_enabled.load(std::memory_order_relaxed); }
+	/* true if tracing is on, the drivers check this before measuring
+	*/
+	static void Enable(bool _on);
+	/* turn on/off tracing, the counters are kept (see Reset)
+	*/
+	static void Record(unsigned _device, uint8_t _op, unsigned _bytes, int _status, uint32_t _start, uint32_t _end);
+	/* add one transaction of _device (i2c address or BUS_TRACE_GPIO + pin)
+	 * _op     = BUS_TRACE_WRITE, BUS_TRACE_READ, BUS_TRACE_BLOCK, BUS_TRACE_COMMAND or BUS_TRACE_SENSOR
+	 * _bytes  = bytes on the bus without the address byte
+	 * _status = return value of the HAL, < 0 counts as error
+	 * _start, _end = HAL::Tick() before and after the transaction
+	 *
+	*/
+	static int Get(unsigned _device, BusTrace_counters &_counters);
+	/* copy the counters of _device
+	 *
+	 * return 1 = okay
+	 *        0 = device not traced till now (all counters 0)
+	 *
+	*/
+	static void Reset();
+	/* set all counters to 0 and empty the ring buffer
+	*/
+	static void Dump(FILE *_file);
+	/* print the counters and latency histograms of all devices
+	*/
+	static int Export(FILE *_file);
+	/* write the ring buffer as CSV (oldest event first):
+	 * tick,device,op,bytes,status,latency
+	 *
+	 * return count of exported events
+	 *
+	*/
+
+private:
+	static std::atomic<bool> _enabled;
+};
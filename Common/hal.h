@@ -0,0 +1,64 @@
+#pragma once
+#include <inttypes.h>													// used for the int types like uint8_t
+
+#define HAL_INPUT					0										// GPIO modes (same values as PiGPIO)
+#define HAL_OUTPUT					1
+#define HAL_LOW						0										// GPIO levels
+#define HAL_HIGH					1
+#define HAL_TIMEOUT					2										// level of an alert without edge (watchdog)
+#define HAL_PUD_OFF					0										// GPIO pull resistors
+#define HAL_PUD_DOWN				1
+#define HAL_PUD_UP					2
+#define HAL_BLOCK_MAX				32										// max bytes of one i2c block transfer
+#define HAL_I2C_RETRIES				3										// tries of an i2c transfer, before each retry the handle is opened again
+#define HAL_I2C_RETRY_US			500										// µs to wait before a retry, the bus settles
+
+typedef void (*HAL_alert)(int _gpio, int _level, uint32_t _tick, void *_userdata);	// called on every edge of a GPIO, see GPIO_Alert
+
+class HAL {
+	/* hardware abstraction layer for the JoyPi drivers.
+	 * The drivers only use GPIO, time and i2c by this interface, so they can run
+	 * on the PiGPIO backend (hal_pigpio.cpp) or on the simulated bus (hal_sim.cpp).
+	 * The backend is chosen by linking one of the two files, both provide
+	 * HAL::Default(), which is used by the drivers if no HAL is given.
+	 *
+	 * All functions return like PiGPIO: >= 0 = okay, < 0 = error.
+	 *
+	*/
+public:
+	virtual ~HAL(){}
+	static HAL *Default();
+	/* return the backend of this build (PiGPIO or simulation)
+	*/
+
+	virtual int Init() = 0;
+	/* initialise the backend for one driver, the first call initialises the hardware
+	*/
+	virtual void Term() = 0;
+	/* release the backend for one driver, the last call terminates the hardware
+	*/
+
+	/* GPIO, the gpio is the BCM number */
+	virtual int GPIO_Mode(unsigned _gpio, unsigned _mode) = 0;			// HAL_INPUT or HAL_OUTPUT
+	virtual int GPIO_Pull(unsigned _gpio, unsigned _pud) = 0;			// HAL_PUD_OFF, HAL_PUD_DOWN or HAL_PUD_UP
+	virtual int GPIO_Read(unsigned _gpio) = 0;							// return HAL_LOW or HAL_HIGH
+	virtual int GPIO_Write(unsigned _gpio, unsigned _level) = 0;		// HAL_LOW or HAL_HIGH
+	virtual int GPIO_Clear(uint32_t _mask) = 0;							// set all gpios of _mask (bit = BCM number) to low at once
+	virtual int GPIO_Set(uint32_t _mask) = 0;							// set all gpios of _mask to high at once
+	virtual int GPIO_Alert(unsigned _gpio, HAL_alert _func, void *_userdata) = 0;	// call _func on every edge of _gpio, NULL = stop
+
+	/* time */
+	virtual void Delay(uint32_t _us) = 0;								// wait _us µs
+	virtual uint32_t Tick() = 0;										// µs since start, wraps around after ~72 minutes
+
+	/* i2c, the handle is shared by all drivers of the same device */
+	virtual int I2C_Open(unsigned _bus, unsigned _addr) = 0;			// return the handle of the device
+	virtual void I2C_Close(int _handle) = 0;
+	virtual unsigned I2C_Generation(int _handle) = 0;					// count of reopens of the device, the driver keeps it for I2C_Reopen
+	virtual int I2C_Reopen(int _handle, unsigned _bus, unsigned _addr, unsigned &_generation) = 0;	// close and open the device again after a bus error, unless an other driver did since _generation (updated), return the handle (the same for all its drivers)
+	virtual int I2C_WriteByte(int _handle, uint8_t _data) = 0;			// send one byte without register (command)
+	virtual int I2C_WriteByteData(int _handle, uint8_t _reg, uint8_t _data) = 0;
+	virtual int I2C_ReadByteData(int _handle, uint8_t _reg) = 0;		// return the register value
+	virtual int I2C_WriteBlockData(int _handle, uint8_t _reg, const uint8_t _data[], unsigned _count) = 0;	// max HAL_BLOCK_MAX bytes
+	virtual int I2C_ReadBlockData(int _handle, uint8_t _reg, uint8_t _data[], unsigned _count) = 0;		// return the count of read bytes
+};
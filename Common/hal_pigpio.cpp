@@ -0,0 +1,39 @@
+/* PiGPIO backend of the JoyPi hardware abstraction layer */
+#include "hal.h"																								// HAL interface
+#include "pi_context.h"																							// shared PiGPIO context
+#include <pigpio.h>																								// used for PiGPIO
+
+class HAL_Pigpio : public HAL {
+	/* forwards every call to PiGPIO,
+	 * Init / Term and the i2c handles are shared by PiContext
+	*/
+public:
+	int Init(){ return PiContext::Acquire(); }
+	void Term(){ PiContext::Release(); }
+
+	int GPIO_Mode(unsigned _gpio, unsigned _mode){ return gpioSetMode(_gpio, _mode); }
+	int GPIO_Pull(unsigned _gpio, unsigned _pud){ return gpioSetPullUpDown(_gpio, _pud); }
+	int GPIO_Read(unsigned _gpio){ return gpioRead(_gpio); }
+	int GPIO_Write(unsigned _gpio, unsigned _level){ return gpioWrite(_gpio, _level); }
+	int GPIO_Clear(uint32_t _mask){ return gpioWrite_Bits_0_31_Clear(_mask); }
+	int GPIO_Set(uint32_t _mask){ return gpioWrite_Bits_0_31_Set(_mask); }
+	int GPIO_Alert(unsigned _gpio, HAL_alert _func, void *_userdata){ return gpioSetAlertFuncEx(_gpio, _func, _userdata); }
+
+	void Delay(uint32_t _us){ gpioDelay(_us); }
+	uint32_t Tick(){ return gpioTick(); }
+
+	int I2C_Open(unsigned _bus, unsigned _addr){ return PiContext::I2C_Open(_bus, _addr); }
+	void I2C_Close(int _handle){ PiContext::I2C_Close(_handle); }
+	unsigned I2C_Generation(int _handle){ return PiContext::I2C_Generation(_handle); }
+	int I2C_Reopen(int _handle, unsigned _bus, unsigned _addr, unsigned &_generation){ return PiContext::I2C_Reopen(_handle, _bus, _addr, _generation); }
+	int I2C_WriteByte(int _handle, uint8_t _data){ return i2cWriteByte(_handle, _data); }
+	int I2C_WriteByteData(int _handle, uint8_t _reg, uint8_t _data){ return i2cWriteByteData(_handle, _reg, _data); }
+	int I2C_ReadByteData(int _handle, uint8_t _reg){ return i2cReadByteData(_handle, _reg); }
+	int I2C_WriteBlockData(int _handle, uint8_t _reg, const uint8_t _data[], unsigned _count){ return i2cWriteI2CBlockData(_handle, _reg, (char *)_data, _count); }
+	int I2C_ReadBlockData(int _handle, uint8_t _reg, uint8_t _data[], unsigned _count){ return i2cReadI2CBlockData(_handle, _reg, (char *)_data, _count); }
+};
+
+HAL *HAL::Default(){
+	static HAL_Pigpio pigpio;																					// one backend for all drivers
+	return &pigpio;
+}
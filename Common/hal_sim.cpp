@@ -0,0 +1,832 @@
+/* simulated backend of the JoyPi hardware abstraction layer */
+#include "hal_sim.h"																							// own header file
+#include <string.h>																								// for memset
+#include <math.h>																								// for fabs
+#include <thread>																								// for the real time delay
+#include <chrono>
+
+#define MCP_IODIR					0x00																		// MCP23008 registers used by the simulation
+#define MCP_GPINTEN					0x02
+#define MCP_DEFVAL					0x03
+#define MCP_INTCON					0x04
+#define MCP_IOCON					0x05
+#define MCP_GPPU					0x06
+#define MCP_INTF					0x07
+#define MCP_INTCAP					0x08
+#define MCP_GPIO					0x09
+#define MCP_OLAT					0x0A
+#define MCP_SEQOP					0x20																		// IOCON: sequential operation disabled
+
+#define SIM_I2C_FAILED				-82																			// like PI_I2C_WRITE_FAILED of PiGPIO
+#define HT_ROWINT					0xA0																		// HT16K33: ROW/INT set command
+#define HT_KEY_RAM					0x40																		// HT16K33: key RAM 0x40 - 0x45
+#define HT_INT_FLAG					0x60																		// HT16K33: INT flag
+
+#define LCD_PIN_RW					0x01																		// MCP23008 GPIOs of the HD44780
+#define LCD_PIN_RS					0x02
+#define LCD_PIN_EN					0x04
+
+HAL *HAL::Default(){
+	static HAL_Sim sim;																							// one simulation for all drivers
+	return &sim;
+}
+
+HAL_Sim::HAL_Sim(){
+	memset(HAL_Sim::_pins, 0, sizeof(HAL_Sim::_pins));
+	for (int i = 0; i < 32; i++){
+		HAL_Sim::_pins[i].last = -1;																			// no level given to an alert till now
+	}
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		HAL_Sim::_devices[i].users = 0;
+	}
+}
+
+/* settings and results */
+
+void HAL_Sim::Set_Speed(unsigned _hz){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	if (_hz > 0){
+		HAL_Sim::_hz = _hz;
+	}
+}
+
+void HAL_Sim::Set_Realtime(bool _on){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	HAL_Sim::_realtime = _on;
+}
+
+int HAL_Sim::Attach_DHT(unsigned _gpio, int _type, float _temp, float _humi){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	if (HAL_Sim::_dht_count >= SIM_MAX_DHT || _gpio >= 32){
+		return -1;
+	}
+	dht &sensor = HAL_Sim::_dht[HAL_Sim::_dht_count];
+	sensor.gpio = _gpio;
+	sensor.type = _type;
+	sensor.temp = _temp;
+	sensor.humi = _humi;
+	sensor.edges = 0;
+	return HAL_Sim::_dht_count++;
+}
+
+void HAL_Sim::Reset_Counters(){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		HAL_Sim::_devices[i].transactions = 0;
+		HAL_Sim::_devices[i].bytes = 0;
+		HAL_Sim::_devices[i].hd.violations = 0;
+	}
+}
+
+uint64_t HAL_Sim::Time(){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	return HAL_Sim::_now / 1000;
+}
+
+unsigned HAL_Sim::Transactions(unsigned _addr){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		if (HAL_Sim::_devices[i].users > 0 && HAL_Sim::_devices[i].addr == _addr){
+			return HAL_Sim::_devices[i].transactions;
+		}
+	}
+	return 0;
+}
+
+unsigned HAL_Sim::Bytes(unsigned _addr){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		if (HAL_Sim::_devices[i].users > 0 && HAL_Sim::_devices[i].addr == _addr){
+			return HAL_Sim::_devices[i].bytes;
+		}
+	}
+	return 0;
+}
+
+unsigned HAL_Sim::LCD_Violations(unsigned _addr){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		if (HAL_Sim::_devices[i].users > 0 && HAL_Sim::_devices[i].addr == _addr){
+			return HAL_Sim::_devices[i].hd.violations;
+		}
+	}
+	return 0;
+}
+
+int HAL_Sim::LCD_Text(unsigned _addr, int _row, char _text[], int _cols){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		device &dev = HAL_Sim::_devices[i];
+		if (dev.users > 0 && dev.addr == _addr){
+			for (int c = 0; c < _cols; c++){
+				int col = ((dev.hd.shift + c) % 40 + 40) % 40;													// the DDRAM line is a ring of 40 characters
+				_text[c] = dev.hd.ddram[(_row % 2) * 0x40 + col];
+			}
+			_text[_cols] = 0;
+			return _cols;
+		}
+	}
+	return -1;
+}
+
+int HAL_Sim::Set_MCP_Input(unsigned _addr, uint8_t _mask, uint8_t _levels){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		device &dev = HAL_Sim::_devices[i];
+		if (dev.users > 0 && dev.addr == _addr && _addr <= 0x27){
+			dev.ext_mask = _mask;
+			dev.hd.driving = false;																				// no LCD on a board with buttons
+			dev.ext = _levels & _mask;
+			HAL_Sim::MCP_Interrupt(dev);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int HAL_Sim::Attach_MCP_INT(unsigned _addr, unsigned _gpio){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	if (_gpio >= 32){
+		return -1;
+	}
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		device &dev = HAL_Sim::_devices[i];
+		if (dev.users > 0 && dev.addr == _addr && _addr <= 0x27){
+			dev.int_gpio = _gpio;
+			HAL_Sim::Notify(_gpio);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int HAL_Sim::LCD_CGRAM(unsigned _addr, int _index){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		if (HAL_Sim::_devices[i].users > 0 && HAL_Sim::_devices[i].addr == _addr){
+			return HAL_Sim::_devices[i].hd.cgram[_index & 0x3F];
+		}
+	}
+	return -1;
+}
+
+int HAL_Sim::Set_HT16K33_Keys(unsigned _addr, const uint8_t _keys[6]){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		device &dev = HAL_Sim::_devices[i];
+		if (dev.users > 0 && dev.addr == _addr && _addr >= 0x70){
+			memcpy(dev.keys, _keys, sizeof(dev.keys));
+			HAL_Sim::Key_Scan(dev);																				// INT at the next scan (now, if it isn't waiting for a read)
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int HAL_Sim::Attach_HT16K33_INT(unsigned _addr, unsigned _gpio){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	if (_gpio >= 32){
+		return -1;
+	}
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		device &dev = HAL_Sim::_devices[i];
+		if (dev.users > 0 && dev.addr == _addr && _addr >= 0x70){
+			dev.int_gpio = _gpio;
+			HAL_Sim::Notify(_gpio);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int HAL_Sim::HT16K33_RAM(unsigned _addr, int _reg){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		if (HAL_Sim::_devices[i].users > 0 && HAL_Sim::_devices[i].addr == _addr){
+			return HAL_Sim::_devices[i].reg[_reg & 0x0F];
+		}
+	}
+	return -1;
+}
+
+/* HAL: init and time */
+
+int HAL_Sim::Init(){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	HAL_Sim::_users++;
+	return 0;
+}
+
+void HAL_Sim::Term(){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	if (HAL_Sim::_users > 0){
+		HAL_Sim::_users--;
+	}
+}
+
+void HAL_Sim::Delay(uint32_t _us){
+	bool realtime;
+	{
+		std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+		HAL_Sim::Advance((uint64_t)_us * 1000);
+		realtime = HAL_Sim::_realtime;
+	}
+	if (realtime){																								// without lock, the other threads go on meanwhile
+		std::this_thread::sleep_for(std::chrono::microseconds(_us));
+	}
+}
+
+uint32_t HAL_Sim::Tick(){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	return (uint32_t)(HAL_Sim::_now / 1000);
+}
+
+void HAL_Sim::Advance(uint64_t _ns){
+	uint64_t target = HAL_Sim::_now + _ns;
+
+	for (int i = 0; i < HAL_Sim::_dht_count; i++){																// send the DHT edges of this time to the alerts
+		dht &sensor = HAL_Sim::_dht[i];
+		for (int e = 0; e < sensor.edges; e++){
+			if (sensor.edge_time[e] > HAL_Sim::_now && sensor.edge_time[e] <= target){
+				uint64_t now = HAL_Sim::_now;
+				HAL_Sim::_now = sensor.edge_time[e];															// the alert gets the tick of the edge
+				HAL_Sim::Notify(sensor.gpio);
+				HAL_Sim::_now = now;
+			}
+		}
+	}
+	HAL_Sim::_now = target;
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){																	// key scans of the HT16K33
+		if (HAL_Sim::_devices[i].users > 0 && HAL_Sim::_devices[i].addr >= 0x70){
+			HAL_Sim::Key_Scan(HAL_Sim::_devices[i]);
+		}
+	}
+}
+
+/* HAL: GPIO */
+
+int HAL_Sim::Level(unsigned _gpio){
+	pin &p = HAL_Sim::_pins[_gpio];
+
+	if (p.mode == HAL_OUTPUT){																					// driven by the Pi
+		return p.level;
+	}
+	for (int i = 0; i < HAL_Sim::_dht_count; i++){																// driven by a DHT sensor
+		dht &sensor = HAL_Sim::_dht[i];
+		if (sensor.gpio == _gpio && sensor.edges > 0 && sensor.edge_time[0] <= HAL_Sim::_now){
+			int level = HAL_HIGH;
+			for (int e = 0; e < sensor.edges && sensor.edge_time[e] <= HAL_Sim::_now; e++){
+				level = sensor.edge_level[e];
+			}
+			return level;
+		}
+	}
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){																	// INT output of an MCP23008
+		if (HAL_Sim::_devices[i].users > 0 && HAL_Sim::_devices[i].int_gpio == (int)_gpio){
+			return HAL_Sim::_devices[i].int_active ? HAL_LOW : HAL_HIGH;
+		}
+	}
+	if (p.pull == HAL_PUD_DOWN){																				// not driven
+		return HAL_LOW;
+	}
+	return HAL_HIGH;																							// pull up (the DHT data line has one on the board)
+}
+
+void HAL_Sim::Notify(unsigned _gpio){
+	pin &p = HAL_Sim::_pins[_gpio];
+	int level = HAL_Sim::Level(_gpio);
+
+	if (level != p.last){
+		p.last = level;
+		if (p.func != NULL){
+			p.func(_gpio, level, (uint32_t)(HAL_Sim::_now / 1000), p.userdata);
+		}
+	}
+}
+
+void HAL_Sim::Start_Frame(dht &_sensor){
+	int val[5] = {0,0,0,0,0};
+	uint64_t t = HAL_Sim::_now + 30000;																			// the sensor answers 20us - 40us after the start pulse
+	int e = 0;
+
+	if (_sensor.type == 22){																					// DHT22: 16 bit values in 0.1 steps
+		int humi = (int)(_sensor.humi * 10 + 0.5);
+		int temp = (int)(fabs(_sensor.temp) * 10 + 0.5);
+		val[0] = (humi >> 8) & 0xFF;
+		val[1] = humi & 0xFF;
+		val[2] = ((temp >> 8) & 0x7F) | (_sensor.temp < 0 ? 0x80 : 0x00);
+		val[3] = temp & 0xFF;
+	}
+	else {																										// DHT11: integer and decimal byte
+		val[0] = (int)_sensor.humi;
+		val[1] = (int)((_sensor.humi - val[0]) * 10 + 0.5) % 10;
+		if (_sensor.temp >= 0){
+			val[2] = (int)_sensor.temp;
+			val[3] = (int)((_sensor.temp - val[2]) * 10 + 0.5) % 10;
+		}
+		else {																									// negative: -1 - val[2] + val[3]/10 (see DHT::Calc_Temp)
+			val[2] = (int)ceil(-_sensor.temp) - 1;
+			val[3] = ((int)((_sensor.temp + 1 + val[2]) * 10 + 0.5) % 10) | 0x80;
+		}
+	}
+	val[4] = (val[0] + val[1] + val[2] + val[3]) & 0xFF;
+
+	_sensor.edge_time[e] = t; _sensor.edge_level[e++] = HAL_LOW;												// response: 80us low, 80us high
+	t += 80000; _sensor.edge_time[e] = t; _sensor.edge_level[e++] = HAL_HIGH;
+	t += 80000; _sensor.edge_time[e] = t; _sensor.edge_level[e++] = HAL_LOW;
+	for (int b = 0; b < 40; b++){																				// every bit: 50us low, 26us (0) or 70us (1) high
+		int bit = (val[b / 8] >> (7 - b % 8)) & 1;
+		t += 50000; _sensor.edge_time[e] = t; _sensor.edge_level[e++] = HAL_HIGH;
+		t += bit ? 70000 : 26000; _sensor.edge_time[e] = t; _sensor.edge_level[e++] = HAL_LOW;
+	}
+	t += 50000; _sensor.edge_time[e] = t; _sensor.edge_level[e++] = HAL_HIGH;									// release the line
+	_sensor.edges = e;
+}
+
+int HAL_Sim::GPIO_Mode(unsigned _gpio, unsigned _mode){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	if (_gpio >= 32){
+		return -1;
+	}
+	pin &p = HAL_Sim::_pins[_gpio];
+	bool released = (p.mode == HAL_OUTPUT && p.level == HAL_LOW && _mode == HAL_INPUT);						// start pulse ended by switching to input
+
+	p.mode = _mode;
+	if (released && HAL_Sim::_now - p.low_since >= 18000000){
+		for (int i = 0; i < HAL_Sim::_dht_count; i++){
+			if (HAL_Sim::_dht[i].gpio == _gpio){
+				HAL_Sim::Start_Frame(HAL_Sim::_dht[i]);
+			}
+		}
+	}
+	HAL_Sim::Notify(_gpio);
+	return 0;
+}
+
+int HAL_Sim::GPIO_Pull(unsigned _gpio, unsigned _pud){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	if (_gpio >= 32){
+		return -1;
+	}
+	HAL_Sim::_pins[_gpio].pull = _pud;
+	HAL_Sim::Notify(_gpio);
+	return 0;
+}
+
+int HAL_Sim::GPIO_Read(unsigned _gpio){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	if (_gpio >= 32){
+		return -1;
+	}
+	HAL_Sim::Advance(SIM_GPIO_READ_US * 1000);																	// a read is not for free
+	return HAL_Sim::Level(_gpio);
+}
+
+int HAL_Sim::GPIO_Write(unsigned _gpio, unsigned _level){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	if (_gpio >= 32){
+		return -1;
+	}
+	pin &p = HAL_Sim::_pins[_gpio];
+	bool rising = (p.level == HAL_LOW && _level != HAL_LOW);
+
+	if (p.level != HAL_LOW && _level == HAL_LOW){																// start of a low pulse
+		p.low_since = HAL_Sim::_now;
+	}
+	p.level = (_level != HAL_LOW) ? HAL_HIGH : HAL_LOW;
+	if (p.mode == HAL_OUTPUT && rising && HAL_Sim::_now - p.low_since >= 18000000){							// start pulse of a DHT ended
+		for (int i = 0; i < HAL_Sim::_dht_count; i++){
+			if (HAL_Sim::_dht[i].gpio == _gpio){
+				HAL_Sim::Start_Frame(HAL_Sim::_dht[i]);
+			}
+		}
+	}
+	HAL_Sim::Notify(_gpio);
+	return 0;
+}
+
+int HAL_Sim::GPIO_Clear(uint32_t _mask){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (unsigned i = 0; i < 32; i++){
+		if (_mask & (1u << i)){
+			HAL_Sim::GPIO_Write(i, HAL_LOW);
+		}
+	}
+	return 0;
+}
+
+int HAL_Sim::GPIO_Set(uint32_t _mask){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (unsigned i = 0; i < 32; i++){
+		if (_mask & (1u << i)){
+			HAL_Sim::GPIO_Write(i, HAL_HIGH);
+		}
+	}
+	return 0;
+}
+
+int HAL_Sim::GPIO_Alert(unsigned _gpio, HAL_alert _func, void *_userdata){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	if (_gpio >= 32){
+		return -1;
+	}
+	HAL_Sim::_pins[_gpio].func = _func;
+	HAL_Sim::_pins[_gpio].userdata = _userdata;
+	HAL_Sim::_pins[_gpio].last = HAL_Sim::Level(_gpio);														// only changes from now on
+	return 0;
+}
+
+/* HAL: i2c */
+
+HAL_Sim::device *HAL_Sim::Device(int _handle){
+	if (_handle < 0 || _handle >= SIM_MAX_DEVICES || HAL_Sim::_devices[_handle].users == 0){
+		return NULL;
+	}
+	return &HAL_Sim::_devices[_handle];
+}
+
+void HAL_Sim::Clock(unsigned _bytes){
+	HAL_Sim::Advance((uint64_t)_bytes * 9 * 1000000000ull / HAL_Sim::_hz);										// 8 data bits and the ack bit
+}
+
+void HAL_Sim::Transfer(device &_dev, unsigned _bytes){
+	_dev.transactions++;
+	_dev.bytes += _bytes;
+	HAL_Sim::Clock(1);																							// start, address byte and stop
+}
+
+int HAL_Sim::I2C_Open(unsigned _bus, unsigned _addr){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	int free = -1;
+
+	if (!((_addr >= 0x20 && _addr <= 0x27) || (_addr >= 0x70 && _addr <= 0x77))){							// only MCP23008 and HT16K33 are simulated
+		return -1;
+	}
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		if (HAL_Sim::_devices[i].users > 0 && HAL_Sim::_devices[i].addr == _addr){
+			HAL_Sim::_devices[i].users++;
+			return i;
+		}
+		if (HAL_Sim::_devices[i].users == 0 && free < 0){
+			free = i;
+		}
+	}
+	if (free < 0){
+		return -1;
+	}
+
+	device &dev = HAL_Sim::_devices[free];																		// power on state of the device
+	memset(&dev, 0, sizeof(dev));
+	dev.addr = _addr;
+	dev.users = 1;
+	dev.int_gpio = -1;
+	if (_addr <= 0x27){
+		dev.reg[MCP_IODIR] = 0xFF;																				// MCP23008: all pins are inputs
+		memset(dev.hd.ddram, ' ', sizeof(dev.hd.ddram));
+		dev.hd.entry = 0x02;																					// HD44780: increment
+	}
+	return free;
+}
+
+void HAL_Sim::I2C_Close(int _handle){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	device *dev = HAL_Sim::Device(_handle);
+	if (dev != NULL){
+		dev->users--;
+	}
+}
+
+unsigned HAL_Sim::I2C_Generation(int _handle){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	device *dev = HAL_Sim::Device(_handle);
+	return dev == NULL ? 0 : dev->reopens;
+}
+
+int HAL_Sim::I2C_Reopen(int _handle, unsigned _bus, unsigned _addr, unsigned &_generation){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	device *dev = HAL_Sim::Device(_handle);
+	if (dev == NULL || dev->addr != _addr){
+		return -1;
+	}
+	if (dev->reopens == _generation){																			// not opened again by an other driver meanwhile
+		dev->reopens++;
+	}
+	_generation = dev->reopens;
+	return _handle;																								// the device keeps its state and handle
+}
+
+int HAL_Sim::Set_I2C_Errors(unsigned _addr, unsigned _count){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		if (HAL_Sim::_devices[i].users > 0 && HAL_Sim::_devices[i].addr == _addr){
+			HAL_Sim::_devices[i].errors = _count;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+unsigned HAL_Sim::Reopens(unsigned _addr){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	for (int i = 0; i < SIM_MAX_DEVICES; i++){
+		if (HAL_Sim::_devices[i].users > 0 && HAL_Sim::_devices[i].addr == _addr){
+			return HAL_Sim::_devices[i].reopens;
+		}
+	}
+	return 0;
+}
+
+bool HAL_Sim::Glitch(device &_dev){
+	if (_dev.errors == 0){
+		return false;
+	}
+	_dev.errors--;
+	HAL_Sim::Clock(1);																							// the address byte gets no ACK
+	return true;
+}
+
+int HAL_Sim::I2C_WriteByte(int _handle, uint8_t _data){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	device *dev = HAL_Sim::Device(_handle);
+	if (dev == NULL){
+		return -1;
+	}
+	if (HAL_Sim::Glitch(*dev)){
+		return SIM_I2C_FAILED;
+	}
+	HAL_Sim::Transfer(*dev, 1);
+	HAL_Sim::Clock(1);
+	if (dev->addr <= 0x27){																						// MCP23008: set the register pointer
+		dev->ptr = _data % 11;
+	}
+	else if ((_data & 0xF0) == HT_ROWINT){																		// HT16K33: ROW/INT setting, other commands (setup, dimming) are not simulated
+		dev->rowint = _data & 0x0F;
+		HAL_Sim::Key_Scan(*dev);
+	}
+	return 0;
+}
+
+int HAL_Sim::I2C_WriteByteData(int _handle, uint8_t _reg, uint8_t _data){
+	return HAL_Sim::I2C_WriteBlockData(_handle, _reg, &_data, 1);
+}
+
+int HAL_Sim::I2C_ReadByteData(int _handle, uint8_t _reg){
+	uint8_t data = 0;
+	int result = HAL_Sim::I2C_ReadBlockData(_handle, _reg, &data, 1);
+	if (result < 0){
+		return result;
+	}
+	return data;
+}
+
+int HAL_Sim::I2C_WriteBlockData(int _handle, uint8_t _reg, const uint8_t _data[], unsigned _count){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	device *dev = HAL_Sim::Device(_handle);
+	if (dev == NULL || _count > HAL_BLOCK_MAX){
+		return -1;
+	}
+	if (HAL_Sim::Glitch(*dev)){
+		return SIM_I2C_FAILED;
+	}
+	HAL_Sim::Transfer(*dev, 1 + _count);
+	HAL_Sim::Clock(1);																							// register byte
+	if (dev->addr <= 0x27){																						// MCP23008
+		dev->ptr = _reg % 11;
+		for (unsigned i = 0; i < _count; i++){
+			HAL_Sim::Clock(1);																					// the byte is there after its 9 clocks
+			HAL_Sim::MCP_Write(*dev, dev->ptr, _data[i]);
+			if (!(dev->reg[MCP_IOCON] & MCP_SEQOP)){															// sequential operation: next register
+				dev->ptr = (dev->ptr + 1) % 11;
+			}
+		}
+	}
+	else {																										// HT16K33: display RAM with auto increment
+		for (unsigned i = 0; i < _count; i++){
+			HAL_Sim::Clock(1);
+			if (_reg + i < 16){
+				dev->reg[_reg + i] = _data[i];
+			}
+		}
+	}
+	return 0;
+}
+
+int HAL_Sim::I2C_ReadBlockData(int _handle, uint8_t _reg, uint8_t _data[], unsigned _count){
+	std::lock_guard<std::recursive_mutex> lock(HAL_Sim::_lock);
+	device *dev = HAL_Sim::Device(_handle);
+	if (dev == NULL || _count > HAL_BLOCK_MAX){
+		return -1;
+	}
+	if (HAL_Sim::Glitch(*dev)){
+		return SIM_I2C_FAILED;
+	}
+	HAL_Sim::Transfer(*dev, 1 + _count);
+	HAL_Sim::Clock(2);																							// register byte, repeated start and address byte
+	for (unsigned i = 0; i < _count; i++){
+		HAL_Sim::Clock(1);
+		if (dev->addr <= 0x27){
+			_data[i] = HAL_Sim::MCP_Read(*dev, (_reg + i) % 11);
+		}
+		else if (_reg + i < 16){																				// HT16K33: display RAM
+			_data[i] = dev->reg[_reg + i];
+		}
+		else if (_reg + i >= HT_KEY_RAM && _reg + i < HT_KEY_RAM + 6){										// key RAM
+			_data[i] = dev->keys[_reg + i - HT_KEY_RAM];
+		}
+		else if (_reg + i == HT_INT_FLAG){
+			_data[i] = dev->int_active ? 0xFF : 0x00;
+		}
+		else {
+			_data[i] = 0;
+		}
+	}
+	if (dev->addr >= 0x70 && _reg >= HT_KEY_RAM && _reg < HT_KEY_RAM + 6 && dev->int_active){				// reading the key RAM clears INT till the next scan
+		dev->int_active = false;
+		dev->next_scan = HAL_Sim::_now + SIM_KEYSCAN_US * 1000;
+		if (dev->int_gpio >= 0){
+			HAL_Sim::Notify(dev->int_gpio);
+		}
+	}
+	return _count;
+}
+
+void HAL_Sim::Key_Scan(device &_dev){
+	bool pressed = false;
+	for (int i = 0; i < 6; i++){
+		pressed = pressed || _dev.keys[i] != 0;
+	}
+	if (pressed && (_dev.rowint & 0x01) && _dev.int_active == false && HAL_Sim::_now >= _dev.next_scan){		// INT output and a key pressed at the scan
+		_dev.int_active = true;
+		if (_dev.int_gpio >= 0){
+			HAL_Sim::Notify(_dev.int_gpio);
+		}
+	}
+}
+
+/* MCP23008 and HD44780 */
+
+void HAL_Sim::MCP_Write(device &_dev, uint8_t _reg, uint8_t _data){
+	if (_reg == MCP_GPIO){																						// writing GPIO writes the output latch
+		_reg = MCP_OLAT;
+	}
+	_dev.reg[_reg] = _data;
+	if (_reg == MCP_OLAT || _reg == MCP_IODIR || _reg == MCP_GPPU){											// pins may have changed
+		HAL_Sim::LCD_Pins(_dev);
+	}
+	if (_reg == MCP_IODIR || _reg == MCP_GPPU || _reg == MCP_GPINTEN || _reg == MCP_DEFVAL || _reg == MCP_INTCON){
+		HAL_Sim::MCP_Interrupt(_dev);
+	}
+}
+
+int HAL_Sim::MCP_Read(device &_dev, uint8_t _reg){
+	int value = (_reg == MCP_GPIO) ? HAL_Sim::MCP_Pins(_dev) : _dev.reg[_reg];
+
+	if ((_reg == MCP_GPIO || _reg == MCP_INTCAP) && _dev.int_active){											// reading GPIO or INTCAP clears the interrupt
+		_dev.reg[MCP_INTF] = 0;
+		_dev.int_active = false;
+		if (_dev.int_gpio >= 0){
+			HAL_Sim::Notify(_dev.int_gpio);
+		}
+		HAL_Sim::MCP_Interrupt(_dev);																			// compare with DEFVAL: again, if the pin still differs
+	}
+	return value;
+}
+
+uint8_t HAL_Sim::MCP_Pins(device &_dev){
+	uint8_t value = _dev.reg[MCP_OLAT] & ~_dev.reg[MCP_IODIR];													// output pins
+	uint8_t input = _dev.reg[MCP_GPPU] & _dev.reg[MCP_IODIR] & ~_dev.ext_mask;									// open input pins with pull up
+	input |= _dev.ext & _dev.ext_mask & _dev.reg[MCP_IODIR];													// input pins driven from outside
+	if (_dev.hd.driving){																						// HD44780 drives the data pins
+		input = (input & ~0x78) | ((_dev.hd.out << 3) & 0x78 & _dev.reg[MCP_IODIR]);
+	}
+	return value | input;
+}
+
+void HAL_Sim::MCP_Interrupt(device &_dev){
+	uint8_t pins = HAL_Sim::MCP_Pins(_dev);
+	uint8_t input = pins & _dev.reg[MCP_IODIR];
+	uint8_t ref = (_dev.reg[MCP_INTCON] & _dev.reg[MCP_DEFVAL]) | (~_dev.reg[MCP_INTCON] & _dev.last_in);	// INTCON: 1 = compare with DEFVAL, 0 = with the last level
+	uint8_t hit = (input ^ ref) & _dev.reg[MCP_GPINTEN] & _dev.reg[MCP_IODIR];
+
+	_dev.last_in = input;
+	if (hit == 0){
+		return;
+	}
+	_dev.reg[MCP_INTF] |= hit;
+	if (_dev.int_active == false){																				// first change: capture the pins, INT goes low
+		_dev.reg[MCP_INTCAP] = pins;
+		_dev.int_active = true;
+		if (_dev.int_gpio >= 0){
+			HAL_Sim::Notify(_dev.int_gpio);
+		}
+	}
+}
+
+void HAL_Sim::LCD_Pins(device &_dev){
+	lcd &hd = _dev.hd;
+	if (_dev.ext_mask != 0){																					// pins driven from outside: a board with buttons, no LCD
+		return;
+	}
+	uint8_t lines = (_dev.reg[MCP_OLAT] & ~_dev.reg[MCP_IODIR]) | (_dev.reg[MCP_GPPU] & _dev.reg[MCP_IODIR]);	// not driven pins read their pull up
+	bool en = lines & LCD_PIN_EN;
+	bool rw = lines & LCD_PIN_RW;
+	bool rs = lines & LCD_PIN_RS;
+	uint8_t nibble = (lines >> 3) & 0x0F;
+
+	if (en && !hd.en && rw){																					// read: HD44780 puts a nibble on the data pins
+		uint8_t value = rs ? 0x00 : ((HAL_Sim::_now < hd.busy_until ? 0x80 : 0x00) | (hd.ac & 0x7F));		// busy flag and address counter
+		hd.out = hd.read_low ? (value & 0x0F) : (value >> 4);
+		hd.driving = true;
+	}
+	if (!en && hd.en){																							// falling enable: the HD44780 takes the data
+		if (hd.driving){
+			hd.driving = false;
+			if (hd.four_bit){
+				hd.read_low = !hd.read_low;
+			}
+		}
+		else if (!rw){
+			if (!hd.four_bit){																					// 8-bit mode: the nibble is the high half
+				HAL_Sim::LCD_Execute(hd, rs, nibble << 4);
+			}
+			else if (!hd.nibble){
+				hd.high = nibble;
+				hd.nibble = true;
+			}
+			else {
+				hd.nibble = false;
+				HAL_Sim::LCD_Execute(hd, rs, (hd.high << 4) | nibble);
+			}
+		}
+	}
+	hd.en = en;
+}
+
+void HAL_Sim::LCD_Execute(lcd &_hd, bool _rs, uint8_t _byte){
+	uint64_t duration = SIM_LCD_CMD_US * 1000;
+
+	if (_hd.four_bit && HAL_Sim::_now < _hd.busy_until){														// still busy with the last byte
+		_hd.violations++;
+	}
+	if (_rs){																									// character
+		if (_hd.cg){
+			_hd.cgram[_hd.ac & 0x3F] = _byte;
+			_hd.ac = (_hd.ac + 1) & 0x3F;
+		}
+		else {
+			_hd.ddram[_hd.ac & 0x7F] = _byte;
+			if (_hd.entry & 0x02){																				// increment, the lines are 0x00 - 0x27 and 0x40 - 0x67
+				_hd.ac++;
+				if (_hd.ac == 0x28) _hd.ac = 0x40;
+				if (_hd.ac == 0x68) _hd.ac = 0x00;
+			}
+			else {
+				_hd.ac--;
+				if (_hd.ac == 0xFF) _hd.ac = 0x67;
+				if (_hd.ac == 0x3F) _hd.ac = 0x27;
+			}
+		}
+	}
+	else if (_byte & 0x80){																						// set DDRAM address
+		_hd.ac = _byte & 0x7F;
+		_hd.cg = false;
+	}
+	else if (_byte & 0x40){																						// set CGRAM address
+		_hd.ac = _byte & 0x3F;
+		_hd.cg = true;
+	}
+	else if (_byte & 0x20){																						// function set
+		_hd.four_bit = !(_byte & 0x10);
+		_hd.nibble = false;
+		_hd.read_low = false;
+	}
+	else if (_byte & 0x10){																						// cursor or display shift
+		int dir = (_byte & 0x04) ? 1 : -1;
+		if (_byte & 0x08){
+			_hd.shift -= dir;																					// display moves right: first visible column moves left
+		}
+		else {
+			_hd.ac += dir;
+		}
+	}
+	else if (_byte & 0x08){																						// display control: not simulated
+	}
+	else if (_byte & 0x04){																						// entry mode
+		_hd.entry = _byte & 0x03;
+	}
+	else if (_byte & 0x02){																						// home
+		_hd.ac = 0;
+		_hd.cg = false;
+		_hd.shift = 0;
+		duration = SIM_LCD_LONG_US * 1000;
+	}
+	else if (_byte & 0x01){																						// clear
+		memset(_hd.ddram, ' ', sizeof(_hd.ddram));
+		_hd.ac = 0;
+		_hd.cg = false;
+		_hd.shift = 0;
+		_hd.entry |= 0x02;
+		duration = SIM_LCD_LONG_US * 1000;
+	}
+	_hd.busy_until = HAL_Sim::_now + duration;
+}
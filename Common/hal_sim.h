@@ -0,0 +1,154 @@
+#pragma once
+#include "hal.h"														// HAL interface
+#include <mutex>														// the simulation can be used by many threads
+
+#define SIM_MAX_DEVICES				16										// max count of simulated i2c devices
+#define SIM_MAX_DHT					8										// max count of simulated DHT sensors
+#define SIM_DHT_EDGES				88										// edges of one DHT frame
+#define SIM_GPIO_READ_US			2										// µs one GPIO_Read takes (like PiGPIO on a Raspberry Pi)
+#define SIM_LCD_CMD_US				37										// µs the HD44780 needs for a command or character
+#define SIM_LCD_LONG_US				1520									// µs the HD44780 needs for clear and home
+#define SIM_KEYSCAN_US				9600									// µs of one key scan of the HT16K33
+
+class HAL_Sim : public HAL {
+	/* simulated JoyPi bus for benchmarks and tests without a Raspberry Pi.
+	 * Link hal_sim.cpp instead of hal_pigpio.cpp, then HAL::Default() is a HAL_Sim.
+	 *
+	 * The time is virtual: Delay and every i2c transaction advance it (9 clocks per
+	 * byte at the given bus speed), so Time() shows how long an operation would take
+	 * on the bus. Simulated are:
+	 *  - MCP23008 (address 0x20 - 0x27) with all 11 registers and an HD44780 in
+	 *    4-bit mode on its GPIOs, wired like the JoyPi LCD (GPA0 R/W, GPA1 RS,
+	 *    GPA2 enable, GPA3 - GPA6 data, GPA7 backlight), the interrupt on change
+	 *    drives an INT line to a Pi GPIO (see Attach_MCP_INT)
+	 *  - HT16K33 (address 0x70 - 0x77) with the 16 byte display RAM and the key scan,
+	 *    ROW/INT drives an INT line to a Pi GPIO (see Attach_HT16K33_INT)
+	 *  - DHT11 / DHT22 sensors, which answer a start pulse with a correct frame
+	 *
+	*/
+public:
+	HAL_Sim();
+
+	/* settings and results of the simulation */
+	void Set_Speed(unsigned _hz);										// i2c clock (100000 by default)
+	void Set_Realtime(bool _on);										// Delay also sleeps, so threads (like BusScheduler) interleave as on the Raspberry Pi
+	int Attach_DHT(unsigned _gpio, int _type, float _temp, float _humi);	// put a DHT11 / DHT22 sensor on _gpio, return < 0 if no slot left
+	void Reset_Counters();												// set transactions, bytes and LCD violations to 0
+	uint64_t Time();													// virtual µs since start
+	unsigned Transactions(unsigned _addr);								// i2c transactions of the device since Reset_Counters
+	unsigned Bytes(unsigned _addr);										// i2c bytes (without address byte) of the device since Reset_Counters
+	unsigned LCD_Violations(unsigned _addr);							// bytes the HD44780 got while it was busy
+	int LCD_Text(unsigned _addr, int _row, char _text[], int _cols);	// copy the visible text of the LCD row into _text (0 terminated)
+	int Set_MCP_Input(unsigned _addr, uint8_t _mask, uint8_t _levels);	// drive the MCP23008 pins of _mask from outside (buttons), return < 0 if the device isn't open
+	int Attach_MCP_INT(unsigned _addr, unsigned _gpio);					// wire the INT output of the MCP23008 (active low) to the Pi _gpio
+	int LCD_CGRAM(unsigned _addr, int _index);							// return a byte of the custom characters (slot * 8 + row)
+	int HT16K33_RAM(unsigned _addr, int _reg);							// return a byte of the display RAM
+	int Set_HT16K33_Keys(unsigned _addr, const uint8_t _keys[6]);		// set the pressed keys (key RAM 0x40 - 0x45), return < 0 if the device isn't open
+	int Attach_HT16K33_INT(unsigned _addr, unsigned _gpio);			// wire ROW/INT of the HT16K33 (INT active low) to the Pi _gpio
+	int Set_I2C_Errors(unsigned _addr, unsigned _count);				// the next _count transfers of the device fail (bus glitch), return < 0 if the device isn't open
+	unsigned Reopens(unsigned _addr);									// count of I2C_Reopen of the device, which opened it again
+
+	/* HAL */
+	int Init();
+	void Term();
+	int GPIO_Mode(unsigned _gpio, unsigned _mode);
+	int GPIO_Pull(unsigned _gpio, unsigned _pud);
+	int GPIO_Read(unsigned _gpio);
+	int GPIO_Write(unsigned _gpio, unsigned _level);
+	int GPIO_Clear(uint32_t _mask);
+	int GPIO_Set(uint32_t _mask);
+	int GPIO_Alert(unsigned _gpio, HAL_alert _func, void *_userdata);
+	void Delay(uint32_t _us);
+	uint32_t Tick();
+	int I2C_Open(unsigned _bus, unsigned _addr);
+	void I2C_Close(int _handle);
+	unsigned I2C_Generation(int _handle);
+	int I2C_Reopen(int _handle, unsigned _bus, unsigned _addr, unsigned &_generation);
+	int I2C_WriteByte(int _handle, uint8_t _data);
+	int I2C_WriteByteData(int _handle, uint8_t _reg, uint8_t _data);
+	int I2C_ReadByteData(int _handle, uint8_t _reg);
+	int I2C_WriteBlockData(int _handle, uint8_t _reg, const uint8_t _data[], unsigned _count);
+	int I2C_ReadBlockData(int _handle, uint8_t _reg, uint8_t _data[], unsigned _count);
+
+private:
+	struct pin {
+		uint8_t mode;													// HAL_INPUT / HAL_OUTPUT
+		uint8_t level;													// driven level in output mode
+		uint8_t pull;													// pull resistor
+		uint64_t low_since;												// time (ns) the pin was driven low
+		HAL_alert func;													// alert of GPIO_Alert
+		void *userdata;
+		int last;														// last level given to the alert
+	};
+	struct dht {
+		unsigned gpio;
+		int type;
+		float temp;
+		float humi;
+		uint64_t edge_time[SIM_DHT_EDGES];								// edges (ns) of the current frame
+		uint8_t edge_level[SIM_DHT_EDGES];
+		int edges;														// count of edges of the current frame
+	};
+	struct lcd {
+		bool four_bit;													// false till function set with 4-bit mode
+		bool nibble;													// true if the high nibble is received
+		uint8_t high;													// received high nibble
+		bool read_low;													// true if the next read gives the low nibble
+		bool en;														// last level of the enable bit
+		bool driving;													// true while the HD44780 drives the data pins (read)
+		uint8_t out;													// nibble on the data pins while driving
+		uint8_t ddram[128];
+		uint8_t cgram[64];
+		uint8_t ac;														// address counter
+		bool cg;														// true if ac points into the CGRAM
+		uint8_t entry;													// entry mode bits
+		int shift;														// first visible DDRAM column
+		uint64_t busy_until;											// time (ns) the current command is finished
+		unsigned violations;
+	};
+	struct device {
+		unsigned addr;
+		int users;														// 0 = slot is free
+		unsigned transactions;
+		unsigned bytes;
+		uint8_t reg[16];												// MCP23008 registers or HT16K33 display RAM
+		uint8_t ptr;													// MCP23008 register pointer
+		uint8_t ext_mask;												// MCP23008 pins driven from outside
+		uint8_t ext;													// their levels
+		uint8_t last_in;												// input levels of the last interrupt check
+		int int_gpio;													// Pi GPIO of the INT output, -1 = not wired
+		bool int_active;												// INT output is low
+		uint8_t keys[6];												// HT16K33 key RAM
+		uint8_t rowint;													// HT16K33 ROW/INT setting
+		uint64_t next_scan;												// time (ns) the HT16K33 sets INT again, if keys are pressed
+		unsigned errors;												// count of the next transfers, which fail (bus glitch)
+		unsigned reopens;												// count of I2C_Reopen, which opened the device again (generation)
+		lcd hd;															// HD44780 on the MCP23008
+	};
+
+	int Level(unsigned _gpio);											// level of the pin at the current time
+	void Advance(uint64_t _ns);											// advance the time and send the due DHT edges to the alerts
+	void Notify(unsigned _gpio);										// call the alert if the level has changed
+	void Start_Frame(dht &_sensor);										// build the edges of a DHT frame from now on
+	void Transfer(device &_dev, unsigned _bytes);						// count an i2c transaction and the time of start, address byte and _bytes
+	void Clock(unsigned _bytes);										// advance the time by _bytes i2c bytes
+	void MCP_Write(device &_dev, uint8_t _reg, uint8_t _data);			// write an MCP23008 register
+	int MCP_Read(device &_dev, uint8_t _reg);							// read an MCP23008 register
+	uint8_t MCP_Pins(device &_dev);										// levels of the MCP23008 pins
+	void MCP_Interrupt(device &_dev);									// check the interrupt on change of the MCP23008
+	void Key_Scan(device &_dev);
+	bool Glitch(device &_dev);											// true if the transfer fails (Set_I2C_Errors)										// HT16K33: set INT, if keys are pressed and INT is used
+	void LCD_Pins(device &_dev);										// new GPIO state of the MCP23008 for the HD44780
+	void LCD_Execute(lcd &_hd, bool _rs, uint8_t _byte);				// execute a command or write a character
+	device *Device(int _handle);										// device of the handle or NULL
+
+	std::recursive_mutex _lock;
+	uint64_t _now = 0;													// virtual time in ns
+	unsigned _hz = 100000;
+	bool _realtime = false;
+	int _users = 0;
+	pin _pins[32];
+	dht _dht[SIM_MAX_DHT];
+	int _dht_count = 0;
+	device _devices[SIM_MAX_DEVICES];
+};
@@ -0,0 +1,137 @@
+/* process wide PiGPIO context for the JoyPi drivers */
+#include "pi_context.h"																							// own header file
+#include <pigpio.h>																								// used for PiGPIO
+#include <mutex>																								// drivers can be created by different threads
+
+static std::mutex context_lock;																					// guards all values below
+static int context_users = 0;																					// count of Acquire without Release
+
+static struct {
+	unsigned bus;
+	unsigned addr;
+	int handle;
+	unsigned generation;																						// count of reopens, see I2C_Reopen
+	bool closed;																								// Reopen failed: the handle is closed, the drivers still use it as id
+	int users;																									// 0 = slot is free
+} context_i2c[PI_CONTEXT_MAX_I2C];
+
+int PiContext::Acquire(){
+	std::lock_guard<std::mutex> lock(context_lock);
+	
+	if (context_users == 0){																					// first user: initialise PiGPIO
+		int result = gpioInitialise();
+		if (result < 0){
+			return result;
+		}
+	}
+	context_users++;
+	return 0;
+}
+
+void PiContext::Release(){
+	std::lock_guard<std::mutex> lock(context_lock);
+	
+	if (context_users == 0){																					// nothing to release
+		return;
+	}
+	context_users--;
+	if (context_users == 0){																					// last user: close everything
+		for (int i = 0; i < PI_CONTEXT_MAX_I2C; i++){
+			if (context_i2c[i].users > 0 && context_i2c[i].closed == false){								// a failed Reopen closed it already
+				i2cClose(context_i2c[i].handle);
+			}
+			context_i2c[i].users = 0;																		// all slots are free again
+			context_i2c[i].closed = false;
+		}
+		gpioTerminate();
+	}
+}
+
+int PiContext::I2C_Open(unsigned _bus, unsigned _addr){
+	std::lock_guard<std::mutex> lock(context_lock);
+	int free = -1;
+	
+	for (int i = 0; i < PI_CONTEXT_MAX_I2C; i++){
+		if (context_i2c[i].users > 0 && context_i2c[i].bus == _bus && context_i2c[i].addr == _addr){	// device is open already
+			context_i2c[i].users++;
+			return context_i2c[i].handle;
+		}
+		if (context_i2c[i].users == 0 && free < 0){
+			free = i;
+		}
+	}
+	if (free < 0){																								// no slot left
+		return PI_NO_HANDLE;
+	}
+	
+	int handle = i2cOpen(_bus, _addr, 0);																		// first user of this device
+	if (handle < 0){
+		return handle;
+	}
+	context_i2c[free].bus = _bus;
+	context_i2c[free].addr = _addr;
+	context_i2c[free].handle = handle;
+	context_i2c[free].generation = 0;
+	context_i2c[free].closed = false;
+	context_i2c[free].users = 1;
+	return handle;
+}
+
+void PiContext::I2C_Close(int _handle){
+	std::lock_guard<std::mutex> lock(context_lock);
+	
+	for (int i = 0; i < PI_CONTEXT_MAX_I2C; i++){
+		if (context_i2c[i].users > 0 && context_i2c[i].handle == _handle){
+			context_i2c[i].users--;
+			if (context_i2c[i].users == 0 && context_i2c[i].closed == false){								// last user of this device
+				i2cClose(_handle);
+			}
+			return;
+		}
+	}
+}
+
+unsigned PiContext::I2C_Generation(int _handle){
+	std::lock_guard<std::mutex> lock(context_lock);
+	
+	for (int i = 0; i < PI_CONTEXT_MAX_I2C; i++){
+		if (context_i2c[i].users > 0 && context_i2c[i].handle == _handle){
+			return context_i2c[i].generation;
+		}
+	}
+	return 0;
+}
+
+int PiContext::I2C_Reopen(int _handle, unsigned _bus, unsigned _addr, unsigned &_generation){
+	std::lock_guard<std::mutex> lock(context_lock);
+	
+	for (int i = 0; i < PI_CONTEXT_MAX_I2C; i++){
+		if (context_i2c[i].users > 0 && context_i2c[i].bus == _bus && context_i2c[i].addr == _addr){
+			if (context_i2c[i].generation != _generation){														// opened again by an other driver of the device
+				_generation = context_i2c[i].generation;
+				if (context_i2c[i].closed == false){
+					return context_i2c[i].handle;
+				}
+			}
+			if (context_i2c[i].closed == false){
+				i2cClose(context_i2c[i].handle);
+			}
+			int handle = i2cOpen(_bus, _addr, 0);
+			if (handle < 0){																				// the drivers keep the old handle, the next Reopen tries again
+				context_i2c[i].closed = true;
+				return handle;
+			}
+			context_i2c[i].handle = handle;
+			context_i2c[i].closed = false;
+			context_i2c[i].generation++;
+			_generation = context_i2c[i].generation;
+			return handle;
+		}
+	}
+	return PI_NO_HANDLE;																						// not opened by I2C_Open
+}
+
+int PiContext::Users(){
+	std::lock_guard<std::mutex> lock(context_lock);
+	return context_users;
+}
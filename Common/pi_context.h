@@ -0,0 +1,58 @@
+#pragma once
+#include <inttypes.h>													// used for the int types like uint8_t
+
+#define PI_CONTEXT_MAX_I2C			16										// max count of open i2c devices
+
+class PiContext {
+	/* process wide context of PiGPIO for all JoyPi drivers.
+	 * PiGPIO can only be initialised once per process, so every driver calls
+	 * Acquire / Release instead of gpioInitialise / gpioTerminate.
+	 * The first Acquire initialises PiGPIO, the last Release terminates it.
+	 *
+	 * i2c handles are cached per bus and address, so drivers for the same
+	 * device share one handle. The handle is closed with the last I2C_Close.
+	 *
+	*/
+public:
+	static int Acquire();
+	/* initialise PiGPIO if it is the first user, else only count the user
+	 *
+	 * return >= 0 = PiGPIO is ready
+	 *        <  0 = initialisation failed (error of gpioInitialise)
+	 *
+	*/
+	static void Release();
+	/* release PiGPIO, the last user terminates it and closes all i2c handles
+	 *
+	*/
+	static int I2C_Open(unsigned _bus, unsigned _addr);
+	/* return the cached handle for the device _addr on i2c _bus or open a new one
+	 *
+	 * return >= 0 = handle
+	 *        <  0 = error of i2cOpen
+	 *
+	*/
+	static void I2C_Close(int _handle);
+	/* release a handle of I2C_Open, the last user closes it
+	 *
+	*/
+	static unsigned I2C_Generation(int _handle);
+	/* return the count of reopens of the device with the _handle, 0 = unknown handle
+	 * A driver keeps it after I2C_Open for I2C_Reopen.
+	 *
+	*/
+	static int I2C_Reopen(int _handle, unsigned _bus, unsigned _addr, unsigned &_generation);
+	/* close the device _addr on i2c _bus and open it again (after a bus error), the users stay
+	 * If an other driver of the device has opened it again since _generation (see I2C_Generation),
+	 * only the handle of now is returned. _generation is set to the count of reopens of the device.
+	 * (PiGPIO often gives the same handle number again, so the handle can't tell a reopen.)
+	 *
+	 * return >= 0 = handle, use it instead of _handle
+	 *        <  0 = error of i2cOpen, the device is closed, keep _handle for the next Reopen / I2C_Close
+	 *
+	*/
+	static int Users();
+	/* return the count of users (Acquire without Release)
+	 *
+	*/
+};
@@ -0,0 +1,361 @@
+/* benchmark of the JoyPi drivers on the simulated bus (no Raspberry Pi needed)
+ * shows the i2c transactions and the bus time per operation of LCD, 7-segment display and DHT sensor
+ *
+ * commands:
+ * build: g++ -Wall -o "%e" hal_sim.cpp bus_trace.cpp bus_scheduler.cpp ../DHT11/dht.cpp ../DHT11/dht_array.cpp ../DHT11/dht_history.cpp ../MCP23008/mcp23008.cpp ../LCD/lcd_mcp23008.cpp ../SevenSegment/SevenSegment.cpp "%f" -pthread
+ * run: ./sim_benchmark [trace]    trace = print the bus trace counters and histograms at the end
+*/
+
+#include "hal_sim.h"													// simulated backend
+#include "../LCD/lcd_mcp23008.h"										// LCD driver
+#include "../SevenSegment/SevenSegment.h"								// 7-segment driver
+#include "../DHT11/dht11.h"												// DHT driver
+#include "../DHT11/dht_array.h"											// many DHT sensors at once
+#include "../DHT11/dht_history.h"										// statistics of the readings
+#include <math.h>														// for fabs
+#include "bus_scheduler.h"												// shared i2c bus
+#include <stdio.h>														// for printf
+#include <string.h>														// for strcmp
+#include <thread>														// to wait for the bus thread
+
+#define RUNS		20													// calls per measurement
+#define LCD_ADDR	0x21
+#define SEG_ADDR	0x70
+#define DHT_PIN		4
+#define REPLAY_EDGES	85												// edges of a recorded frame: release, response (3), 40 bits (2 each), end
+
+HAL_Sim *sim = (HAL_Sim *)HAL::Default();								// the backend of this build is the simulation
+
+void result(const char _name[], unsigned _addr, uint64_t _start){
+	printf("%-28s %8.1f transactions %8.1f bytes %10.1f us\n", _name, sim->Transactions(_addr)/(float)RUNS, sim->Bytes(_addr)/(float)RUNS, (sim->Time() - _start)/(float)RUNS);
+}
+
+int bench_lcd(){
+	LCD_MCP23008_I2C lcd(LCD_ADDR,2,16,sim);
+	char text[41];
+	int errors = 0;
+
+	lcd.Init();
+	lcd.Backlight(true);
+
+	const char *names[3] = {"LCD PrintLine single", "LCD PrintLine batch", "LCD PrintLine single busy"};
+	for (int mode = 0; mode < 3; mode++){
+		lcd.BatchMode(mode == 1);
+		if (lcd.BusyMode(mode == 2) != (mode == 2)){					// the simulated HD44780 answers the busy flag
+			errors++;
+		}
+		sim->Reset_Counters();
+		uint64_t start = sim->Time();
+		for (int i = 0; i < RUNS; i++){
+			lcd.PrintLine("0123456789ABCDEF",i%2);						// 16 characters, alternating lines
+		}
+		result(names[mode], LCD_ADDR, start);
+		if (sim->LCD_Violations(LCD_ADDR) > 0){
+			printf("  %u bytes sent while the HD44780 was busy\n", sim->LCD_Violations(LCD_ADDR));
+			errors++;
+		}
+	}
+	lcd.BatchMode(true);
+
+	for (int mode = 0; mode < 2; mode++){								// fixed 2 ms delay against polling the busy flag
+		lcd.BusyMode(mode == 1);
+		sim->Reset_Counters();
+		uint64_t start = sim->Time();
+		for (int i = 0; i < RUNS; i++){
+			lcd.Clear();
+		}
+		result(mode == 1 ? "LCD Clear busy" : "LCD Clear", LCD_ADDR, start);
+		if (sim->LCD_Violations(LCD_ADDR) > 0){
+			printf("  %u bytes sent while the HD44780 was busy\n", sim->LCD_Violations(LCD_ADDR));
+			errors++;
+		}
+	}
+	lcd.BusyMode(false);
+
+	lcd.PrintLine("JoyPi simulation",0);
+	lcd.PrintLine("HD44780 4-bit",1);
+	sim->LCD_Text(LCD_ADDR, 0, text, 16);
+	errors += strcmp(text, "JoyPi simulation") != 0;
+	printf("  row 0: \"%s\"\n", text);
+	sim->LCD_Text(LCD_ADDR, 1, text, 16);
+	errors += strcmp(text, "HD44780 4-bit   ") != 0;
+	printf("  row 1: \"%s\"\n", text);
+
+	lcd.Term();
+	return errors;
+}
+
+int bench_segment(){
+	SevenSegment seg(SEG_ADDR,sim);
+	int errors = 0;
+
+	sim->Reset_Counters();
+	uint64_t start = sim->Time();
+	for (int i = 0; i < RUNS; i++){
+		for (int pos = 0; pos < 4; pos++){
+			seg.set_digit(pos, (i + pos) % 10);							// 4 digits into the shadow RAM
+		}
+		seg.commit();													// one block write
+	}
+	result("7-Segment set_digit x4+commit", SEG_ADDR, start);
+
+	sim->Reset_Counters();
+	start = sim->Time();
+	for (int i = 0; i < RUNS; i++){
+		seg.display_clear();
+		seg.commit();
+	}
+	result("7-Segment display_clear", SEG_ADDR, start);
+
+	seg.set_digit(0, 1);
+	seg.set_digit(3, 8);
+	seg.commit();
+	errors += sim->HT16K33_RAM(SEG_ADDR, 0) != 0x06;					// segments of "1"
+	errors += sim->HT16K33_RAM(SEG_ADDR, 8) != 0x7F;					// segments of "8"
+	printf("  RAM: %02X %02X %02X %02X\n", sim->HT16K33_RAM(SEG_ADDR, 0), sim->HT16K33_RAM(SEG_ADDR, 2), sim->HT16K33_RAM(SEG_ADDR, 6), sim->HT16K33_RAM(SEG_ADDR, 8));
+	return errors;
+}
+
+int bench_dht(){
+	DHT sensor(DHT_PIN,DHT11,sim);
+	int errors = 0;
+
+	sim->Attach_DHT(DHT_PIN, DHT11, 23.0, 45.0);
+
+	for (int mode = 0; mode < 2; mode++){
+		int correct = 0;
+
+		sensor.Set_Mode(mode == 1 ? DHT_MODE_ALERT : DHT_MODE_POLL);
+		uint64_t start = sim->Time();
+		for (int i = 0; i < RUNS; i++){
+			correct += sensor.Read() == 1;								// 1 = checksum okay
+		}
+		printf("%-28s %8d/%d correct %19.1f us\n", mode == 1 ? "DHT Read alert" : "DHT Read poll", correct, RUNS, (sim->Time() - start)/(float)RUNS);
+		printf("  %.1f C %.1f %%\n", sensor.Get_Temp(), sensor.Get_Humi());
+		errors += correct != RUNS || sensor.Get_Temp() != 23.0 || sensor.Get_Humi() != 45.0;
+	}
+
+	sensor.Terminate();
+	return errors;
+}
+
+struct replay {
+	/* edges of a frame recorded from a sensor, see bench_decode
+	*/
+	const char *name;
+	int type;
+	uint32_t start;														// tick of the first edge
+	uint8_t us[REPLAY_EDGES];											// µs since the edge before, the level changes at every edge (first: high)
+	int val[5];															// expected frame
+	float temp;
+	float humi;
+};
+
+static const replay replays[2] = {
+	{"DHT11 23.0 C 45 %, tick wrap", DHT11, 4294967000u, {
+		0, 27, 79, 81, 48, 23, 49, 25, 48, 74, 51, 23, 49, 72, 54, 67, 51, 23, 54, 66, 49, 24,
+		48, 27, 54, 23, 51, 23, 50, 25, 54, 24, 49, 27, 52, 27, 50, 23, 51, 25, 49, 27, 49, 66,
+		51, 26, 54, 71, 55, 73, 53, 70, 51, 29, 50, 28, 51, 23, 52, 27, 55, 25, 55, 25, 49, 23,
+		54, 24, 53, 24, 55, 72, 48, 28, 49, 29, 53, 25, 53, 73, 55, 23, 49, 25, 55},
+		{45, 0, 23, 0, 68}, 23.0, 45.0},
+	{"DHT22 -10.1 C 55.3 %", DHT22, 1000000u, {
+		0, 23, 78, 83, 52, 28, 55, 25, 54, 28, 53, 23, 55, 25, 50, 27, 49, 73, 48, 24, 52, 24,
+		51, 26, 54, 73, 49, 24, 55, 72, 52, 24, 54, 29, 52, 72, 53, 72, 51, 24, 49, 24, 50, 24,
+		51, 23, 55, 29, 50, 25, 52, 23, 50, 26, 53, 71, 50, 74, 48, 26, 54, 26, 54, 72, 49, 26,
+		54, 66, 51, 23, 51, 26, 50, 23, 53, 66, 49, 23, 50, 27, 49, 25, 48, 23, 51},
+		{2, 41, 128, 101, 16}, -10.1, 55.3},
+};
+
+int check_decode(const replay &_r, const uint32_t _ticks[], const uint8_t _levels[], int _count){
+	int val[5];
+	int bits = DHT::Decode(_ticks, _levels, _count, val);
+	int ok = bits == 40 && ((val[0] + val[1] + val[2] + val[3]) & 0xFF) == val[4];
+	for (int i = 0; i < 5; i++){
+		ok = ok && val[i] == _r.val[i];
+	}
+	ok = ok && DHT::Calc_Temp(val, _r.type) == _r.temp && DHT::Calc_Humi(val, _r.type) == _r.humi;
+	if (ok == 0){
+		printf("  %s: %d bits %d %d %d %d %d\n", _r.name, bits, val[0], val[1], val[2], val[3], val[4]);
+	}
+	return ok;
+}
+
+int bench_decode(){
+	/* replays the recorded edges through DHT::Decode, the same frames
+	 * with spare edges before, which make the recording longer than DHT_MAX_EDGES
+	*/
+	uint32_t ticks[2 * DHT_MAX_EDGES];
+	uint8_t levels[2 * DHT_MAX_EDGES];
+	int correct = 0;
+	int runs = 0;
+
+	for (int r = 0; r < 2; r++){
+		for (int spare = 0; spare <= DHT_MAX_EDGES; spare += DHT_MAX_EDGES){	// glitches of the line before the frame
+			uint32_t tick = replays[r].start;
+			int count = 0;
+			for (int i = 0; i < spare; i++){
+				tick += 10;
+				ticks[count] = tick;
+				levels[count++] = i % 2 == 0 ? HAL_HIGH : HAL_LOW;
+			}
+			for (int i = 0; i < REPLAY_EDGES; i++){
+				tick += replays[r].us[i];
+				ticks[count] = tick;
+				levels[count++] = i % 2 == 0 ? HAL_HIGH : HAL_LOW;
+			}
+			correct += check_decode(replays[r], ticks, levels, count);
+			runs++;
+		}
+	}
+	printf("%-28s %8d/%d correct\n", "DHT Decode replay", correct, runs);
+	return runs - correct;
+}
+
+int bench_scheduler(){
+	LCD_MCP23008_I2C lcd(LCD_ADDR,2,16,sim);
+	SevenSegment seg(SEG_ADDR,sim);
+	BusScheduler bus(sim);
+	char text[41];
+	int errors = 0;
+
+	lcd.Init();
+	sim->Set_Realtime(true);											// the bus thread must not run ahead of this thread in virtual time
+	for (int mode = 0; mode < 2; mode++){
+		if (mode == 1){
+			lcd.Scheduler(&bus);
+			seg.set_scheduler(&bus);
+		}
+		lcd.SetCursor(0,0);
+
+		uint64_t start = sim->Time();
+		lcd.Print("typing effect", 10);									// 13 characters, 10ms each
+		uint64_t returned = sim->Time();
+		seg.set_digit(0, mode + 1);
+		seg.commit();
+		uint64_t committed = sim->Time();
+		while (sim->HT16K33_RAM(SEG_ADDR, 0) != (mode == 0 ? 0x06 : 0x5B)){	// till the frame is on the display
+			std::this_thread::yield();
+		}
+		uint64_t shown = sim->Time();
+		bus.Flush();
+
+		printf("%-28s Print returns after %8.1f us, 7-Segment frame %6.1f us after commit\n", mode == 1 ? "Print(delay) scheduled" : "Print(delay) direct", (float)(returned - start), (float)(shown - committed));
+		sim->LCD_Text(LCD_ADDR, 0, text, 13);
+		errors += strcmp(text, "typing effect") != 0;
+	}
+
+	lcd.BatchMode(false);												// single GPIO writes, the scheduler merges them
+	unsigned transfers = bus.Transfers();
+	unsigned transactions = lcd.Transactions();
+	lcd.PrintLine("merged writes",1);
+	bus.Flush();
+	printf("%-28s %8u writes queued, %u transfers sent\n", "PrintLine single scheduled", lcd.Transactions() - transactions, bus.Transfers() - transfers);
+	sim->LCD_Text(LCD_ADDR, 1, text, 13);
+	errors += strcmp(text, "merged writes") != 0;
+	if (sim->LCD_Violations(LCD_ADDR) > 0){
+		printf("  %u bytes sent while the HD44780 was busy\n", sim->LCD_Violations(LCD_ADDR));
+		errors++;
+	}
+
+	sim->Set_Realtime(false);
+	lcd.Term();															// the drivers leave the scheduler before it is destroyed
+	seg.set_scheduler(NULL);
+	return errors;
+}
+
+int bench_dht_array(){
+	/* one reading of 1 and of 3 sensors on other pins, the 3 answer at the same time
+	*/
+	const int pins[3] = {5, 6, 13};
+	const int types[3] = {DHT11, DHT22, DHT11};
+	const float temps[3] = {21.0, -5.5, 30.0};
+	const float humis[3] = {40.0, 60.5, 70.0};
+	uint64_t us[2];
+	int errors = 0;
+
+	for (int i = 0; i < 3; i++){
+		sim->Attach_DHT(pins[i], types[i], temps[i], humis[i]);
+	}
+	for (int n = 1; n <= 3; n += 2){
+		DHTArray array(sim);
+		for (int i = 0; i < n; i++){
+			errors += array.Add(pins[i], types[i]) != i;
+		}
+		uint64_t start = sim->Time();
+		int correct = array.Read();
+		us[n / 2] = sim->Time() - start;
+		printf("DHTArray Read %d sensor%-10s %8d/%d correct %19.1f us\n", n, n > 1 ? "s" : "", correct, n, (float)us[n / 2]);
+		errors += correct != n;
+		for (int i = 0; i < n; i++){
+			const DHT_result &result = array.Get(i);
+			errors += result.ok == false || result.temp != temps[i] || result.humi != humis[i];
+		}
+		errors += array.Get(n).pin != -1;								// no such sensor
+	}
+	printf("  %.1f C %.1f %%, %.1f C %.1f %%, %.1f C %.1f %%\n", temps[0], humis[0], temps[1], humis[1], temps[2], humis[2]);
+	errors += us[1] > us[0] + 1000;										// 3 sensors take about as long as one
+	return errors;
+}
+
+int bench_dht_history(){
+	/* a DHT22 ramp of +0.1 C and -0.1 % every 10 s, then a gap longer than all windows
+	*/
+	const uint32_t windows[2] = {60, 600};
+	DHT_History history(100, windows, 2);
+	DHT_history_stats stats;
+	int val[5];
+	int errors = 0;
+
+	for (int i = 0; i < 120; i++){										// 20 minutes, the ring keeps the last 100
+		int temp = 200 + i;												// tenths
+		int humi = 500 - i;
+		val[0] = humi >> 8;
+		val[1] = humi & 0xFF;
+		val[2] = temp >> 8;
+		val[3] = temp & 0xFF;
+		val[4] = (val[0] + val[1] + val[2] + val[3]) & 0xFF;
+		history.Add(val, DHT22, 10000 * i);
+	}
+	errors += history.Count() != 100;
+	for (int w = 0; w < 2; w++){
+		int n = windows[w] / 10;										// samples in the window
+		float first = 0.1 * (120 - n);									// rise of the oldest sample in the window
+		float last = 0.1 * 119;
+		errors += history.Stats(w, stats) != 1 || (int)stats.count != n;
+		errors += fabs(stats.temp_min - (20.0 + first)) > 0.01 || fabs(stats.temp_max - (20.0 + last)) > 0.01;
+		errors += fabs(stats.humi_min - (50.0 - last)) > 0.01 || fabs(stats.humi_max - (50.0 - first)) > 0.01;
+		errors += fabs(stats.temp_mean - (20.0 + (first + last) / 2)) > 0.01 || fabs(stats.humi_mean - (50.0 - (first + last) / 2)) > 0.01;
+		errors += fabs(stats.temp_trend - 36.0) > 0.1 || fabs(stats.humi_trend + 36.0) > 0.1;	// 0.1 per 10 s = 36 per hour
+		printf("DHT_History %4u s window %8u samples %8.2f C %6.1f C/h\n", stats.window, stats.count, stats.temp_mean, stats.temp_trend);
+	}
+	history.Add(val, DHT22, 10000 * 119 + 700000);						// all older samples left both windows
+	for (int w = 0; w < 2; w++){
+		errors += history.Stats(w, stats) != 1 || stats.count != 1 || stats.temp_trend != 0.0;
+	}
+	printf("  after a gap of 700 s %14u sample  in every window\n", stats.count);
+	return errors;
+}
+
+int main(int argc, char *argv[]){
+	int errors = 0;
+
+	BusTrace::Enable(argc > 1 && strcmp(argv[1], "trace") == 0);
+
+	errors += bench_lcd();
+	errors += bench_segment();
+	errors += bench_dht();
+	errors += bench_decode();
+	errors += bench_dht_array();
+	errors += bench_dht_history();
+	errors += bench_scheduler();
+
+	if (BusTrace::Enabled()){
+		BusTrace::Dump(stdout);
+	}
+
+	if (errors > 0){
+		printf("%d checks failed\n", errors);
+		return 1;
+	}
+	return 0;
+}
@@ -1,21 +1,24 @@
 /* JoyPi C++ driver with PIGPIO */
-#include "dht.h"																								// own header file
-#include <pigpio.h>																								// used for PiGPIO
-#include <stdlib.h>																								// used for exit function
+#include "dht11.h"																							// own header file
 #include <stdio.h>																								// for printf
+#include <chrono>																								// for the snapshot time stamps
 
+static thread_local DHT *dispatch_sensor = NULL;															// sensor, whose callbacks run on this thread now
 
 /* DHT temperature and huminity sensor */
-DHT::DHT(int _pin, int _type){
+DHT::DHT(int _pin, int _type, HAL *_hal){
+	DHT::_hal = _hal;													// GPIO and time by this backend
 	
-	if (gpioInitialise() < 0){											// if initialisation of pigpio failed
+	if ((DHT::_status=DHT::_hal->Init()) < 0){						// if initialisation of pigpio failed
 		printf("##############################################\n");
 		printf("#              Can't use PIGPIO!             #\n");
 		printf("# Maybe PIGPIO is used by an other instance? #\n");
 		printf("##############################################\n");
-		exit (EXIT_FAILURE);											// exit the program
+		DHT::pin = DHT_PIN;												// Status returns the error, Read returns 0
+		DHT::_type = _type;
 	}
 	else{																// pigpio initialised okay.
+		DHT::_acquired = true;
 		if (_pin>=0 && _pin<=26){ 										// pin number looks valid? (BCM number needed)
 			DHT::pin = _pin;											// set pin to given _pin number
 		}
@@ -23,19 +26,135 @@ DHT::DHT(int _pin, int _type){
 			DHT::pin = DHT_PIN;											// set default pin
 		}
 		DHT::_type = _type;
-		gpioSetMode(DHT::pin, PI_OUTPUT);								// set the pin as output
-		gpioSetPullUpDown(DHT::pin, PI_PUD_OFF);						// turn off every Pull resistors
+		DHT::_hal->GPIO_Mode(DHT::pin, HAL_OUTPUT);								// set the pin as output
+		DHT::_hal->GPIO_Pull(DHT::pin, HAL_PUD_OFF);						// turn off every Pull resistors
 	}	
 }
 
 DHT::~DHT(){
-	gpioTerminate();													// close GPIO conection
+	DHT::Stop_Sampling();												// the sampler must not outlive the sensor
+	DHT::Terminate();													// close GPIO conection
+}
+
+int DHT::Status(){
+	return DHT::_status;
 }
 
 int DHT::Read(){
+	if (DHT::_acquired == false){										// no GPIO: the constructor failed or Terminate was called
+		return 0;
+	}
+	uint32_t _start = DHT::_hal->Tick();
+	int _ok = 0;
+	if (DHT::_mode == DHT_MODE_ALERT){									// if edge callbacks are used
+		_ok = DHT::Read_Alert();										// measure the time between the edges
+	}
+	else {
+		_ok = DHT::Read_Poll();											// else poll the pin
+	}
+	if (BusTrace::Enabled()){											// tracing: the whole reading
+		BusTrace::Record(BUS_TRACE_GPIO + DHT::pin, BUS_TRACE_SENSOR, 5, _ok == 1 ? 0 : -1, _start, DHT::_hal->Tick());
+	}
+	DHT::Count_Result(_ok, _start);
+	return _ok;
+}
+
+int DHT::Read_Retry(){
+	if (DHT::_acquired == false){
+		return 0;
+	}
+	uint32_t _left = DHT::Gap_Left();
+	{
+		std::lock_guard<std::mutex> lock(DHT::_sampling_lock);
+		if (DHT::_degraded == true && _left > 0){						// backing off: don't spend a reading on a missing sensor
+			return -1;
+		}
+	}
+	for (int i = 0; ; i++){
+		if (_left > 0){
+			DHT::_hal->Delay(_left);									// the sensor needs its pause between two readings
+		}
+		if (DHT::Read() == 1){
+			return 1;
+		}
+		std::lock_guard<std::mutex> lock(DHT::_sampling_lock);
+		if (i >= DHT::_policy.retries || DHT::_degraded == true){		// no retries for a degraded sensor
+			return 0;
+		}
+		_left = DHT::Min_Period() * 1000;
+	}
+}
+
+void DHT::Set_Mode(int _mode){
+	if (_mode == DHT_MODE_ALERT){										// only known modes
+		DHT::_mode = DHT_MODE_ALERT;
+	}
+	else {
+		DHT::_mode = DHT_MODE_POLL;
+	}
+}
+
+int DHT::Read_Step(uint32_t &_wait){
+	if (DHT::_acquired == false){
+		_wait = 0;
+		return 0;
+	}
+	if (DHT::_step == 0){												// start: pull the pin low
+		uint32_t _left = DHT::Gap_Left();
+		if (_left > 0){													// too early or backing off: the pin isn't touched
+			_wait = _left;
+			return -1;
+		}
+		for (int i = 0; i < 5; i++)
+		{
+			DHT_val[i] = 0;
+		}
+		DHT::_edges.count = 0;
+		DHT::_step_start = DHT::_hal->Tick();
+		DHT::_hal->GPIO_Mode(DHT::pin, HAL_OUTPUT);
+		DHT::_hal->GPIO_Write(DHT::pin,HAL_LOW);
+		DHT::_step = 1;
+		_wait = 20000;													// 18ms of the datasheet, a late release doesn't matter
+		return -1;
+	}
+	if (DHT::_step == 1){												// release the pin and record the answer
+		DHT::_hal->GPIO_Alert(DHT::pin, DHT::Alert_Callback, &_edges);
+		DHT::_hal->GPIO_Write(DHT::pin,HAL_HIGH);
+		DHT::_hal->GPIO_Mode(DHT::pin, HAL_INPUT);
+		DHT::_hal->GPIO_Pull(DHT::pin,HAL_PUD_UP);
+		DHT::_step_release = DHT::_hal->Tick();
+		DHT::_step = 2;
+		_wait = 5000;													// the frame takes ~5ms
+		return -1;
+	}
+	if (DHT::_edges.count < DHT_FRAME_EDGES && DHT::_hal->Tick() - DHT::_step_release < DHT_ALERT_TIMEOUT * 1000){
+		_wait = 1000;													// frame not complete yet
+		return -1;
+	}
+	DHT::_hal->GPIO_Alert(DHT::pin, NULL, NULL);						// stop recording
+	DHT::_step = 0;
+	_wait = 0;
+	
+	int j = DHT::Decode(DHT::_edges.tick, DHT::_edges.level, DHT::_edges.count, DHT_val);
+	int _ok = (j >= 40) && (DHT_val[4] == ((DHT_val[0] + DHT_val[1] + DHT_val[2] + DHT_val[3]) & 0xFF));
+	DHT::_bits = j;
+	if (BusTrace::Enabled()){
+		BusTrace::Record(BUS_TRACE_GPIO + DHT::pin, BUS_TRACE_SENSOR, 5, _ok == 1 ? 0 : -1, DHT::_step_start, DHT::_hal->Tick());
+	}
+	DHT::Count_Result(_ok, DHT::_step_start);
+	if (_ok == 1){
+		DHT::Publish(DHT::Calc_Temp(DHT_val, DHT::_type), DHT::Calc_Humi(DHT_val, DHT::_type), true);
+	}
+	else {																// wrong reading: keep the last values
+		DHT::Publish(DHT::_snap_temp, DHT::_snap_humi, false);
+	}
+	return _ok;
+}
+
+int DHT::Read_Poll(){
 	/* Initialize the values */
 	int returnValue = 0;
-	uint8_t lststate = PI_HIGH;
+	uint8_t lststate = HAL_HIGH;
 	uint8_t counter = 0, j = 0, i = 0;
 	for (i = 0; i < 5; i++)
 	{
@@ -43,25 +162,25 @@ int DHT::Read(){
 	}
 	
 	/* Signal the sensor to send data */
-	gpioSetMode(DHT::pin, PI_OUTPUT);									// set pin as output
-	gpioWrite(DHT::pin,PI_LOW);											// set pin to low (0)
-	gpioDelay(20000);													// Datasheet states that we should wait 18ms --> 20ms to be save
+	DHT::_hal->GPIO_Mode(DHT::pin, HAL_OUTPUT);									// set pin as output
+	DHT::_hal->GPIO_Write(DHT::pin,HAL_LOW);											// set pin to low (0)
+	DHT::_hal->Delay(20000);													// Datasheet states that we should wait 18ms --> 20ms to be save
 	
 	/* Set the pin to high and switch to input mode */
-	gpioWrite(DHT::pin,PI_HIGH);										// set pin to high (1)
-	gpioDelay(50);														// sleep 20us - 40us --> 50µs to be save
-	gpioSetMode(DHT::pin, PI_INPUT);									// set pin as input
-	gpioSetPullUpDown(DHT::pin,PI_PUD_UP);								// turn on pull up resistor
+	DHT::_hal->GPIO_Write(DHT::pin,HAL_HIGH);										// set pin to high (1)
+	DHT::_hal->Delay(50);														// sleep 20us - 40us --> 50µs to be save
+	DHT::_hal->GPIO_Mode(DHT::pin, HAL_INPUT);									// set pin as input
+	DHT::_hal->GPIO_Pull(DHT::pin,HAL_PUD_UP);								// turn on pull up resistor
 	
 	
 	/* Get the bits */
 	for (i = 0; i < DHT_MAX_TIME; i++)
 	{
 		counter = 0;
-		while (gpioRead(DHT::pin) == lststate)
+		while (DHT::_hal->GPIO_Read(DHT::pin) == lststate)
 		{
 			counter++;
-			gpioDelay(1);
+			DHT::_hal->Delay(1);
 
 			if (counter == 255)
 			{
@@ -69,7 +188,7 @@ int DHT::Read(){
 			}
 		}
 
-		lststate = gpioRead(DHT::pin);
+		lststate = DHT::_hal->GPIO_Read(DHT::pin);
 
 		if (counter == 255)
 		{
@@ -93,6 +212,7 @@ int DHT::Read(){
 	}
 	
 	/* Verify checksum and print the verified data */
+	DHT::_bits = j;
 	if ((j >= 40) && (DHT_val[4] == ((DHT_val[0] + DHT_val[1] + DHT_val[2] + DHT_val[3]) & 0xFF))){
 		returnValue = 1;
 	}
@@ -103,20 +223,395 @@ int DHT::Read(){
 	return returnValue;
 }
 
+int DHT::Read_Alert(){
+	int returnValue = 0;
+	int j = 0;
+	for (int i = 0; i < 5; i++)
+	{
+		DHT_val[i] = 0;
+	}
+	DHT::_edges.count = 0;												// forget the edges of the last reading
+	
+	/* Signal the sensor to send data */
+	DHT::_hal->GPIO_Mode(DHT::pin, HAL_OUTPUT);									// set pin as output
+	DHT::_hal->GPIO_Write(DHT::pin,HAL_LOW);											// set pin to low (0)
+	DHT::_hal->Delay(20000);													// Datasheet states that we should wait 18ms --> 20ms to be save
+	
+	/* Record the edges from now on */
+	DHT::_hal->GPIO_Alert(DHT::pin, DHT::Alert_Callback, &_edges);		// every edge calls Alert_Callback with its tick
+	
+	/* Release the pin, the sensor answers 20us - 40us later */
+	DHT::_hal->GPIO_Write(DHT::pin,HAL_HIGH);										// set pin to high (1)
+	DHT::_hal->GPIO_Mode(DHT::pin, HAL_INPUT);									// set pin as input, no wait needed: every edge is recorded
+	DHT::_hal->GPIO_Pull(DHT::pin,HAL_PUD_UP);								// turn on pull up resistor
+	
+	/* Sleep while the sensor is sending (~5ms) */
+	for (int i = 0; i < DHT_ALERT_TIMEOUT; i++)
+	{
+		if (DHT::_edges.count >= DHT_FRAME_EDGES)						// all edges of the frame are there
+		{
+			break;
+		}
+		DHT::_hal->Delay(1000);												// sleep 1ms, the HAL delivers the alerts in the meantime
+	}
+	DHT::_hal->GPIO_Alert(DHT::pin, NULL, NULL);							// stop recording
+	
+	/* Get the bits */
+	j = DHT::Decode(DHT::_edges.tick, DHT::_edges.level, DHT::_edges.count, DHT_val);
+	
+	/* Verify checksum */
+	DHT::_bits = j;
+	if ((j >= 40) && (DHT_val[4] == ((DHT_val[0] + DHT_val[1] + DHT_val[2] + DHT_val[3]) & 0xFF))){
+		returnValue = 1;
+	}
+	else{
+		returnValue = 0;
+	}
+	
+	return returnValue;
+}
+
+void DHT::Alert_Callback(int _gpio, int _level, uint32_t _tick, void *_userdata){
+	DHT_edges *edges = (DHT_edges *)_userdata;							// the edges of the sensor who registered the alert
+	int count = edges->count;
+	
+	if (_level == HAL_TIMEOUT || count >= DHT_MAX_EDGES){				// no edge (watchdog) or buffer full
+		return;
+	}
+	edges->tick[count] = _tick;											// save tick and level of this edge
+	edges->level[count] = _level;
+	edges->count = count + 1;											// publish the edge to the reader
+}
+
+int DHT::Start_Sampling(int _period){
+	int minPeriod = DHT11_MIN_PERIOD;
+	
+	if (DHT::_type == DHT22){											// the DHT22 needs a longer break
+		minPeriod = DHT22_MIN_PERIOD;
+	}
+	if (_period < minPeriod){											// sensor can't be read faster
+		_period = minPeriod;
+	}
+	
+	std::lock_guard<std::mutex> lock(DHT::_sampling_lock);
+	if (DHT::_sampling == true){										// only one sampler per sensor
+		return 0;
+	}
+	DHT::_sampling = true;
+	DHT::_sampler = std::thread(&DHT::Sampler, this, _period);			// start reading in the background
+	return 1;
+}
+
+void DHT::Stop_Sampling(){
+	{
+		std::lock_guard<std::mutex> lock(DHT::_sampling_lock);
+		DHT::_sampling = false;											// let the sampler loop end
+	}
+	DHT::_sampling_wake.notify_all();									// and wake it up if it sleeps
+	if (DHT::_sampler.joinable()){
+		DHT::_sampler.join();											// wait till the sampler has finished
+	}
+}
+
+int DHT::Get_Sample(DHT_sample &_sample){
+	uint32_t seq = 0;
+	int64_t time = 0;
+	
+	do {
+		seq = DHT::_snap_seq.load(std::memory_order_acquire);
+		_sample.temp = DHT::_snap_temp.load(std::memory_order_relaxed);
+		_sample.humi = DHT::_snap_humi.load(std::memory_order_relaxed);
+		_sample.valid = DHT::_snap_valid.load(std::memory_order_relaxed);
+		time = DHT::_snap_time.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	} while ((seq & 1) || seq != DHT::_snap_seq.load(std::memory_order_relaxed));	// retry if the sampler wrote in the meantime
+	
+	if (time == 0){														// no correct reading till now
+		_sample.age = -1;
+		return 0;
+	}
+	_sample.age = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - time;
+	return 1;
+}
+
+void DHT::Sampler(int _period){
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock(DHT::_sampling_lock);
+	int retry = 0;														// retries done after the last regular reading
+	
+	while (DHT::_sampling == true){
+		lock.unlock();													// don't block Stop_Sampling while reading
+		int ok = DHT::Read();
+		if (ok == 1){													// correct reading: new values
+			DHT::Publish(DHT::Get_Temp(), DHT::Get_Humi(), true);
+		}
+		else {															// wrong reading: keep the last values
+			DHT::Publish(DHT::_snap_temp, DHT::_snap_humi, false);
+		}
+		lock.lock();
+		
+		int wait = _period;
+		if (ok == 1){
+			retry = 0;
+		}
+		else if (DHT::_degraded == true){								// back off, no retries
+			retry = 0;
+			if (DHT::_backoff > wait){
+				wait = DHT::_backoff;
+			}
+		}
+		else if (retry < DHT::_policy.retries){							// try again after the pause of the sensor
+			retry++;
+			wait = DHT::Min_Period();
+		}
+		else {
+			retry = 0;
+		}
+		next += std::chrono::milliseconds(wait);
+		DHT::_sampling_wake.wait_until(lock, next, [this]{ return DHT::_sampling == false; });	// sleep till the next reading or stop
+	}
+}
+
+void DHT::Publish(float _temp, float _humi, bool _valid){
+	uint32_t seq = DHT::_snap_seq.load(std::memory_order_relaxed);
+	
+	DHT::_snap_seq.store(seq + 1, std::memory_order_relaxed);			// odd: snapshot is written
+	std::atomic_thread_fence(std::memory_order_release);
+	DHT::_snap_temp.store(_temp, std::memory_order_relaxed);
+	DHT::_snap_humi.store(_humi, std::memory_order_relaxed);
+	DHT::_snap_valid.store(_valid, std::memory_order_relaxed);
+	if (_valid == true){												// age counts from the last correct reading
+		DHT::_snap_time.store(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+	}
+	DHT::_snap_seq.store(seq + 2, std::memory_order_release);			// even: snapshot is complete
+}
+
+int DHT::Decode(const uint32_t _ticks[], const uint8_t _levels[], int _count, int _val[5]){
+	uint32_t high[40];													// length of the last 40 high pulses in µs (ring, any _count fits)
+	int highs = 0;
+	int first = 0;
+	int j = 0;
+	
+	for (int i = 0; i < 5; i++)
+	{
+		_val[i] = 0;
+	}
+	
+	/* Measure the high pulses */
+	for (int i = 1; i < _count; i++)
+	{
+		if (_levels[i - 1] == HAL_HIGH && _levels[i] == HAL_LOW)			// falling edge after a rising edge
+		{
+			high[highs % 40] = _ticks[i] - _ticks[i - 1];				// unsigned difference is safe on tick wrap around
+			highs++;
+		}
+	}
+	
+	/* The last 40 high pulses are the data bits */
+	if (highs > 40)
+	{
+		first = highs - 40;												// skip the response pulse of the sensor
+	}
+	for (int i = first; i < highs; i++)
+	{
+		_val[j / 8] <<= 1;
+		
+		if (high[i % 40] > DHT_BIT_THRESHOLD)
+		{
+			_val[j / 8] |= 1;
+		}
+		
+		j++;
+	}
+	
+	return j;
+}
+
 float DHT::Get_Temp(){
+	return DHT::Calc_Temp(DHT::_good_val, DHT::_type);
+}
+
+float DHT::Get_Humi(){
+	return DHT::Calc_Humi(DHT::_good_val, DHT::_type);
+}
+
+void DHT::Set_Policy(const DHT_policy &_policy){
+	std::lock_guard<std::mutex> lock(DHT::_sampling_lock);
+	DHT::_policy = _policy;
+	if (DHT::_policy.retries < 0){
+		DHT::_policy.retries = 0;
+	}
+	if (DHT::_policy.window < 1){
+		DHT::_policy.window = 1;
+	}
+	if (DHT::_policy.window > DHT_STAT_WINDOW){							// the history has only DHT_STAT_WINDOW bits
+		DHT::_policy.window = DHT_STAT_WINDOW;
+	}
+	if (DHT::_policy.max_backoff < DHT::Min_Period()){
+		DHT::_policy.max_backoff = DHT::Min_Period();
+	}
+	if (DHT::_history_count > DHT::_policy.window){
+		DHT::_history_count = DHT::_policy.window;
+	}
+}
+
+DHT_policy DHT::Get_Policy(){
+	std::lock_guard<std::mutex> lock(DHT::_sampling_lock);
+	return DHT::_policy;
+}
+
+void DHT::Get_Stats(DHT_stats &_stats){
+	std::lock_guard<std::mutex> lock(DHT::_sampling_lock);
+	uint32_t mask = DHT::_policy.window >= 32 ? 0xFFFFFFFF : (1u << DHT::_policy.window) - 1;	// readings of the window
+	
+	_stats.reads = DHT::_reads;
+	_stats.checksum_errors = DHT::_checksum_errors;
+	_stats.timeouts = DHT::_timeouts;
+	_stats.checksum_rate = 0.0;
+	_stats.timeout_rate = 0.0;
+	if (DHT::_history_count > 0){
+		_stats.checksum_rate = (float)__builtin_popcount(DHT::_checksum_history & mask) / DHT::_history_count;
+		_stats.timeout_rate = (float)__builtin_popcount(DHT::_timeout_history & mask) / DHT::_history_count;
+	}
+	_stats.degraded = DHT::_degraded;
+	_stats.backoff = DHT::_backoff;
+}
+
+void DHT::Reset_Stats(){
+	std::lock_guard<std::mutex> lock(DHT::_sampling_lock);
+	DHT::_checksum_history = 0;
+	DHT::_timeout_history = 0;
+	DHT::_history_count = 0;
+	DHT::_reads = 0;
+	DHT::_checksum_errors = 0;
+	DHT::_timeouts = 0;
+	DHT::_degraded = false;
+	DHT::_backoff = 0;
+}
+
+int DHT::Min_Period(){
+	return DHT::_type == DHT22 ? DHT22_MIN_PERIOD : DHT11_MIN_PERIOD;
+}
+
+int DHT::Add_Callback(DHT_callback _func, void *_userdata){
+	std::lock_guard<std::mutex> lock(DHT::_sampling_lock);
+	if (DHT::_callback_count >= DHT_MAX_CALLBACKS){
+		return 0;
+	}
+	DHT::_callbacks[DHT::_callback_count].func = _func;
+	DHT::_callbacks[DHT::_callback_count].userdata = _userdata;
+	DHT::_callback_count++;
+	return 1;
+}
+
+void DHT::Remove_Callback(DHT_callback _func, void *_userdata){
+	std::unique_lock<std::mutex> lock(DHT::_sampling_lock);
+	for (int i = 0; i < DHT::_callback_count; i++){
+		if (DHT::_callbacks[i].func == _func && DHT::_callbacks[i].userdata == _userdata){
+			DHT::_callbacks[i] = DHT::_callbacks[--DHT::_callback_count];	// the order doesn't matter
+			break;
+		}
+	}
+	DHT::_dispatch_done.wait(lock, [this]{								// a reading may call it right now with the old list
+		return DHT::_dispatching == (dispatch_sensor == this ? 1 : 0);	// not for the call, which removes itself
+	});
+}
+
+void DHT::Count_Result(int _ok, uint32_t _start){
+	std::unique_lock<std::mutex> lock(DHT::_sampling_lock);
+	uint32_t mask = DHT::_policy.window >= 32 ? 0xFFFFFFFF : (1u << DHT::_policy.window) - 1;
+	
+	DHT::_reads++;
+	DHT::_checksum_history <<= 1;										// bit 0 is the new reading
+	DHT::_timeout_history <<= 1;
+	if (_ok == 1){
+		for (int i = 0; i < 5; i++){
+			DHT::_good_val[i] = DHT_val[i];								// Get_Temp / Get_Humi keep the last correct values
+		}
+	}
+	else if (DHT::_bits < 40){											// no answer or lost edges
+		DHT::_timeout_history |= 1;
+		DHT::_timeouts++;
+	}
+	else {
+		DHT::_checksum_history |= 1;
+		DHT::_checksum_errors++;
+	}
+	if (DHT::_history_count < DHT::_policy.window){
+		DHT::_history_count++;
+	}
+	DHT::_last_read = _start;
+	DHT::_read_once = true;
+	
+	float rate = (float)__builtin_popcount((DHT::_checksum_history | DHT::_timeout_history) & mask) / DHT::_history_count;
+	if (DHT::_degraded == false){
+		if (DHT::_history_count * 2 >= DHT::_policy.window && rate >= DHT::_policy.degraded_rate){
+			DHT::_degraded = true;										// stop wasting readings on the sensor
+			DHT::_backoff = DHT::Min_Period() * 2;
+		}
+	}
+	else if (_ok == 1){
+		DHT::_backoff = DHT::Min_Period();								// read at the normal pace till the rate is low again
+		if (rate < DHT::_policy.degraded_rate / 2){
+			DHT::_degraded = false;
+			DHT::_backoff = 0;
+		}
+	}
+	else {
+		DHT::_backoff *= 2;
+		if (DHT::_backoff > DHT::_policy.max_backoff){
+			DHT::_backoff = DHT::_policy.max_backoff;
+		}
+	}
+	
+	if (_ok == 1 && DHT::_callback_count > 0){
+		callback calls[DHT_MAX_CALLBACKS];								// call them without the lock, they may ask for the stats
+		int val[5];														// copy: an other reading may change _good_val meanwhile
+		int count = DHT::_callback_count;
+		for (int i = 0; i < count; i++){
+			calls[i] = DHT::_callbacks[i];
+		}
+		for (int i = 0; i < 5; i++){
+			val[i] = DHT::_good_val[i];
+		}
+		DHT::_dispatching++;											// Remove_Callback waits till the calls are done
+		lock.unlock();
+		DHT *outer = dispatch_sensor;
+		dispatch_sensor = this;
+		for (int i = 0; i < count; i++){
+			calls[i].func(val, DHT::_type, _start, calls[i].userdata);
+		}
+		dispatch_sensor = outer;
+		lock.lock();
+		DHT::_dispatching--;
+		DHT::_dispatch_done.notify_all();
+	}
+}
+
+uint32_t DHT::Gap_Left(){
+	std::lock_guard<std::mutex> lock(DHT::_sampling_lock);
+	if (DHT::_read_once == false){
+		return 0;
+	}
+	uint32_t gap = (DHT::_degraded ? DHT::_backoff : DHT::Min_Period()) * 1000;
+	uint32_t elapsed = DHT::_hal->Tick() - DHT::_last_read;				// unsigned difference is safe on tick wrap around
+	return elapsed >= gap ? 0 : gap - elapsed;
+}
+
+float DHT::Calc_Temp(const int _val[5], int _type){
 	float returnTemp=0.0;
 	
-	switch(DHT::_type){
+	switch(_type){
 		case DHT11:
-			returnTemp = int(DHT_val[2]);
-			if (DHT_val[3] & 0x80){
+			returnTemp = int(_val[2]);
+			if (_val[3] & 0x80){
 				returnTemp = -1 - returnTemp;
 			}
-			returnTemp += int(DHT_val[3] & 0x0f)/10.0;
+			returnTemp += int(_val[3] & 0x0f)/10.0;
 			break;
 		case DHT22:
-			returnTemp = ((int(DHT_val[2] & 0x7F) << 8) + int(DHT_val[3])) / 10.0;
-			if (DHT_val[2] & 0x80){
+			returnTemp = ((int(_val[2] & 0x7F) << 8) + int(_val[3])) / 10.0;
+			if (_val[2] & 0x80){
 				returnTemp *= -1;
 			}
 			break;
@@ -125,15 +620,15 @@ float DHT::Get_Temp(){
 	return returnTemp;
 }
 
-float DHT::Get_Humi(){
+float DHT::Calc_Humi(const int _val[5], int _type){
 	float returnHumi=0.0;
 
-	switch(DHT::_type){
+	switch(_type){
 		case DHT11:
-			returnHumi= int(DHT_val[0]) + int(DHT_val[1])/10.0;
+			returnHumi= int(_val[0]) + int(_val[1])/10.0;
 			break;
 		case DHT22:
-			returnHumi = ((int(DHT_val[0] << 8)) + int(DHT_val[1])) / 10.0;
+			returnHumi = ((int(_val[0] << 8)) + int(_val[1])) / 10.0;
 			break;
 	}
 	
@@ -142,5 +637,8 @@ float DHT::Get_Humi(){
 }
 
 void DHT::Terminate(){
-	gpioTerminate();
+	if (DHT::_acquired == true){										// release the HAL only once, other drivers may still use it
+		DHT::_acquired = false;
+		DHT::_hal->Term();
+	}
 }
@@ -1,9 +1,69 @@
+#pragma once
+#include "../Common/hal.h"												// GPIO and time of the Raspberry Pi or the simulation
+#include "../Common/bus_trace.h"										// optional tracing of the readings
 #include <inttypes.h>													// used for the int types like uint8_t
+#include <atomic>														// used for the edge counter shared with the alert callback
+#include <thread>														// used for the sampler thread
+#include <mutex>														// used to wake up the sampler thread on stop
+#include <condition_variable>											// used to wake up the sampler thread on stop
 
 #define DHT11 						11
 #define DHT22 						22
 #define DHT_PIN 					4
 #define DHT_MAX_TIME 				85
+#define DHT_MODE_POLL				0										// read by polling the pin (counting loop iterations)
+#define DHT_MODE_ALERT				1										// read by edge callbacks (measuring µs between edges)
+#define DHT_MAX_EDGES				100										// 2 edges per bit (80) + response (4) + spare edges
+#define DHT_FRAME_EDGES				84										// edges of a complete frame, reading can stop here
+#define DHT_BIT_THRESHOLD			50										// high pulse in µs: 26-28µs = bit 0, 70µs = bit 1
+#define DHT_ALERT_TIMEOUT			20										// max ms to wait for the frame after the start pulse
+#define DHT11_MIN_PERIOD			1000									// min ms between two readings of a DHT11 (datasheet)
+#define DHT22_MIN_PERIOD			2000									// min ms between two readings of a DHT22 (datasheet)
+#define DHT_STAT_WINDOW				32										// max readings of the rolling failure rates (bits of the history)
+#define DHT_RETRIES					2										// default retries of Read_Retry after a wrong reading
+#define DHT_DEGRADED_RATE			0.5										// default failure rate, from which the sensor is degraded
+#define DHT_MAX_BACKOFF				60000									// default max ms between two readings of a degraded sensor
+#define DHT_MAX_CALLBACKS			4										// max count of reading callbacks of one sensor
+
+typedef void (*DHT_callback)(const int _val[5], int _type, uint32_t _tick, void *_userdata);	// called after a correct reading: bytes of the frame, sensor type and tick of the start
+
+struct DHT_sample {
+	/* snapshot published by the sampler thread, see DHT::Get_Sample
+	*/
+	float temp;															// temperature of the last correct reading
+	float humi;															// humidity of the last correct reading
+	bool valid;															// true if the latest reading was correct
+	int64_t age;														// µs since the last correct reading
+};
+
+struct DHT_edges {
+	/* edges of one frame, recorded by DHT::Alert_Callback and decoded by DHT::Decode
+	*/
+	uint32_t tick[DHT_MAX_EDGES];										// tick (µs) of every recorded edge
+	uint8_t level[DHT_MAX_EDGES];										// new level of the pin at every recorded edge
+	std::atomic<int> count{0};											// count of recorded edges
+};
+
+struct DHT_policy {
+	/* read policy of a sensor, see DHT::Set_Policy
+	*/
+	int retries;														// readings after a wrong one (each after the min period of the sensor)
+	int window;															// readings of the rolling failure rates, 1 - DHT_STAT_WINDOW
+	float degraded_rate;												// failure rate of the window, from which the sensor is degraded
+	int max_backoff;													// max ms between two readings of a degraded sensor
+};
+
+struct DHT_stats {
+	/* failure statistics of a sensor, see DHT::Get_Stats
+	*/
+	unsigned reads;														// count of readings
+	unsigned checksum_errors;											// count of complete frames with a wrong checksum
+	unsigned timeouts;													// count of frames with less than 40 bits (no answer or lost edges)
+	float checksum_rate;												// checksum errors / readings of the window
+	float timeout_rate;													// timeouts / readings of the window
+	bool degraded;														// true while the failure rate is too high
+	int backoff;														// ms between two readings while degraded
+};
 
 class DHT {
 	/* class for the dht11 temperature and huminity sensor
@@ -18,14 +78,22 @@ class DHT {
 	 * 
 	*/
 public:
-	DHT(int _pin, int _type);														// constructor
+	DHT(int _pin, int _type, HAL *_hal=HAL::Default());				// constructor
 	/* give the constructor the BCM number of the pin
 	 * who the dht11 sensor are connected
+	 * _hal is the hardware backend (PiGPIO or simulation, see Common/hal.h)
 	 * 
 	*/
 	virtual ~DHT();														// desructor
+	int Status();
+	/* return 0 = ready
+	 *      < 0 = error of the HAL initialisation in the constructor,
+	 *            every Read fails then, the program goes on
+	 * 
+	*/
 	int Read();
 	/* read the 40 bit from the DHT11 sensor
+	 * with the mode set by Set_Mode (DHT_MODE_POLL by default)
 	 * check the checksum and if it correct
 	 * save the values in the dht11_val array.
 	 * 
@@ -41,30 +109,199 @@ public:
 	 * 0 = error
 	 * 
 	*/
+	int Read_Step(uint32_t &_wait);
+	/* non blocking Read for an event loop, the frame is recorded by edge callbacks
+	 * (like DHT_MODE_ALERT). Every call does the next step of the reading:
+	 * pull the pin low, release it, collect the frame. _wait is set to the µs
+	 * till the next call is due, nothing blocks in between.
+	 * The finished reading is published for Get_Sample.
+	 * Before the min period since the last reading (or the backoff of a degraded
+	 * sensor) is over, the reading doesn't start and _wait is the rest of it.
+	 * 
+	 * return 1 = correct reading
+	 *        0 = wrong reading
+	 *       -1 = reading not finished, call again after _wait µs
+	 * 
+	*/
+	int Read_Retry();
+	/* Read with the read policy (see Set_Policy): wait till the min period
+	 * of the sensor since the last reading is over, read and try again
+	 * after the min period up to policy.retries times.
+	 * A degraded sensor is read only once and only after its backoff,
+	 * before that the pin isn't touched at all.
+	 * 
+	 * return 1 = correct reading
+	 *        0 = wrong reading (all tries)
+	 *       -1 = sensor degraded, backoff not over (no reading)
+	 * 
+	*/
 	float Get_Temp();													// return temp as float value
-	/* call Read till checksum is correct (max 5 times)
-	 * then return the temperature
-	 * value as an float value 
+	/* return the temperature of the last correct
+	 * reading as an float value 
 	 * 
 	 * return the temerature as float
 	 * dht11_val[2] + dht11_val[3]/10.0
 	*/
 	float Get_Humi();													// return humidity as float value
-	/* call Read till checksum is correct  (max 5 times)
-	 * then return the humidity
-	 * value as an float value 
+	/* return the humidity of the last correct
+	 * reading as an float value 
 	 * 
 	 * return the humidity as float
 	 * dht11_val[0] + dht11_val[1]/10.0
 	*/
+	void Set_Policy(const DHT_policy &_policy);
+	/* set the read policy, the default is DHT_RETRIES retries, a window of 16 readings,
+	 * DHT_DEGRADED_RATE and DHT_MAX_BACKOFF
+	 * 
+	 * Every reading (Read, Read_Retry, Read_Step and the sampler) is counted as correct,
+	 * checksum error or timeout. If the failure rate of the last window readings reaches
+	 * degraded_rate (after at least window / 2 readings), the sensor is degraded:
+	 * no retries anymore and a backoff between the readings, which starts at twice the
+	 * min period and doubles with every wrong reading up to max_backoff.
+	 * A correct reading sets the backoff back to the min period, the sensor is ready
+	 * again when the failure rate is below degraded_rate / 2.
+	 * 
+	*/
+	DHT_policy Get_Policy();
+	/* return the read policy
+	*/
+	void Get_Stats(DHT_stats &_stats);
+	/* copy the failure statistics into _stats, may be called from any thread
+	*/
+	void Reset_Stats();
+	/* forget the failure history, the sensor isn't degraded anymore
+	*/
+	int Add_Callback(DHT_callback _func, void *_userdata);
+	/* call _func after every correct reading (Read, Read_Retry, Read_Step and the sampler)
+	 * on the thread of the reading, e.g. to fill a DHT_History (dht_history.h)
+	 * 
+	 * return 1 = added
+	 *        0 = already DHT_MAX_CALLBACKS callbacks
+	 * 
+	*/
+	void Remove_Callback(DHT_callback _func, void *_userdata);
+	/* stop calling _func with _userdata. A call running on an other thread is waited for,
+	 * so _userdata may be deleted afterwards (a callback may remove itself)
+	*/
 	void Terminate();
-	/* close and terminate the pigpio conection with the DHT11 sensor
+	/* close the GPIO conection with the DHT11 sensor
+	 * PiGPIO is terminated when no other driver uses it anymore
+	 * 
+	*/
+	void Set_Mode(int _mode);
+	/* set the way Read gets the bits from the sensor
+	 * 
+	 * DHT_MODE_POLL  = poll the pin and count loop iterations (default)
+	 * DHT_MODE_ALERT = register an alert (edge callback) on the pin and take the
+	 *                  time between the edges. The cpu sleeps while the
+	 *                  sensor is sending, and a preempted reader can't
+	 *                  misread a bit anymore.
+	 * 
+	*/
+	int Start_Sampling(int _period);
+	/* start a sampler thread, which reads the sensor every _period ms
+	 * _period is raised to DHT11_MIN_PERIOD / DHT22_MIN_PERIOD if needed.
+	 * While sampling, only Get_Sample should be used to get the values,
+	 * Read, Get_Temp and Get_Humi belong to the sampler thread.
+	 * A wrong reading is tried again after the min period (policy.retries times),
+	 * a degraded sensor is read after max(_period, backoff).
+	 * 
+	 * return 1 = sampler started
+	 *        0 = sampler was already running
+	 * 
+	*/
+	void Stop_Sampling();
+	/* stop the sampler thread and wait till it has finished
+	 * 
+	*/
+	int Get_Sample(DHT_sample &_sample);
+	/* copy the latest snapshot of the sampler thread into _sample
+	 * This never touches the GPIO and never waits for the sampler,
+	 * use _sample.age to decide if the values are too old.
+	 * 
+	 * return 1 = _sample holds a correct reading
+	 *        0 = no correct reading till now
+	 * 
+	*/
+	static float Calc_Temp(const int _val[5], int _type);
+	/* convert the 5 bytes of a frame into the temperature as float
+	 * for the given sensor _type (DHT11 or DHT22), used by Get_Temp
+	 * 
+	*/
+	static float Calc_Humi(const int _val[5], int _type);
+	/* convert the 5 bytes of a frame into the humidity as float
+	 * for the given sensor _type (DHT11 or DHT22), used by Get_Humi
+	 * 
+	*/
+	static void Alert_Callback(int _gpio, int _level, uint32_t _tick, void *_userdata);
+	/* edge callback for HAL::GPIO_Alert, records the edge into the DHT_edges _userdata
+	 * (used by the alert mode and by DHTArray)
+	 * 
+	*/
+	static int Decode(const uint32_t _ticks[], const uint8_t _levels[], int _count, int _val[5]);
+	/* decode recorded edges (tick in µs and new level of the pin) into _val
+	 * every falling edge after a rising edge ends a high pulse, the last 40
+	 * high pulses are the data bits (longer than DHT_BIT_THRESHOLD = 1).
+	 * The response pulse of the sensor and spare edges before are ignored,
+	 * so _count isn't limited to DHT_MAX_EDGES.
+	 * 
+	 * return the count of decoded bits (40 = complete frame)
+	 * the checksum is not checked here
 	 * 
 	*/
 	
 	
 private:
+	int Read_Poll();													// read by polling the pin
+	int Read_Alert();													// read by edge callbacks
+	void Sampler(int _period);											// loop of the sampler thread
+	void Publish(float _temp, float _humi, bool _valid);				// write a new snapshot for Get_Sample
+	int Min_Period();													// min ms between two readings of the sensor type
+	void Count_Result(int _ok, uint32_t _start);						// count a reading started at tick _start, update degraded and backoff
+	uint32_t Gap_Left();												// µs till the sensor may be read again (min period or backoff), 0 = now
+	
+	HAL *_hal;															// hardware backend
 	uint8_t pin;														// used for the pin connector number (BCM number)
 	int DHT_val[5] = {0,0,0,0,0};										// array for the data from the dht11 sensor
+	int _good_val[5] = {0,0,0,0,0};										// frame of the last correct reading, used by Get_Temp / Get_Humi
+	int _bits = 0;														// decoded bits of the last reading, < 40 = timeout
 	int _type;
+	bool _acquired = false;												// true while this sensor uses the HAL
+	int _status = 0;													// result of the HAL initialisation, see Status
+	int _mode = DHT_MODE_POLL;											// read mode, see Set_Mode
+	DHT_edges _edges;													// edges of the reading in alert mode
+	
+	int _step = 0;														// next step of Read_Step: 0 = start, 1 = release, 2 = collect
+	uint32_t _step_start = 0;											// tick of the start pulse
+	uint32_t _step_release = 0;											// tick of the release
+	
+	std::thread _sampler;												// thread of Start_Sampling
+	bool _sampling = false;												// true while the sampler should run
+	std::mutex _sampling_lock;											// guards _sampling for the wake up, the policy and the statistics
+	std::condition_variable _sampling_wake;								// wakes the sampler up on stop
+	std::atomic<uint32_t> _snap_seq{0};									// seqlock of the snapshot, odd while it is written
+	std::atomic<float> _snap_temp{0.0};									// snapshot values, see DHT_sample
+	std::atomic<float> _snap_humi{0.0};
+	std::atomic<bool> _snap_valid{false};
+	std::atomic<int64_t> _snap_time{0};									// µs (steady clock) of the last correct reading, 0 = none
+	
+	DHT_policy _policy = {DHT_RETRIES, 16, DHT_DEGRADED_RATE, DHT_MAX_BACKOFF};
+	uint32_t _checksum_history = 0;										// bit 0 = last reading, 1 = checksum error
+	uint32_t _timeout_history = 0;										// bit 0 = last reading, 1 = timeout
+	int _history_count = 0;												// readings in the history, max policy.window
+	unsigned _reads = 0;
+	unsigned _checksum_errors = 0;
+	unsigned _timeouts = 0;
+	bool _degraded = false;												// see DHT_stats
+	int _backoff = 0;													// ms, see DHT_stats
+	struct callback {
+		DHT_callback func;
+		void *userdata;
+	};
+	callback _callbacks[DHT_MAX_CALLBACKS];								// see Add_Callback
+	int _callback_count = 0;
+	int _dispatching = 0;												// readings calling the callbacks now
+	std::condition_variable _dispatch_done;								// Remove_Callback waits for the calls
+	uint32_t _last_read = 0;											// tick of the start of the last reading
+	bool _read_once = false;											// true after the first reading
 };
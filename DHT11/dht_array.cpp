@@ -0,0 +1,146 @@
+/* JoyPi C++ driver with PIGPIO */
+#include "dht_array.h"																							// own header file
+#include <stdio.h>																								// for printf
+
+
+/* many DHT temperature and huminity sensors */
+DHTArray::DHTArray(HAL *_hal){
+	DHTArray::_hal = _hal;												// GPIO and time by this backend
+	
+	if ((DHTArray::_status=DHTArray::_hal->Init()) < 0){					// if initialisation of pigpio failed
+		printf("##############################################\n");
+		printf("#              Can't use PIGPIO!             #\n");
+		printf("# Maybe PIGPIO is used by an other instance? #\n");
+		printf("##############################################\n");
+		return;															// Status returns the error, Read returns 0
+	}
+	DHTArray::_acquired = true;
+}
+
+DHTArray::~DHTArray(){
+	DHTArray::Terminate();												// close GPIO conection
+}
+
+int DHTArray::Status(){
+	return DHTArray::_status;
+}
+
+int DHTArray::Add(int _pin, int _type){
+	if (_pin < 0 || _pin > 26 || DHTArray::_count >= DHT_ARRAY_MAX){	// pin number not valid (BCM number needed) or array full
+		return -1;
+	}
+	if (DHTArray::_acquired == false){									// no GPIO: the pin must not be driven
+		return -1;
+	}
+	for (int i = 0; i < DHTArray::_count; i++){
+		if (DHTArray::_channels[i].result.pin == _pin){					// every pin only once
+			return -1;
+		}
+	}
+
+	DHT_result &result = DHTArray::_channels[DHTArray::_count].result;
+	result.pin = _pin;
+	result.type = _type;
+	for (int i = 0; i < 5; i++){
+		result.val[i] = 0;
+	}
+	result.ok = false;
+	result.temp = 0.0;
+	result.humi = 0.0;
+	result.reads = 0;
+	result.failures = 0;
+
+	DHTArray::_hal->GPIO_Mode(_pin, HAL_OUTPUT);										// set the pin as output
+	DHTArray::_hal->GPIO_Pull(_pin, HAL_PUD_OFF);								// turn off every Pull resistors
+	DHTArray::_hal->GPIO_Write(_pin, HAL_HIGH);											// idle state of the data line
+
+	return DHTArray::_count++;
+}
+
+int DHTArray::Read(){
+	uint32_t mask = 0;
+	int correct = 0;
+
+	if (DHTArray::_count == 0 || DHTArray::_acquired == false){		// nothing to read or no GPIO
+		return 0;
+	}
+	for (int i = 0; i < DHTArray::_count; i++){
+		DHTArray::_channels[i].edges.count = 0;							// forget the edges of the last reading
+		mask |= (1 << DHTArray::_channels[i].result.pin);				// collect all pins
+		DHTArray::_hal->GPIO_Mode(DHTArray::_channels[i].result.pin, HAL_OUTPUT);		// set pin as output
+	}
+
+	/* Signal all sensors to send data */
+	DHTArray::_hal->GPIO_Clear(mask);									// set all pins to low (0) at once
+	DHTArray::_hal->Delay(20000);													// Datasheet states that we should wait 18ms --> 20ms to be save
+
+	/* Record the edges of every sensor from now on */
+	for (int i = 0; i < DHTArray::_count; i++){
+		DHTArray::_hal->GPIO_Alert(DHTArray::_channels[i].result.pin, DHT::Alert_Callback, &DHTArray::_channels[i].edges);
+	}
+
+	/* Release all pins, the sensors answer 20us - 40us later */
+	DHTArray::_hal->GPIO_Set(mask);										// set all pins to high (1) at once
+	for (int i = 0; i < DHTArray::_count; i++){
+		DHTArray::_hal->GPIO_Mode(DHTArray::_channels[i].result.pin, HAL_INPUT);		// set pin as input
+		DHTArray::_hal->GPIO_Pull(DHTArray::_channels[i].result.pin, HAL_PUD_UP);	// turn on pull up resistor
+	}
+
+	/* Sleep while the sensors are sending (~5ms) */
+	for (int t = 0; t < DHT_ALERT_TIMEOUT; t++){
+		int done = 0;
+		for (int i = 0; i < DHTArray::_count; i++){
+			if (DHTArray::_channels[i].edges.count >= DHT_FRAME_EDGES){	// all edges of the frame are there
+				done++;
+			}
+		}
+		if (done == DHTArray::_count){
+			break;
+		}
+		DHTArray::_hal->Delay(1000);												// sleep 1ms, the HAL delivers the alerts in the meantime
+	}
+
+	/* Stop recording and decode every sensor */
+	for (int i = 0; i < DHTArray::_count; i++){
+		channel &ch = DHTArray::_channels[i];
+		int val[5];
+
+		DHTArray::_hal->GPIO_Alert(ch.result.pin, NULL, NULL);
+		ch.result.reads++;
+		if (DHT::Decode(ch.edges.tick, ch.edges.level, ch.edges.count, val) >= 40 && val[4] == ((val[0] + val[1] + val[2] + val[3]) & 0xFF)){
+			for (int k = 0; k < 5; k++){
+				ch.result.val[k] = val[k];
+			}
+			ch.result.ok = true;
+			ch.result.temp = DHT::Calc_Temp(val, ch.result.type);		// same conversion as DHT::Get_Temp
+			ch.result.humi = DHT::Calc_Humi(val, ch.result.type);		// same conversion as DHT::Get_Humi
+			correct++;
+		}
+		else {
+			ch.result.ok = false;										// keep the values of the last correct reading
+			ch.result.failures++;
+		}
+	}
+
+	return correct;
+}
+
+int DHTArray::Count(){
+	return DHTArray::_count;
+}
+
+const DHT_result &DHTArray::Get(int _index){
+	static const DHT_result empty = {-1, 0, {0, 0, 0, 0, 0}, false, 0.0, 0.0, 0, 0};
+
+	if (_index < 0 || _index >= DHTArray::_count){						// index not valid: no sensor
+		return empty;
+	}
+	return DHTArray::_channels[_index].result;
+}
+
+void DHTArray::Terminate(){
+	if (DHTArray::_acquired == true){									// release the HAL only once, other drivers may still use it
+		DHTArray::_acquired = false;
+		DHTArray::_hal->Term();
+	}
+}
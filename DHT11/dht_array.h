@@ -0,0 +1,75 @@
+#pragma once
+#include "dht11.h"														// used for the DHT types, Decode and the conversions
+
+#define DHT_ARRAY_MAX				16										// max count of sensors of one DHTArray
+
+struct DHT_result {
+	/* result of one sensor of an DHTArray, see DHTArray::Get
+	*/
+	int pin;															// BCM number of the sensor pin
+	int type;															// DHT11 or DHT22
+	int val[5];															// bytes of the last frame, like DHT_val of the DHT class
+	bool ok;															// true if the last reading was correct
+	float temp;															// temperature of the last correct reading
+	float humi;															// humidity of the last correct reading
+	unsigned reads;														// count of readings
+	unsigned failures;													// count of wrong readings (timeout or checksum)
+};
+
+class DHTArray {
+	/* class for many DHT11 / DHT22 sensors on different pins.
+	 * PiGPIO is initialised only once for all sensors and a Read sends
+	 * the start pulse to all sensors at the same time. The answers are
+	 * recorded by the edge callback of DHT (see DHT::Set_Mode) and decoded together,
+	 * so reading 8 sensors takes about as long as reading one.
+	 *
+	*/
+public:
+	DHTArray(HAL *_hal=HAL::Default());									// constructor, initialise the GPIO backend (PiGPIO or simulation)
+	virtual ~DHTArray();												// destructor
+	int Status();
+	/* return 0 = ready
+	 *      < 0 = error of the HAL initialisation in the constructor, every Read returns 0
+	 *
+	*/
+	int Add(int _pin, int _type);
+	/* add a sensor with the BCM number _pin and the _type DHT11 or DHT22
+	 *
+	 * return the index of the sensor for Get
+	 *        -1 = pin not valid, already added, array full or no GPIO (see Status)
+	 *
+	*/
+	int Read();
+	/* read all sensors at the same time
+	 *
+	 * return the count of correct readings
+	 *
+	*/
+	int Count();
+	/* return the count of added sensors
+	 *
+	*/
+	const DHT_result &Get(int _index);
+	/* return the result of the sensor with the given _index (see Add)
+	 * temp and humi are kept from the last correct reading,
+	 * an index not valid returns an empty result with pin = -1
+	 *
+	*/
+	void Terminate();
+	/* close the GPIO conection with the sensors
+	 * PiGPIO is terminated when no other driver uses it anymore
+	 *
+	*/
+
+private:
+	struct channel {
+		DHT_result result;												// public part of the sensor
+		DHT_edges edges;												// recorded by DHT::Alert_Callback
+	};
+
+	HAL *_hal;															// hardware backend
+	channel _channels[DHT_ARRAY_MAX];									// the added sensors
+	int _count = 0;														// count of added sensors
+	bool _acquired = false;												// true while the array uses the HAL
+	int _status = 0;													// result of the HAL initialisation, see Status
+};
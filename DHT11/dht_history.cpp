@@ -0,0 +1,257 @@
+/* JoyPi C++ driver with PIGPIO */
+#include "dht_history.h"																						// own header file
+#include <math.h>																								// for lround
+#include <chrono>																								// for the time of the readings
+
+
+/* history of a DHT temperature and huminity sensor */
+DHT_History::DHT_History(int _capacity, const uint32_t _windows[], int _count){
+	if (_capacity < 1){
+		_capacity = 1;
+	}
+	if (_count > DHT_HISTORY_WINDOWS){
+		_count = DHT_HISTORY_WINDOWS;
+	}
+	if (_count < 0){
+		_count = 0;
+	}
+	DHT_History::_capacity = _capacity;
+	DHT_History::_window_count = _count;
+	DHT_History::_ring.resize(_capacity);								// the only allocations of the history
+	DHT_History::_values.resize(2 * _capacity);
+	DHT_History::_queues.resize(4 * _capacity * _count);
+	for (int i = 0; i < _count; i++){
+		window &w = DHT_History::_windows[i];
+		w.length = _windows[i] * 1000;
+		if (w.length < 1){
+			w.length = 1;
+		}
+		for (int k = 0; k < 4; k++){
+			w.queue[k] = &DHT_History::_queues[(4 * i + k) * _capacity];
+		}
+	}
+	DHT_History::Clear();
+}
+
+DHT_History::~DHT_History(){
+	DHT_History::Detach();												// the sensor must not call a deleted history
+}
+
+int DHT_History::Attach(DHT &_sensor){
+	DHT_History::Detach();
+	if (_sensor.Add_Callback(DHT_History::Callback, this) == 0){
+		return 0;
+	}
+	DHT_History::_sensor = &_sensor;
+	return 1;
+}
+
+void DHT_History::Detach(){
+	if (DHT_History::_sensor != NULL){
+		DHT_History::_sensor->Remove_Callback(DHT_History::Callback, this);
+		DHT_History::_sensor = NULL;
+	}
+}
+
+void DHT_History::Callback(const int _val[5], int _type, uint32_t, void *_userdata){
+	uint64_t time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	((DHT_History *)_userdata)->Add(_val, _type, time);					// not the µs tick: it wraps around after ~72 minutes
+}
+
+void DHT_History::Add(const int _val[5], int _type, uint64_t _time){
+	std::lock_guard<std::mutex> lock(DHT_History::_lock);
+
+	if (DHT_History::_started == false){								// the first sample is time 0
+		DHT_History::_started = true;
+		DHT_History::_first = _time;
+		DHT_History::_last = _time;
+	}
+	if (_time < DHT_History::_last){									// the samples stay in order
+		_time = DHT_History::_last;
+	}
+	uint64_t gap = _time - DHT_History::_last;
+	DHT_History::_last = _time;
+
+	if (DHT_History::_seq - DHT_History::_oldest == (uint32_t)DHT_History::_capacity){	// ring full: the oldest sample leaves the windows too
+		for (int i = 0; i < DHT_History::_window_count; i++){
+			window &w = DHT_History::_windows[i];
+			if (w.first == DHT_History::_oldest && w.first != DHT_History::_seq){
+				DHT_History::Remove(w);
+				DHT_History::Rebase(w);
+			}
+		}
+		DHT_History::_oldest++;
+	}
+
+	uint32_t seq = DHT_History::_seq;
+	int index = seq % DHT_History::_capacity;
+	DHT_history_sample &sample = DHT_History::_ring[index];
+	for (int i = 0; i < 5; i++){
+		sample.val[i] = _val[i];
+	}
+	sample.time = _time - DHT_History::_first;							// uint32: wraps around after ~49 days
+	DHT_History::_values[2 * index] = lround(DHT::Calc_Temp(_val, _type) * 10);		// same conversion as DHT::Get_Temp
+	DHT_History::_values[2 * index + 1] = lround(DHT::Calc_Humi(_val, _type) * 10);
+	DHT_History::_seq++;
+
+	uint32_t now = sample.time;
+	for (int i = 0; i < DHT_History::_window_count; i++){
+		window &w = DHT_History::_windows[i];
+		if (gap >= w.length){											// all older samples left the window, also if the 32 bit times wrapped around meanwhile
+			while (w.first != seq){
+				DHT_History::Remove(w);
+			}
+		}
+		DHT_History::Insert(w, seq);
+		while (now - DHT_History::Time(w.first) >= w.length){			// too old for the window, the new sample stays
+			DHT_History::Remove(w);
+		}
+		DHT_History::Rebase(w);
+	}
+}
+
+int DHT_History::Stats(int _window, DHT_history_stats &_stats){
+	if (_window < 0 || _window >= DHT_History::_window_count){
+		return 0;
+	}
+	std::lock_guard<std::mutex> lock(DHT_History::_lock);
+	window &w = DHT_History::_windows[_window];
+	int64_t n = DHT_History::_seq - w.first;
+	float *min[2] = {&_stats.temp_min, &_stats.humi_min};
+	float *max[2] = {&_stats.temp_max, &_stats.humi_max};
+	float *mean[2] = {&_stats.temp_mean, &_stats.humi_mean};
+	float *trend[2] = {&_stats.temp_trend, &_stats.humi_trend};
+
+	_stats.window = w.length / 1000;
+	_stats.count = n;
+	for (int q = 0; q < 2; q++){
+		*min[q] = 0.0;
+		*max[q] = 0.0;
+		*mean[q] = 0.0;
+		*trend[q] = 0.0;
+	}
+	if (n == 0){
+		return 0;
+	}
+	double den = (double)n * w.sum_xx - (double)w.sum_x * w.sum_x;		// n² * variance of x, 0 if all samples have the same time
+	for (int q = 0; q < 2; q++){
+		*min[q] = DHT_History::Value(w.queue[2 * q][w.head[2 * q] % DHT_History::_capacity], q) / 10.0;
+		*max[q] = DHT_History::Value(w.queue[2 * q + 1][w.head[2 * q + 1] % DHT_History::_capacity], q) / 10.0;
+		*mean[q] = (double)w.sum_v[q] / n / 10.0;
+		if (den > 0){
+			double slope = ((double)n * w.sum_xv[q] - (double)w.sum_x * w.sum_v[q]) / den;	// tenths per DHT_HISTORY_UNIT
+			*trend[q] = slope / 10.0 * (3600000.0 / DHT_HISTORY_UNIT);
+		}
+	}
+	return 1;
+}
+
+int DHT_History::Count(){
+	std::lock_guard<std::mutex> lock(DHT_History::_lock);
+	return DHT_History::_seq - DHT_History::_oldest;
+}
+
+int DHT_History::Get(int _age, DHT_history_sample &_sample){
+	std::lock_guard<std::mutex> lock(DHT_History::_lock);
+	if (_age < 0 || (uint32_t)_age >= DHT_History::_seq - DHT_History::_oldest){
+		return 0;
+	}
+	_sample = DHT_History::_ring[(DHT_History::_seq - 1 - _age) % DHT_History::_capacity];
+	return 1;
+}
+
+size_t DHT_History::Memory(){
+	return sizeof(DHT_History) + DHT_History::_ring.capacity() * sizeof(DHT_history_sample)
+		+ DHT_History::_values.capacity() * sizeof(int16_t) + DHT_History::_queues.capacity() * sizeof(uint32_t);
+}
+
+void DHT_History::Clear(){
+	std::lock_guard<std::mutex> lock(DHT_History::_lock);
+	DHT_History::_seq = 0;
+	DHT_History::_oldest = 0;
+	DHT_History::_started = false;
+	for (int i = 0; i < DHT_History::_window_count; i++){
+		window &w = DHT_History::_windows[i];
+		w.first = 0;
+		w.origin = 0;
+		w.sum_x = 0;
+		w.sum_xx = 0;
+		for (int q = 0; q < 2; q++){
+			w.sum_v[q] = 0;
+			w.sum_xv[q] = 0;
+		}
+		for (int k = 0; k < 4; k++){
+			w.head[k] = 0;
+			w.tail[k] = 0;
+		}
+	}
+}
+
+void DHT_History::Insert(window &_w, uint32_t _seq){
+	if (_w.first == _seq){												// empty window: x = 0 at the new sample
+		_w.origin = DHT_History::Time(_seq);
+	}
+	int64_t x = DHT_History::X(_w, _seq);
+	_w.sum_x += x;
+	_w.sum_xx += x * x;
+	for (int q = 0; q < 2; q++){
+		int v = DHT_History::Value(_seq, q);
+		_w.sum_v[q] += v;
+		_w.sum_xv[q] += x * v;
+
+		uint32_t *min = _w.queue[2 * q];								// values rise from the front: the front is the min
+		while (_w.tail[2 * q] != _w.head[2 * q] && DHT_History::Value(min[(_w.tail[2 * q] - 1) % DHT_History::_capacity], q) >= v){
+			_w.tail[2 * q]--;
+		}
+		min[_w.tail[2 * q]++ % DHT_History::_capacity] = _seq;
+
+		uint32_t *max = _w.queue[2 * q + 1];							// values fall from the front: the front is the max
+		while (_w.tail[2 * q + 1] != _w.head[2 * q + 1] && DHT_History::Value(max[(_w.tail[2 * q + 1] - 1) % DHT_History::_capacity], q) <= v){
+			_w.tail[2 * q + 1]--;
+		}
+		max[_w.tail[2 * q + 1]++ % DHT_History::_capacity] = _seq;
+	}
+}
+
+void DHT_History::Remove(window &_w){
+	uint32_t seq = _w.first++;
+	int64_t x = DHT_History::X(_w, seq);
+	_w.sum_x -= x;
+	_w.sum_xx -= x * x;
+	for (int q = 0; q < 2; q++){
+		int v = DHT_History::Value(seq, q);
+		_w.sum_v[q] -= v;
+		_w.sum_xv[q] -= x * v;
+	}
+	for (int k = 0; k < 4; k++){
+		if (_w.head[k] != _w.tail[k] && _w.queue[k][_w.head[k] % DHT_History::_capacity] == seq){	// it was the min / max
+			_w.head[k]++;
+		}
+	}
+}
+
+void DHT_History::Rebase(window &_w){
+	int64_t n = DHT_History::_seq - _w.first;
+	if (n == 0){
+		return;
+	}
+	int64_t d = DHT_History::X(_w, _w.first);							// sums of (x - d), exact in integers
+	_w.sum_xx += n * d * d - 2 * d * _w.sum_x;
+	_w.sum_x -= n * d;
+	for (int q = 0; q < 2; q++){
+		_w.sum_xv[q] -= d * _w.sum_v[q];
+	}
+	_w.origin += d * DHT_HISTORY_UNIT;									// the x of the other samples go down by d too
+}
+
+int DHT_History::Value(uint32_t _seq, int _quantity){
+	return DHT_History::_values[2 * (_seq % DHT_History::_capacity) + _quantity];
+}
+
+uint32_t DHT_History::Time(uint32_t _seq){
+	return DHT_History::_ring[_seq % DHT_History::_capacity].time;
+}
+
+int64_t DHT_History::X(const window &_w, uint32_t _seq){
+	return (uint32_t)(DHT_History::Time(_seq) - _w.origin) / DHT_HISTORY_UNIT;	// unsigned difference: right across the wrap around
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include "dht11.h"														// used for the reading callback and the conversions
+#include <inttypes.h>													// used for the int types like uint8_t
+#include <vector>
+#include <mutex>														// Add runs on the thread of the reading
+
+#define DHT_HISTORY_WINDOWS			4										// max count of windows of one history
+#define DHT_HISTORY_UNIT			100										// ms of one time unit of the trend (keeps the sums in 64 bit)
+
+struct DHT_history_sample {
+	/* one correct reading in the history, see DHT_History::Get
+	*/
+	uint8_t val[5];														// bytes of the frame, like DHT_val of the DHT class
+	uint32_t time;														// ms of the history clock (0 = first sample, wraps around after ~49 days, windows work across it)
+};
+
+struct DHT_history_stats {
+	/* aggregates of one window, see DHT_History::Stats
+	*/
+	uint32_t window;													// length of the window in s
+	unsigned count;														// samples in the window
+	float temp_min;
+	float temp_max;
+	float temp_mean;
+	float temp_trend;													// °C per hour (least squares line over the window)
+	float humi_min;
+	float humi_max;
+	float humi_mean;
+	float humi_trend;													// % per hour
+};
+
+class DHT_History {
+	/* ring buffer of the last correct readings of a DHT sensor with running
+	 * min / max / mean / trend over up to DHT_HISTORY_WINDOWS time windows.
+	 *
+	 * A sample is the raw frame (5 bytes) and the time of the reading. Every
+	 * window keeps the sums for the mean and the least squares trend and a
+	 * monotonic queue for min and max, so a new sample updates all windows in
+	 * O(1) (amortised) and Stats never scans the samples. The sums are 64 bit
+	 * integers of tenths, they don't drift when samples leave the window.
+	 *
+	 * All memory is allocated by the constructor, see Memory. When the ring is
+	 * full, the oldest sample leaves the ring and all windows.
+	 *
+	*/
+public:
+	DHT_History(int _capacity, const uint32_t _windows[], int _count);
+	/* keep the last _capacity samples, the _count windows have the
+	 * lengths _windows[] in s, e.g. {60, 600, 3600}
+	 * (max DHT_HISTORY_WINDOWS, a window is never longer than the ring)
+	 *
+	*/
+	virtual ~DHT_History();												// destructor, detaches from the sensor
+	int Attach(DHT &_sensor);
+	/* add every correct reading of _sensor (see DHT::Add_Callback)
+	 *
+	 * return 1 = attached
+	 *        0 = no free callback of the sensor
+	 *
+	*/
+	void Detach();
+	/* stop adding the readings of the sensor
+	*/
+	void Add(const int _val[5], int _type, uint64_t _time);
+	/* add the frame _val of a _type sensor read at _time (ms of a monotonic clock,
+	 * after Attach the sensor adds its readings with the ms of std::chrono::steady_clock)
+	*/
+	int Stats(int _window, DHT_history_stats &_stats);
+	/* copy the aggregates of the window with the index _window (order of the constructor)
+	 * into _stats, the window ends with the newest sample
+	 *
+	 * return 1 = okay
+	 *        0 = unknown window or no sample in the window
+	 *
+	*/
+	int Count();
+	/* return the count of samples in the ring
+	*/
+	int Get(int _age, DHT_history_sample &_sample);
+	/* copy the sample _age into _sample, 0 = newest
+	 *
+	 * return 1 = okay, 0 = not in the ring
+	 *
+	*/
+	size_t Memory();
+	/* return the bytes used by the history, fixed since the constructor
+	*/
+	void Clear();
+	/* forget all samples
+	*/
+
+private:
+	struct window {
+		uint32_t length;												// ms
+		uint32_t first;													// sequence number of the oldest sample in the window
+		uint32_t origin;												// time (ms) of x = 0 of the sums, x in DHT_HISTORY_UNIT
+		int64_t sum_x;													// sums over the window, x = time - origin, v = tenths
+		int64_t sum_xx;
+		int64_t sum_v[2];												// 0 = temperature, 1 = humidity
+		int64_t sum_xv[2];
+		uint32_t *queue[4];												// monotonic queues of sequence numbers: temp min, temp max, humi min, humi max
+		uint32_t head[4];												// front (oldest) of the queue
+		uint32_t tail[4];												// end of the queue
+	};
+	static void Callback(const int _val[5], int _type, uint32_t _tick, void *_userdata);	// reading callback of the sensor
+	void Insert(window &_w, uint32_t _seq);								// add the sample to the sums and queues of the window
+	void Remove(window &_w);											// take the oldest sample out of the window
+	void Rebase(window &_w);											// move origin to the oldest sample, the x stay small
+	int Value(uint32_t _seq, int _quantity);							// tenths of the temperature (0) or humidity (1) of a sample
+	uint32_t Time(uint32_t _seq);										// time of a sample in ms
+	int64_t X(const window &_w, uint32_t _seq);							// time of a sample in DHT_HISTORY_UNIT since the origin of the window
+
+	int _capacity;
+	std::vector<DHT_history_sample> _ring;
+	std::vector<int16_t> _values;										// tenths of temperature and humidity of every sample
+	std::vector<uint32_t> _queues;										// memory of all queues, 4 * _capacity per window
+	window _windows[DHT_HISTORY_WINDOWS];
+	int _window_count = 0;
+	uint32_t _seq = 0;													// sequence number of the next sample
+	uint32_t _oldest = 0;												// sequence number of the oldest sample in the ring
+	uint64_t _first = 0;												// _time of the first sample (time 0 of the history clock)
+	uint64_t _last = 0;													// _time of the last sample
+	bool _started = false;
+	DHT *_sensor = NULL;												// sensor of Attach
+	std::mutex _lock;													// Add (reading thread) against Stats / Get
+};
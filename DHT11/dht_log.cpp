@@ -0,0 +1,316 @@
+/* JoyPi C++ driver with PIGPIO */
+#include "dht_log.h"																							// own header file
+#include <string.h>																								// for memcpy and memcmp
+#include <errno.h>																								// for the error numbers
+#include <fcntl.h>																								// for open and posix_fallocate
+#include <unistd.h>																								// for close and sysconf
+#include <sys/mman.h>																							// for mmap and msync
+#include <sys/stat.h>																							// for fstat
+#include <atomic>																								// for the fence between record and count
+#include <chrono>																								// for the time of the readings
+
+
+/* binary log of a DHT temperature and huminity sensor */
+DHT_Log::DHT_Log(){
+}
+
+DHT_Log::~DHT_Log(){
+	DHT_Log::Detach();													// the sensor must not call a deleted log
+	DHT_Log::Close();
+}
+
+int DHT_Log::Open(const char _path[], uint32_t _capacity, int _type, int _sync_every){
+	DHT_Log::Close();
+	std::lock_guard<std::mutex> lock(DHT_Log::_lock);
+	DHT_log_header head;
+	struct stat st;
+	bool found = false;
+
+	DHT_Log::_fd = open(_path, O_RDWR | O_CREAT, 0644);
+	if (DHT_Log::_fd < 0){
+		return -errno;
+	}
+	if (fstat(DHT_Log::_fd, &st) < 0){
+		int error = -errno;
+		close(DHT_Log::_fd);
+		DHT_Log::_fd = -1;
+		return error;
+	}
+	if (st.st_size > 0){												// existing file: must be a log
+		if ((size_t)st.st_size < sizeof(head) || pread(DHT_Log::_fd, &head, sizeof(head), 0) != sizeof(head)
+				|| memcmp(head.magic, DHT_LOG_MAGIC, sizeof(head.magic)) != 0 || head.record_size != DHT_LOG_RECORD_SIZE
+				|| head.type != (uint32_t)_type){						// the frames of an other sensor type would be converted wrong
+			close(DHT_Log::_fd);
+			DHT_Log::_fd = -1;
+			return -EINVAL;
+		}
+		found = true;
+		if (head.capacity > _capacity){									// a log never shrinks
+			_capacity = head.capacity;
+		}
+	}
+
+	size_t size = sizeof(DHT_log_header) + (size_t)_capacity * DHT_LOG_RECORD_SIZE;
+	int error = posix_fallocate(DHT_Log::_fd, 0, size);					// reserve the blocks now: a full disk can't hit a write into the mapping
+	if (error == 0){
+		error = DHT_Log::Map(size);
+	}
+	else {
+		error = -error;
+	}
+	if (error < 0){
+		close(DHT_Log::_fd);
+		DHT_Log::_fd = -1;
+		return error;
+	}
+
+	if (found == false){												// new log
+		memset(DHT_Log::_header, 0, sizeof(DHT_log_header));
+		memcpy(DHT_Log::_header->magic, DHT_LOG_MAGIC, sizeof(DHT_Log::_header->magic));
+		DHT_Log::_header->record_size = DHT_LOG_RECORD_SIZE;
+		DHT_Log::_header->type = _type;
+	}
+	if (DHT_Log::_header->count > DHT_Log::_header->capacity){			// count of a broken file
+		DHT_Log::_header->count = DHT_Log::_header->capacity;
+	}
+	DHT_Log::_header->capacity = _capacity;
+	DHT_Log::_last = 0;
+	if (DHT_Log::_header->count > 0){									// continue after the last record
+		memcpy(&(DHT_Log::_last), DHT_Log::_map + sizeof(DHT_log_header) + (size_t)(DHT_Log::_header->count - 1) * DHT_LOG_RECORD_SIZE, sizeof(uint32_t));
+	}
+	DHT_Log::_synced = DHT_Log::_header->count;
+	DHT_Log::_sync_every = _sync_every < 1 ? 1 : _sync_every;
+	return 0;
+}
+
+void DHT_Log::Close(){
+	std::lock_guard<std::mutex> lock(DHT_Log::_lock);
+	if (DHT_Log::_map != NULL){
+		msync(DHT_Log::_map, DHT_Log::_size, MS_SYNC);					// all records on the disk
+		munmap(DHT_Log::_map, DHT_Log::_size);
+		DHT_Log::_map = NULL;
+		DHT_Log::_header = NULL;
+		DHT_Log::_size = 0;
+	}
+	if (DHT_Log::_fd >= 0){
+		close(DHT_Log::_fd);
+		DHT_Log::_fd = -1;
+	}
+}
+
+int DHT_Log::Attach(DHT &_sensor){
+	DHT_Log::Detach();
+	if (_sensor.Add_Callback(DHT_Log::Callback, this) == 0){
+		return 0;
+	}
+	DHT_Log::_sensor = &_sensor;
+	return 1;
+}
+
+void DHT_Log::Detach(){
+	if (DHT_Log::_sensor != NULL){
+		DHT_Log::_sensor->Remove_Callback(DHT_Log::Callback, this);
+		DHT_Log::_sensor = NULL;
+	}
+}
+
+void DHT_Log::Callback(const int _val[5], int _type, uint32_t _tick, void *_userdata){
+	int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	((DHT_Log *)_userdata)->Append(_val, now);							// the tick of the HAL isn't a date, the reading ended just now
+}
+
+int DHT_Log::Append(const int _val[5], int64_t _time){
+	std::lock_guard<std::mutex> lock(DHT_Log::_lock);
+	if (DHT_Log::_header == NULL){
+		return 0;
+	}
+	uint32_t count = DHT_Log::_header->count;
+	if (count >= DHT_Log::_header->capacity){							// full: open a new file
+		return 0;
+	}
+	if (count == 0){													// the first record is the base time
+		DHT_Log::_header->base = _time;
+		DHT_Log::_last = 0;
+	}
+	int64_t ms = _time - DHT_Log::_header->base;
+	if (ms < DHT_Log::_last){											// the clock went back: keep the records sorted
+		ms = DHT_Log::_last;
+	}
+	if (ms > UINT32_MAX){												// doesn't fit into the record: open a new file
+		return 0;
+	}
+
+	uint8_t *record = DHT_Log::_map + sizeof(DHT_log_header) + (size_t)count * DHT_LOG_RECORD_SIZE;
+	uint32_t offset = ms;
+	memcpy(record, &offset, sizeof(offset));
+	for (int i = 0; i < 5; i++){
+		record[sizeof(offset) + i] = _val[i];
+	}
+	DHT_Log::_last = offset;
+	std::atomic_thread_fence(std::memory_order_release);				// a reader sees the record before the count
+	DHT_Log::_header->count = count + 1;
+
+	if (count + 1 - DHT_Log::_synced >= (uint32_t)DHT_Log::_sync_every){	// write the new records back in the background
+		static const size_t page = sysconf(_SC_PAGESIZE);
+		size_t from = (sizeof(DHT_log_header) + (size_t)DHT_Log::_synced * DHT_LOG_RECORD_SIZE) / page * page;
+		size_t to = sizeof(DHT_log_header) + (size_t)(count + 1) * DHT_LOG_RECORD_SIZE;
+		if (from > 0){
+			msync(DHT_Log::_map, page, MS_ASYNC);						// page of the header with the count
+		}
+		msync(DHT_Log::_map + from, to - from, MS_ASYNC);
+		DHT_Log::_synced = count + 1;
+	}
+	return 1;
+}
+
+int DHT_Log::Sync(){
+	std::lock_guard<std::mutex> lock(DHT_Log::_lock);
+	if (DHT_Log::_map == NULL){
+		return 0;
+	}
+	if (msync(DHT_Log::_map, DHT_Log::_size, MS_SYNC) < 0){
+		return -errno;
+	}
+	DHT_Log::_synced = DHT_Log::_header->count;
+	return 0;
+}
+
+uint32_t DHT_Log::Count(){
+	std::lock_guard<std::mutex> lock(DHT_Log::_lock);
+	return DHT_Log::_header != NULL ? DHT_Log::_header->count : 0;
+}
+
+int DHT_Log::Map(size_t _size){
+	void *map = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, DHT_Log::_fd, 0);
+	if (map == MAP_FAILED){
+		return -errno;
+	}
+	DHT_Log::_map = (uint8_t *)map;
+	DHT_Log::_size = _size;
+	DHT_Log::_header = (DHT_log_header *)map;
+	return 0;
+}
+
+
+/* reader of a binary log */
+DHT_Log_Reader::DHT_Log_Reader(){
+}
+
+DHT_Log_Reader::~DHT_Log_Reader(){
+	DHT_Log_Reader::Close();
+}
+
+int DHT_Log_Reader::Open(const char _path[]){
+	DHT_Log_Reader::Close();
+	DHT_Log_Reader::_fd = open(_path, O_RDONLY);
+	if (DHT_Log_Reader::_fd < 0){
+		return -errno;
+	}
+	if (DHT_Log_Reader::Refresh() == 0 && DHT_Log_Reader::_header == NULL){	// no mapping: not a log
+		DHT_Log_Reader::Close();
+		return -EINVAL;
+	}
+	return 0;
+}
+
+void DHT_Log_Reader::Close(){
+	if (DHT_Log_Reader::_map != NULL){
+		munmap((void *)DHT_Log_Reader::_map, DHT_Log_Reader::_size);
+		DHT_Log_Reader::_map = NULL;
+		DHT_Log_Reader::_header = NULL;
+		DHT_Log_Reader::_size = 0;
+	}
+	if (DHT_Log_Reader::_fd >= 0){
+		close(DHT_Log_Reader::_fd);
+		DHT_Log_Reader::_fd = -1;
+	}
+	DHT_Log_Reader::_count = 0;
+}
+
+uint32_t DHT_Log_Reader::Refresh(){
+	struct stat st;
+
+	if (DHT_Log_Reader::_fd < 0 || fstat(DHT_Log_Reader::_fd, &st) < 0){
+		return DHT_Log_Reader::_count;
+	}
+	if ((size_t)st.st_size != DHT_Log_Reader::_size){					// new file or the writer made it bigger: map it again
+		if (DHT_Log_Reader::_map != NULL){
+			munmap((void *)DHT_Log_Reader::_map, DHT_Log_Reader::_size);
+			DHT_Log_Reader::_map = NULL;
+			DHT_Log_Reader::_header = NULL;
+			DHT_Log_Reader::_size = 0;
+			DHT_Log_Reader::_count = 0;
+		}
+		if ((size_t)st.st_size < sizeof(DHT_log_header)){
+			return 0;
+		}
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, DHT_Log_Reader::_fd, 0);
+		if (map == MAP_FAILED){
+			return 0;
+		}
+		const DHT_log_header *header = (const DHT_log_header *)map;
+		if (memcmp(header->magic, DHT_LOG_MAGIC, sizeof(header->magic)) != 0 || header->record_size != DHT_LOG_RECORD_SIZE){
+			munmap(map, st.st_size);
+			return 0;
+		}
+		DHT_Log_Reader::_map = (const uint8_t *)map;
+		DHT_Log_Reader::_size = st.st_size;
+		DHT_Log_Reader::_header = header;
+	}
+
+	uint32_t count = ((volatile const DHT_log_header *)DHT_Log_Reader::_header)->count;	// the writer may append right now
+	std::atomic_thread_fence(std::memory_order_acquire);				// the records up to count are complete
+	uint32_t room = (DHT_Log_Reader::_size - sizeof(DHT_log_header)) / DHT_LOG_RECORD_SIZE;
+	DHT_Log_Reader::_count = count < room ? count : room;
+	return DHT_Log_Reader::_count;
+}
+
+uint32_t DHT_Log_Reader::Count(){
+	return DHT_Log_Reader::_count;
+}
+
+int DHT_Log_Reader::Type(){
+	return DHT_Log_Reader::_header != NULL ? DHT_Log_Reader::_header->type : 0;
+}
+
+int DHT_Log_Reader::Get(uint32_t _index, DHT_log_record &_record){
+	if (_index >= DHT_Log_Reader::_count){
+		return 0;
+	}
+	const uint8_t *record = DHT_Log_Reader::_map + sizeof(DHT_log_header) + (size_t)_index * DHT_LOG_RECORD_SIZE;
+	_record.time = DHT_Log_Reader::_header->base + DHT_Log_Reader::Offset(_index);
+	memcpy(_record.val, record + sizeof(uint32_t), 5);
+	return 1;
+}
+
+uint32_t DHT_Log_Reader::Find(int64_t _time){
+	uint32_t low = 0;
+	uint32_t high = DHT_Log_Reader::_count;
+
+	if (high == 0){
+		return 0;
+	}
+	int64_t target = _time - DHT_Log_Reader::_header->base;
+	if (target <= 0){
+		return 0;
+	}
+	if (target > UINT32_MAX){
+		return high;
+	}
+	while (low < high){													// first record with an offset >= target
+		uint32_t middle = low + (high - low) / 2;
+		if (DHT_Log_Reader::Offset(middle) < (uint32_t)target){
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+uint32_t DHT_Log_Reader::Offset(uint32_t _index){
+	uint32_t offset;
+	memcpy(&offset, DHT_Log_Reader::_map + sizeof(DHT_log_header) + (size_t)_index * DHT_LOG_RECORD_SIZE, sizeof(offset));	// records aren't aligned
+	return offset;
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include "dht11.h"														// used for the reading callback and the conversions
+#include <inttypes.h>													// used for the int types like uint8_t
+#include <stddef.h>														// used for size_t
+#include <mutex>														// Append runs on the thread of the reading
+
+#define DHT_LOG_MAGIC				"DHTLOG1"								// first 8 bytes of a log file (with the 0)
+#define DHT_LOG_RECORD_SIZE			9										// bytes of a record: ms since the base time (4) + frame (5)
+#define DHT_LOG_SYNC_EVERY			32										// default records between two msync
+
+struct DHT_log_header {
+	/* first 32 bytes of a log file, the records follow
+	 * (all values in the byte order of the writer)
+	*/
+	char magic[8];														// DHT_LOG_MAGIC
+	uint32_t record_size;												// DHT_LOG_RECORD_SIZE
+	uint32_t capacity;													// records the file has room for
+	int64_t base;														// ms since 1970 of the first record, the records store the ms since then
+	uint32_t count;														// records written, updated after every record
+	uint32_t type;														// DHT11 or DHT22, for the conversion of the frames
+};
+
+struct DHT_log_record {
+	/* one record of a log, see DHT_Log_Reader::Get
+	*/
+	int64_t time;														// ms since 1970
+	uint8_t val[5];														// bytes of the frame, like DHT_val of the DHT class
+};
+
+class DHT_Log {
+	/* append only binary log of the correct readings of a DHT sensor.
+	 * A record is the ms since the first record (uint32, so a file covers ~49 days)
+	 * and the raw frame, 9 bytes instead of ~100 bytes of text.
+	 *
+	 * The file is made big enough for all records by Open and mapped into memory,
+	 * Append only copies the record into the mapping and counts it in the header:
+	 * no allocation and no system call, except the msync (MS_ASYNC) of the new
+	 * records every sync_every records. An existing log is continued.
+	 *
+	 * The records are sorted by time (a clock going back gives the time of the
+	 * record before), so DHT_Log_Reader can search them binary.
+	 *
+	*/
+public:
+	DHT_Log();															// constructor, no file open
+	virtual ~DHT_Log();													// destructor, detaches and closes the file
+	int Open(const char _path[], uint32_t _capacity, int _type, int _sync_every=DHT_LOG_SYNC_EVERY);
+	/* open or create the log file _path with room for _capacity records of a _type sensor
+	 * (an existing log keeps its records and grows to _capacity if smaller)
+	 *
+	 * return 0 = okay
+	 *      < 0 = -errno of the file functions, -EINVAL = the file isn't a log or a log of an other sensor type
+	 *
+	*/
+	void Close();
+	/* sync and close the file
+	*/
+	int Attach(DHT &_sensor);
+	/* append every correct reading of _sensor (see DHT::Add_Callback)
+	 *
+	 * return 1 = attached
+	 *        0 = no free callback of the sensor
+	 *
+	*/
+	void Detach();
+	/* stop appending the readings of the sensor
+	*/
+	int Append(const int _val[5], int64_t _time);
+	/* append the frame _val read at _time (ms since 1970)
+	 *
+	 * return 1 = appended
+	 *        0 = no file open, file full or more than ~49 days after the first record
+	 *
+	*/
+	int Sync();
+	/* write all records to the disk (msync MS_SYNC)
+	 *
+	 * return 0 = okay, < 0 = -errno
+	 *
+	*/
+	uint32_t Count();
+	/* return the count of records in the file
+	*/
+
+private:
+	static void Callback(const int _val[5], int _type, uint32_t _tick, void *_userdata);	// reading callback of the sensor
+	int Map(size_t _size);												// map _size bytes of the file
+
+	int _fd = -1;														// file descriptor, -1 = closed
+	uint8_t *_map = NULL;												// mapping of the whole file
+	size_t _size = 0;													// bytes of the mapping
+	DHT_log_header *_header = NULL;										// start of the mapping
+	uint32_t _last = 0;													// ms of the last record
+	uint32_t _synced = 0;												// records synced by msync
+	int _sync_every = DHT_LOG_SYNC_EVERY;
+	DHT *_sensor = NULL;												// sensor of Attach
+	std::mutex _lock;													// Append (reading thread) against Open / Close
+};
+
+class DHT_Log_Reader {
+	/* reader of a log of DHT_Log. The file is mapped, not loaded,
+	 * the records are read from the mapping by index or found by time.
+	 * A reader may run while the writer appends (see Refresh).
+	 *
+	*/
+public:
+	DHT_Log_Reader();													// constructor, no file open
+	virtual ~DHT_Log_Reader();											// destructor, closes the file
+	int Open(const char _path[]);
+	/* map the log file _path
+	 *
+	 * return 0 = okay
+	 *      < 0 = -errno of the file functions, -EINVAL = the file isn't a log
+	 *
+	*/
+	void Close();
+	/* unmap and close the file
+	*/
+	uint32_t Refresh();
+	/* take the records appended since Open / the last Refresh, return the count
+	*/
+	uint32_t Count();
+	/* return the count of records
+	*/
+	int Type();
+	/* return the sensor type of the log (DHT11 or DHT22), for DHT::Calc_Temp / Calc_Humi
+	*/
+	int Get(uint32_t _index, DHT_log_record &_record);
+	/* copy the record _index (0 = first) into _record
+	 *
+	 * return 1 = okay, 0 = no such record
+	 *
+	*/
+	uint32_t Find(int64_t _time);
+	/* binary search: return the index of the first record at or after _time (ms since 1970),
+	 * Count() if there is none
+	 *
+	*/
+
+private:
+	uint32_t Offset(uint32_t _index);									// ms since the base time of the record _index
+
+	int _fd = -1;														// file descriptor, -1 = closed
+	const uint8_t *_map = NULL;											// mapping of the whole file
+	size_t _size = 0;													// bytes of the mapping
+	const DHT_log_header *_header = NULL;								// start of the mapping
+	uint32_t _count = 0;												// records taken by Open / Refresh
+};
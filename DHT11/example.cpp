@@ -2,10 +2,11 @@
  * 
  * commands:
  * compile: g++ -Wall -c dht.cpp "%f"
- * build: g++ -Wall -o "%e" dht.cpp "%f" -lpigpio
+ * build: g++ -Wall -o "%e" dht.cpp dht_log.cpp ../Common/hal_pigpio.cpp ../Common/pi_context.cpp ../Common/bus_trace.cpp "%f" -lpigpio -pthread
 */
 
-#include "dht.h"														// include the dht driver
+#include "dht11.h"													// include the dht driver
+#include "dht_log.h"													// binary log of the readings
 #include <stdio.h>														// for printf
 #include <unistd.h>														// used for sleep
 #include <cstdlib>														// for std::system
@@ -19,16 +20,23 @@ void clear_screen(){
 }
 
 DHT sensor1(4,DHT11);													// load class DHT11 as sensor1 with pin number 4
+DHT_Log log1;															// log of all correct readings of sensor1
 
 int main(){															
 	float temp1=0.0;
 	float humi1=0.0;
 	bool ok1=false;
+	DHT_stats stats1;
+	
+	sensor1.Set_Mode(DHT_MODE_ALERT);										// measure the edges instead of polling the pin
+	if (log1.Open("dht11.log", 1000000, DHT11) == 0){					// room for 1000000 readings (9 MB), an existing log is continued
+		log1.Attach(sensor1);											// every correct reading is appended
+	}
 	    
 	while (1){		
 		clear_screen();													// clear the console
 
-		if (sensor1.Read()==1) {										// if read Sensor1 data into array is okay
+		if (sensor1.Read_Retry()==1) {									// if read Sensor1 data into array is okay (with retries)
 			temp1=sensor1.Get_Temp();									// get temperature from sensor and save it in temp
 			humi1=sensor1.Get_Humi();									// get huminity from sensor and save it in humi
 			ok1=true;													// set ok to true
@@ -38,6 +46,8 @@ int main(){
 		printf("Temperatur:\t%.1f°C\n",temp1);
 		printf("Luftfeuchte:\t%.1f%%\n",humi1);
 		printf("Status:\t\t%d\n",ok1);
+		sensor1.Get_Stats(stats1);										// failures of the last readings
+		printf("Fehler:\t\t%u Checksumme, %u Timeout%s\n",stats1.checksum_errors,stats1.timeouts,stats1.degraded ? " (gestoert)" : "");
 		ok1=false;														// set ok to false
 		sleep(10);
 	}
@@ -0,0 +1,276 @@
+/* Driver for the whole JoyPi board: DHT11, LCD and 7-segment display
+ * driven by one event loop on a timer wheel.
+ *
+*/
+
+#include "JoyPi.h"														// own header file
+
+JoyPi::JoyPi(HAL *_hal, int _dht_pin, int _dht_type) :
+		_sensor(_dht_pin, _dht_type, _hal),
+		_lcd(JOYPI_LCD_ADDR, JOYPI_LCD_ROWS, JOYPI_LCD_COLS, _hal),
+		_segment(JOYPI_SEGMENT_ADDR, _hal){
+	JoyPi::_hal = _hal;
+	JoyPi::_sensor_period = (_dht_type == DHT22 ? DHT22_MIN_PERIOD : DHT11_MIN_PERIOD) * 1000;
+	for (int i = 0; i < JOYPI_WHEEL_SLOTS; i++){
+		JoyPi::_wheel[i] = -1;
+	}
+	JoyPi::_status = JoyPi::_sensor.Status();							// the first error of the devices
+	if (JoyPi::_status == 0){
+		JoyPi::_status = JoyPi::_segment.get_status();
+	}
+	int lcd_status = JoyPi::_lcd.Init();
+	if (JoyPi::_status == 0){
+		JoyPi::_status = lcd_status;
+	}
+	if (lcd_status == 0){
+		JoyPi::_lcd.Backlight(true);
+	}
+
+	JoyPi::Add("sensor", JoyPi::_sensor_period, [this]{ return JoyPi::SensorStep(); });	// JOYPI_TASK_SENSOR
+	JoyPi::Add("lcd", JOYPI_LCD_PERIOD, [this]{ JoyPi::_lcd.Flush(); return (uint32_t)0; });	// JOYPI_TASK_LCD
+	JoyPi::Add("segment", JOYPI_SEGMENT_PERIOD, [this]{ JoyPi::_segment.commit(); return (uint32_t)0; });	// JOYPI_TASK_SEGMENT
+}
+
+JoyPi::~JoyPi(){
+	JoyPi::Stop();
+	JoyPi::_lcd.Term();
+}
+
+int JoyPi::Status(){
+	return JoyPi::_status;
+}
+
+DHT &JoyPi::Sensor(){
+	return JoyPi::_sensor;
+}
+
+LCD_MCP23008_I2C &JoyPi::Lcd(){
+	return JoyPi::_lcd;
+}
+
+SevenSegment &JoyPi::Segment(){
+	return JoyPi::_segment;
+}
+
+int JoyPi::Every(const char _name[], uint32_t _period, std::function<void()> _func){
+	return JoyPi::Add(_name, _period, [_func]{ _func(); return (uint32_t)0; });
+}
+
+void JoyPi::Period(int _task, uint32_t _period){
+	std::lock_guard<std::recursive_mutex> lock(JoyPi::_lock);
+	if (_task < 0 || _task >= JoyPi::_count){
+		return;
+	}
+	if (_task == JOYPI_TASK_SENSOR && _period < JoyPi::_sensor_period){	// the sensor needs its pause between two readings
+		_period = JoyPi::_sensor_period;
+	}
+	JoyPi::_tasks[_task].period = _period < JOYPI_TICK_US ? JOYPI_TICK_US : _period;	// used from the next deadline on
+}
+
+void JoyPi::Run(uint32_t _duration){
+	JoyPi::_stop = false;												// a Stop of before ended the last run
+	JoyPi::Loop(_duration);
+}
+
+void JoyPi::Loop(uint32_t _duration){
+	uint64_t _now = JoyPi::Clock();
+	uint64_t _end = _now + _duration;
+
+	{
+		std::lock_guard<std::recursive_mutex> lock(JoyPi::_lock);
+		if (_now / JOYPI_TICK_US > JoyPi::_cursor + JOYPI_WHEEL_SLOTS){			// the loop didn't run for more than a turn: one turn visits every slot
+			JoyPi::_cursor = _now / JOYPI_TICK_US - JOYPI_WHEEL_SLOTS;
+		}
+	}
+	while (JoyPi::_stop == false){
+		_now = JoyPi::Clock();
+		if (_duration > 0 && _now >= _end){
+			break;
+		}
+		while (JoyPi::_stop == false){											// the slots up to now, more than one if a task took long
+			uint64_t _slot;
+			{
+				std::lock_guard<std::recursive_mutex> lock(JoyPi::_lock);		// not held by Due: it unlocks around the tasks
+				if (JoyPi::_cursor > _now / JOYPI_TICK_US){
+					break;
+				}
+				_slot = JoyPi::_cursor++;
+			}
+			JoyPi::Due(_slot);
+		}
+		_now = JoyPi::Clock();
+		uint64_t _next = JoyPi::NextSlot() * JOYPI_TICK_US;						// start of the next slot with a due task
+		if (_duration > 0 && _next > _end){
+			_next = _end;
+		}
+		if (_next > _now){
+			JoyPi::_hal->Delay(_next - _now);								// the only wait of the loop
+		}
+	}
+}
+
+void JoyPi::Start(){
+	if (JoyPi::_thread.joinable()){
+		if (JoyPi::_stop == false){										// runs already
+			return;
+		}
+		JoyPi::_thread.join();											// stopped by a task: the thread ends by itself
+	}
+	JoyPi::_stop = false;												// before the thread starts, so a Stop right after Start isn't lost
+	JoyPi::_thread = std::thread(&JoyPi::Loop, this, 0);
+}
+
+void JoyPi::Stop(){
+	JoyPi::_stop = true;
+	if (JoyPi::_thread.joinable() && JoyPi::_thread.get_id() != std::this_thread::get_id()){	// a task of the thread can't wait for itself
+		JoyPi::_thread.join();
+	}
+}
+
+int JoyPi::Tasks(){
+	std::lock_guard<std::recursive_mutex> lock(JoyPi::_lock);
+	return JoyPi::_count;
+}
+
+int JoyPi::Stats(int _task, JoyPi_task_stats &_stats){
+	std::lock_guard<std::recursive_mutex> lock(JoyPi::_lock);
+	if (_task < 0 || _task >= JoyPi::_count){
+		return 0;
+	}
+	const task &_t = JoyPi::_tasks[_task];
+	_stats.name = _t.name;
+	_stats.period = _t.period;
+	_stats.runs = _t.runs;
+	_stats.misses = _t.misses;
+	_stats.skipped = _t.skipped;
+	_stats.max_late = _t.max_late;
+	return 1;
+}
+
+void JoyPi::ResetStats(){
+	std::lock_guard<std::recursive_mutex> lock(JoyPi::_lock);
+	for (int i = 0; i < JoyPi::_count; i++){
+		JoyPi::_tasks[i].runs = 0;
+		JoyPi::_tasks[i].misses = 0;
+		JoyPi::_tasks[i].skipped = 0;
+		JoyPi::_tasks[i].max_late = 0;
+	}
+}
+
+int JoyPi::Add(const char _name[], uint32_t _period, std::function<uint32_t()> _run){
+	std::lock_guard<std::recursive_mutex> lock(JoyPi::_lock);
+	if (JoyPi::_count >= JOYPI_MAX_TASKS){
+		return -1;
+	}
+	int _id = JoyPi::_count++;
+	task &_t = JoyPi::_tasks[_id];
+	_t.name = _name;
+	_t.period = _period < JOYPI_TICK_US ? JOYPI_TICK_US : _period;
+	_t.deadline = JoyPi::Clock();										// first run as soon as the loop runs
+	_t.wake = _t.deadline;
+	_t.stepping = false;
+	_t.run = _run;
+	_t.runs = 0;
+	_t.misses = 0;
+	_t.skipped = 0;
+	_t.max_late = 0;
+	JoyPi::Insert(_id);
+	return _id;
+}
+
+void JoyPi::Insert(int _task){
+	task &_t = JoyPi::_tasks[_task];
+	uint64_t _slot = (_t.wake + JOYPI_TICK_US - 1) / JOYPI_TICK_US;		// first slot, which starts at or after the wake time
+	if (_slot < JoyPi::_cursor){											// late: the next slot to run
+		_slot = JoyPi::_cursor;
+	}
+	_t.next = JoyPi::_wheel[_slot % JOYPI_WHEEL_SLOTS];
+	JoyPi::_wheel[_slot % JOYPI_WHEEL_SLOTS] = _task;
+}
+
+uint64_t JoyPi::NextSlot(){
+	std::lock_guard<std::recursive_mutex> lock(JoyPi::_lock);
+	uint64_t _slot = JoyPi::_cursor;
+
+	for (int k = 0; k < JOYPI_WHEEL_SLOTS; k++, _slot++){						// one turn, the tasks of later turns wait in the same slots
+		for (int t = JoyPi::_wheel[_slot % JOYPI_WHEEL_SLOTS]; t >= 0; t = JoyPi::_tasks[t].next){
+			if (JoyPi::_tasks[t].wake < (_slot + 1) * JOYPI_TICK_US){
+				return _slot;
+			}
+		}
+	}
+	return _slot;																// no task in this turn: look again after it
+}
+
+void JoyPi::Due(uint64_t _slot){
+	std::unique_lock<std::recursive_mutex> lock(JoyPi::_lock);
+	int _due[JOYPI_MAX_TASKS];
+	int _count = 0;
+	int *_link = &JoyPi::_wheel[_slot % JOYPI_WHEEL_SLOTS];
+
+	while (*_link >= 0){													// take the tasks of this turn out, the later turns stay
+		task &_t = JoyPi::_tasks[*_link];
+		if (_t.wake < (_slot + 1) * JOYPI_TICK_US){
+			_due[_count++] = *_link;
+			*_link = _t.next;
+		}
+		else {
+			_link = &_t.next;
+		}
+	}
+
+	for (int i = _count - 1; i >= 0; i--){								// in the order of insertion
+		task &_t = JoyPi::_tasks[_due[i]];
+		uint64_t _now = JoyPi::Clock();
+		if (_t.stepping == false){										// a new run: check the deadline
+			uint64_t _late = _now > _t.deadline ? _now - _t.deadline : 0;
+			_t.runs++;
+			if (_late > JOYPI_SLACK_US){
+				_t.misses++;
+			}
+			if (_late > _t.max_late){
+				_t.max_late = _late;
+			}
+		}
+
+		lock.unlock();													// the task may call Every / Period / Stats, its run stays the same
+		uint32_t _again = _t.run();
+		lock.lock();
+		_now = JoyPi::Clock();
+		if (_again > 0){												// the next step of the job
+			_t.stepping = true;
+			_t.wake = _now + _again;
+		}
+		else {
+			_t.stepping = false;
+			_t.deadline += _t.period;									// fixed period, no drift
+			if (_t.deadline + _t.period <= _now){						// more than one deadline over: skip to the last one
+				uint64_t _over = (_now - _t.deadline) / _t.period;
+				_t.skipped += _over;
+				_t.deadline += _over * _t.period;
+			}
+			_t.wake = _t.deadline;
+		}
+		JoyPi::Insert(_due[i]);
+	}
+}
+
+uint64_t JoyPi::Clock(){
+	std::lock_guard<std::recursive_mutex> lock(JoyPi::_lock);
+	uint32_t _tick = JoyPi::_hal->Tick();
+	if (JoyPi::_clock_started == false){
+		JoyPi::_clock_started = true;
+		JoyPi::_last_tick = _tick;
+	}
+	JoyPi::_clock += _tick - JoyPi::_last_tick;							// unsigned difference: right across the wrap around
+	JoyPi::_last_tick = _tick;
+	return JoyPi::_clock;
+}
+
+uint32_t JoyPi::SensorStep(){
+	uint32_t _wait = 0;
+	if (JoyPi::_sensor.Read_Step(_wait) < 0){							// reading not finished
+		return _wait > 0 ? _wait : 1;
+	}
+	return 0;
+}
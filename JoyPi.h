@@ -0,0 +1,147 @@
+#pragma once
+#include "Common/hal.h"													// time of the Raspberry Pi or the simulation
+#include "DHT11/dht11.h"												// temperature and humidity sensor
+#include "LCD/lcd_mcp23008.h"											// 16x2 LCD
+#include "SevenSegment/SevenSegment.h"									// 7-segment LED display
+#include <inttypes.h>													// used for the int types like uint8_t
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+#define JOYPI_LCD_ADDR				0x21									// i2c address of the MCP23008 of the LCD
+#define JOYPI_LCD_ROWS				2
+#define JOYPI_LCD_COLS				16
+#define JOYPI_SEGMENT_ADDR			0x70									// i2c address of the HT16K33 of the 7-segment display
+#define JOYPI_TICK_US				1000									// µs of one slot of the timer wheel
+#define JOYPI_WHEEL_SLOTS			256										// slots of the timer wheel, later deadlines wait for the next turn
+#define JOYPI_MAX_TASKS				16										// max count of tasks (3 of them are the devices)
+#define JOYPI_SLACK_US				2000									// a task started later than this after its deadline is a deadline miss
+#define JOYPI_LCD_PERIOD			100000									// µs between two LCD flushes
+#define JOYPI_SEGMENT_PERIOD		20000									// µs between two 7-segment frames (50 fps)
+#define JOYPI_TASK_SENSOR			0										// task id of the DHT readings
+#define JOYPI_TASK_LCD				1										// task id of the LCD flushes
+#define JOYPI_TASK_SEGMENT			2										// task id of the 7-segment commits
+
+struct JoyPi_task_stats {
+	/* counters of one task, see JoyPi::Stats
+	*/
+	const char *name;
+	uint32_t period;													// µs between two runs
+	unsigned runs;														// count of runs (a reading of the sensor counts once)
+	unsigned misses;													// runs started more than JOYPI_SLACK_US after the deadline
+	unsigned skipped;													// runs dropped, because the next deadline was over already
+	uint32_t max_late;													// longest µs between deadline and start
+};
+
+class JoyPi {
+	/* class for the whole JoyPi board: the DHT11, the LCD and the 7-segment display.
+	 * One event loop drives all of them from one thread. The tasks are kept on a timer wheel
+	 * (JOYPI_WHEEL_SLOTS slots of JOYPI_TICK_US), every turn of the loop runs the tasks of the due slots,
+	 * then the loop sleeps till the next slot with a due task (max one turn). Nothing else waits:
+	 *  - the DHT reading is split into steps (start pulse, release, collect), see DHT::Read_Step
+	 *  - the LCD task sends the changed characters of the framebuffer by Flush
+	 *  - the 7-segment task sends the shadow RAM by commit, only if it changed
+	 * So the application writes into Lcd() and Segment() from its own tasks (Every) and
+	 * gets the values of the sensor by Sensor().Get_Sample. Use the devices only from the tasks,
+	 * while the loop runs. Every, Period, Tasks, Stats and ResetStats may be called from any thread.
+	 *
+	 * A task added or a Stop of an other thread takes effect, when the loop wakes up next.
+	 *
+	 * A task has a fixed period, its deadlines don't drift. If a task starts later than JOYPI_SLACK_US
+	 * after its deadline, it counts as a deadline miss. If the next deadline is over already too,
+	 * the runs in between are skipped and counted.
+	 *
+	*/
+public:
+	JoyPi(HAL *_hal=HAL::Default(), int _dht_pin=DHT_PIN, int _dht_type=DHT11);
+	/* constructor, opens all devices on the hardware backend _hal and initialises the LCD
+	*/
+	virtual ~JoyPi();
+	/* destructor, stops the loop and terminates the LCD
+	*/
+	int Status();
+	/* return 0 = all devices ready
+	 *      < 0 = error of PiGPIO or i2c of a device in the constructor, the loop runs anyway
+	 *            (the tasks of a missing device fail and count their i2c errors)
+	 *
+	*/
+	DHT &Sensor();
+	LCD_MCP23008_I2C &Lcd();
+	SevenSegment &Segment();
+	/* the devices of the board
+	*/
+	int Every(const char _name[], uint32_t _period, std::function<void()> _func);
+	/* add a task, which calls _func every _period µs (at least JOYPI_TICK_US) on the loop thread
+	 * _name is kept, it must stay valid
+	 *
+	 * return the id of the task for Period and Stats
+	 *        -1 = no free task
+	 *
+	*/
+	void Period(int _task, uint32_t _period);
+	/* change the period of a task in µs, e.g. Period(JOYPI_TASK_LCD, 50000)
+	 * The period of the sensor is at least DHT11_MIN_PERIOD / DHT22_MIN_PERIOD.
+	*/
+	void Run(uint32_t _duration=0);
+	/* run the event loop on the caller's thread for _duration µs, 0 = till Stop
+	*/
+	void Start();
+	/* run the event loop on an own thread, a thread stopped by a task is joined first
+	*/
+	void Stop();
+	/* stop the event loop (from a task or an other thread) and wait for the thread of Start
+	*/
+	int Tasks();
+	/* return the count of tasks
+	*/
+	int Stats(int _task, JoyPi_task_stats &_stats);
+	/* copy the counters of the task into _stats
+	 *
+	 * return 1 = okay, 0 = unknown task
+	 *
+	*/
+	void ResetStats();
+	/* set the counters of all tasks to 0
+	*/
+
+private:
+	struct task {
+		const char *name;
+		uint32_t period;												// µs between two deadlines
+		uint64_t deadline;												// µs of the loop clock, when the next run is due
+		uint64_t wake;													// µs of the loop clock, when the task is called (deadline or next step)
+		bool stepping;													// true while a job of many steps runs (no deadline till it is done)
+		std::function<uint32_t()> run;									// returns 0 = done, > 0 = call again after this µs
+		int next;														// next task in the same slot, -1 = last
+		unsigned runs;
+		unsigned misses;
+		unsigned skipped;
+		uint32_t max_late;
+	};
+
+	int Add(const char _name[], uint32_t _period, std::function<uint32_t()> _run);	// add a task, due now
+	void Insert(int _task);												// put the task into the slot of its wake time
+	void Due(uint64_t _slot);											// run the due tasks of the slot
+	void Loop(uint32_t _duration);										// the event loop of Run and Start, till _stop or _duration µs
+	uint64_t NextSlot();												// first slot from the cursor on with a due task, max one turn ahead
+	uint64_t Clock();													// µs since the first call, the tick of the HAL wraps around after ~72 minutes
+	uint32_t SensorStep();												// task of the sensor
+
+	HAL *_hal;
+	DHT _sensor;
+	LCD_MCP23008_I2C _lcd;
+	SevenSegment _segment;
+	int _status = 0;													// first error of the devices, see Status
+	uint32_t _sensor_period;											// min µs between two readings of the sensor type
+	task _tasks[JOYPI_MAX_TASKS];
+	int _count = 0;														// count of tasks
+	int _wheel[JOYPI_WHEEL_SLOTS];										// first task of every slot, -1 = empty
+	uint64_t _cursor = 0;												// next slot (in JOYPI_TICK_US since the start) to run
+	uint64_t _clock = 0;												// µs of the loop clock
+	uint32_t _last_tick = 0;											// tick of the HAL at the last Clock call
+	bool _clock_started = false;
+	std::atomic<bool> _stop{false};
+	std::recursive_mutex _lock;											// tasks, wheel and clock: Every / Period / Stats of other threads against the loop
+	std::thread _thread;												// thread of Start
+};
@@ -0,0 +1,62 @@
+/* benchmark for the LCD Display: i2c transactions and time per PrintLine / Clear
+ *
+ * commands:
+ * compile: g++ -Wall -c lcd_mcp23008.cpp "%f"
+ * build: g++ -Wall -o "%e" lcd_mcp23008.cpp ../MCP23008/mcp23008.cpp ../Common/hal_pigpio.cpp ../Common/pi_context.cpp ../Common/bus_trace.cpp ../Common/bus_scheduler.cpp "%f" -lpigpio -pthread
+*/
+
+#include "lcd_mcp23008.h"												// include the driver
+#include <stdio.h>														// for printf
+#include <chrono>														// for the wall time
+
+#define RUNS	50														// PrintLine calls per mode
+
+LCD_MCP23008_I2C LCD1(0x21,2,16);
+
+void measure(bool _batch, bool _busy){
+	LCD1.BatchMode(_batch);												// mode to measure
+	_busy = LCD1.BusyMode(_busy);										// busy mode can fall back to the fixed delays
+	LCD1.ResetTransactions();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < RUNS; i++) {
+		LCD1.PrintLine("0123456789ABCDEF",i%2);							// 16 characters, alternating lines
+	}
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	long _us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+	printf("PrintLine %-7s %-6s %8.1f transactions %10.1f us\n", _batch ? "batch" : "single", _busy ? "busy" : "fixed", LCD1.Transactions()/(float)RUNS, _us/(float)RUNS);
+}
+
+void measure_clear(bool _busy){
+	_busy = LCD1.BusyMode(_busy);
+	LCD1.ResetTransactions();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < RUNS; i++) {
+		LCD1.Clear();													// 1.52ms by datasheet, 2ms fixed delay
+		LCD1.Home();
+	}
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	long _us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+	printf("Clear+Home        %-6s %8.1f transactions %10.1f us\n", _busy ? "busy" : "fixed", LCD1.Transactions()/(float)RUNS, _us/(float)RUNS);
+}
+
+int main(){
+	if (LCD1.Init() < 0){
+		return 1;
+	}
+	LCD1.Backlight(true);
+
+	measure(false, false);												// before: 4 transactions and 4 usleep per character
+	measure(true, false);												// after: block writes, timing by the i2c clock
+	measure(false, true);												// single writes, waiting by the busy flag
+	measure_clear(false);												// fixed delays of Clear and Home
+	measure_clear(true);												// busy flag of Clear and Home
+	LCD1.BusyMode(false);
+
+	LCD1.Clear();
+	LCD1.Backlight(false);
+	LCD1.Term();
+}
@@ -2,7 +2,7 @@
  * 
  * commands:
  * compile: g++ -Wall -c lcd_mcp23008.cpp "%f"
- * build: g++ -Wall -o "%e" lcd_mcp23008.cpp "%f" -lpigpio
+ * build: g++ -Wall -o "%e" lcd_mcp23008.cpp ../MCP23008/mcp23008.cpp ../Common/hal_pigpio.cpp ../Common/pi_context.cpp ../Common/bus_trace.cpp ../Common/bus_scheduler.cpp "%f" -lpigpio -pthread
 */
 
 #include "lcd_mcp23008.h"												// include the driver
@@ -14,7 +14,9 @@ LCD_MCP23008_I2C LCD1(0x21,2,16);
 
 
 int main(){
-    LCD1.Init();
+	if (LCD1.Init() < 0){												// no PiGPIO or no LCD on the i2c
+		return 1;
+	}
 	LCD1.Backlight(true);
 	LCD1.ShowCursor(true);
 	LCD1.BlinkCursor(true);
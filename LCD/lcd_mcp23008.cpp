@@ -1,15 +1,23 @@
 /* LCD Display with MCP23008 Controler */
 #include "lcd_mcp23008.h"																						// own header file
-#include <pigpio.h>																								// the PiGPIO header file
-#include <unistd.h>																								// for sleep / usleep
 #include <string.h>																								// for string convertion (strlen)
-#include <stdlib.h>																								// used for exit function
 #include <stdio.h>																								// for printf
 
-LCD_MCP23008_I2C::LCD_MCP23008_I2C(int _addr, int _rows, int _cols){
-	LCD_MCP23008_I2C::addr= _addr;
+LCD_MCP23008_I2C::LCD_MCP23008_I2C(int _addr, int _rows, int _cols, HAL *_hal) : _expander(_addr, _hal){
+	LCD_MCP23008_I2C::_hal = _hal;																				// time by this backend, i2c by the expander
 	LCD_MCP23008_I2C::rows = _rows;
 	LCD_MCP23008_I2C::cols = _cols;
+	if (_rows > LCD_MAX_ROWS) {																					// the framebuffer has max 4 rows
+		LCD_MCP23008_I2C::rows = LCD_MAX_ROWS;
+	}
+	if (_cols > LCD_MAX_COLS) {																					// and max 40 characters per row
+		LCD_MCP23008_I2C::cols = LCD_MAX_COLS;
+	}
+	LCD_MCP23008_I2C::ClearFrame();																				// framebuffer and display are empty
+	for (int i=0; i < LCD_CGRAM_SLOTS; i++) {																	// the CGRAM content is unknown
+		LCD_MCP23008_I2C::_slot_glyph[i] = -1;
+		LCD_MCP23008_I2C::_slot_used[i] = 0;
+	}
 	LCD_MCP23008_I2C::backlightval=LCD_NOBACKLIGHT;																// set backlight off by default
 
 	// set display rows
@@ -22,90 +30,162 @@ LCD_MCP23008_I2C::LCD_MCP23008_I2C(int _addr, int _rows, int _cols){
 }
 
 LCD_MCP23008_I2C::~LCD_MCP23008_I2C(){
-
+	LCD_MCP23008_I2C::Term();																					// release i2c and PiGPIO if Term was not called
 }
 
-void LCD_MCP23008_I2C::Init(){
-	if (gpioInitialise() < 0){																					// if initialisation of pigpio failed
-		printf("##############################################\n");
-		printf("#              Can't use PIGPIO!             #\n");
-		printf("# Maybe PIGPIO is used by an other instance? #\n");
-		printf("##############################################\n");
-		exit (EXIT_FAILURE);																					// exit the program
-	}
-	else{
-		if ((LCD_MCP23008_I2C::_handle=i2cOpen(1,LCD_MCP23008_I2C::addr,0)) < 0) {								// try to open i2c
-			printf("##############################################\n");
-			printf("#               Can't open I2C!              #\n");
-			printf("# Maybe device is used by an other instance? #\n");
-			printf("##############################################\n");
-			exit (EXIT_FAILURE);																				// exit the program
-		} 
-		else {
-			//set MCP23008 config
-			LCD_MCP23008_I2C::MCP23008_reg_write(REGISTER_IODIR,MCP23008_IODIR_ALL_OUTPUT);						// set all GPIO-Pins as output
-			LCD_MCP23008_I2C::MCP23008_reg_write(REGISTER_IOPOL,MCP23008_IPOL_ALL_NORMAL);						// set all GPIO-Pins as non inverted
-			LCD_MCP23008_I2C::MCP23008_reg_write(REGISTER_GPPU,MCP23008_GPPU_ALL_DISABLED);						// disable all GPIO-Pins PullUp resistors
-			LCD_MCP23008_I2C::MCP23008_reg_write(REGISTER_GPIO,MCP23008_GPIO_ALL_LOW);							// set all GPIO-Pins to state low
-			
-			// set LCD into 4-bit mode
-			LCD_MCP23008_I2C::Command(0x33);																	// send 2 times 0x3
-			LCD_MCP23008_I2C::Command(0x32);																	// send 0x3 and 0x2
-			
-			// Set LCD functions number of lines and font size
-			LCD_MCP23008_I2C::_displayfunction = LCD_4BITMODE | LCD_MCP23008_I2C::lines | LCD_5x8DOTS;			// set 4 bit mode, count of lines and LCD dots per character
-			LCD_MCP23008_I2C::Command(LCD_FUNCTIONSET | LCD_MCP23008_I2C::_displayfunction); 					// send as command
-		
-			// Set Display to on with no coursor or blinking cursor by default
-			LCD_MCP23008_I2C::_displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;					// set Display on, Coursor off and Blink off
-			LCD_MCP23008_I2C::Display(true);																	// set _displaycontrol by the Display function
-				
-			// Initialize to default text direction (for roman languages)
-			LCD_MCP23008_I2C::_displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;							// set direction to write on the display
-			LCD_MCP23008_I2C::Command(LCD_ENTRYMODESET | LCD_MCP23008_I2C::_displaymode);						// send as command
-		
-			// Clear the Display and go Home
-			LCD_MCP23008_I2C::Clear();																			// clear the display
-		}
+int LCD_MCP23008_I2C::Init(){
+	if (LCD_MCP23008_I2C::_acquired == true){																	// Init was called before
+		LCD_MCP23008_I2C::Term();
 	}
-}
+	int _status = LCD_MCP23008_I2C::_expander.Init();															// PiGPIO, i2c and IOCON SEQOP (block writes repeat the GPIO register)
+	if (_status < 0){																							// no answer even after the retries: no LCD on this address
+		return _status;
+	}
+	LCD_MCP23008_I2C::_acquired = true;
+	
+	//set MCP23008 config
+	LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_IODIR,MCP23008_IODIR_ALL_OUTPUT);								// set all GPIO-Pins as output
+	LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_IOPOL,MCP23008_IPOL_ALL_NORMAL);								// set all GPIO-Pins as non inverted
+	LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_GPPU,MCP23008_GPPU_ALL_DISABLED);								// disable all GPIO-Pins PullUp resistors
+	LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_GPIO,MCP23008_GPIO_ALL_LOW);									// set all GPIO-Pins to state low
+	
+	// set LCD into 4-bit mode
+	bool batch = LCD_MCP23008_I2C::_batch;																		// the LCD is still in 8-bit mode,
+	LCD_MCP23008_I2C::_batch = false;																			// so send the nibbles with delays
+	LCD_MCP23008_I2C::Command(0x33);																			// send 2 times 0x3
+	LCD_MCP23008_I2C::Command(0x32);																			// send 0x3 and 0x2
+	LCD_MCP23008_I2C::_batch = batch;
+	
+	// Set LCD functions number of lines and font size
+	LCD_MCP23008_I2C::_displayfunction = LCD_4BITMODE | LCD_MCP23008_I2C::lines | LCD_5x8DOTS;					// set 4 bit mode, count of lines and LCD dots per character
+	LCD_MCP23008_I2C::Command(LCD_FUNCTIONSET | LCD_MCP23008_I2C::_displayfunction); 					// send as command
 
-void LCD_MCP23008_I2C::Term(){
-	i2cClose(LCD_MCP23008_I2C::_handle);																		// close i2c connection
-	gpioTerminate();																							// terminate pigpio
-}
+	// Set Display to on with no coursor or blinking cursor by default
+	LCD_MCP23008_I2C::_displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;							// set Display on, Coursor off and Blink off
+	LCD_MCP23008_I2C::Display(true);																			// set _displaycontrol by the Display function
+		
+	// Initialize to default text direction (for roman languages)
+	LCD_MCP23008_I2C::_displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;									// set direction to write on the display
+	LCD_MCP23008_I2C::Command(LCD_ENTRYMODESET | LCD_MCP23008_I2C::_displaymode);								// send as command
 
-uint8_t LCD_MCP23008_I2C::MCP23008_reg_read(uint8_t reg){
-	uint8_t reg_data;
-	reg_data=i2cReadByteData(LCD_MCP23008_I2C::_handle, reg);													// read data of given register
-	return reg_data;																							// return data
+	for (int i=0; i < LCD_CGRAM_SLOTS; i++) {																	// the CGRAM content is unknown after power up
+		LCD_MCP23008_I2C::_slot_glyph[i] = -1;
+	}
+	
+	// Clear the Display and go Home
+	LCD_MCP23008_I2C::Clear();																					// clear the display
+	return 0;
 }
 
-void LCD_MCP23008_I2C::MCP23008_reg_write(uint8_t reg, uint8_t data){
-	i2cWriteByteData(LCD_MCP23008_I2C::_handle, reg, data);														// write data to given MCP register 
+void LCD_MCP23008_I2C::Term(){
+	if (LCD_MCP23008_I2C::_acquired == false){																	// nothing to close
+		return;
+	}
+	LCD_MCP23008_I2C::StopMarquee();																			// the timer must not use the closed handle
+	LCD_MCP23008_I2C::_acquired = false;
+	LCD_MCP23008_I2C::_expander.Term();																			// send the queued writes, close i2c and PiGPIO
 }
 
-void LCD_MCP23008_I2C::Send(uint8_t _data, uint8_t _mode){
+int LCD_MCP23008_I2C::Send(uint8_t _data, uint8_t _mode){
+	if (LCD_MCP23008_I2C::_batch == true) {																		// if batch mode on
+		return LCD_MCP23008_I2C::SendBlock(&_data, 1, _mode);													// send both nibbles in one transaction
+	}
+	
 	uint8_t _lownib = _data & 0x0f;																				// extract the lowest 4 bits from _data to lownib 
 	uint8_t _highnib = (_data & 0xf0)>>4;																		// extract the highest 4 bits from _data to highnib and move it 4 bits down
 	
-	LCD_MCP23008_I2C::Send4Bits(_highnib, _mode);																// Send the high bits and the mode
+	int _status = LCD_MCP23008_I2C::Send4Bits(_highnib, _mode);													// Send the high bits and the mode
+	
+	int _low = LCD_MCP23008_I2C::Send4Bits(_lownib, _mode);														// Send the low bits and the mode
 	
-	LCD_MCP23008_I2C::Send4Bits(_lownib, _mode);																// Send the low bits and the mode
+	return _status < 0 ? _status : _low;
 }
 	
 	
-void LCD_MCP23008_I2C::Send4Bits(uint8_t _data, uint8_t _mode){
+int LCD_MCP23008_I2C::Send4Bits(uint8_t _data, uint8_t _mode){
 	uint8_t _sendData = 0x00;																					// sendData = empty	
 	_sendData = _sendData | LCD_MCP23008_I2C::backlightval | (_data<<3) | _mode;								// sendData = backlightval and 4 bits from Send moved 3 position to the left and the modebits
 	 
 	_sendData |= LCD_EN;																						// set enablebit to 1 in sendData (set Pulse to on)
-	LCD_MCP23008_I2C::MCP23008_reg_write(REGISTER_GPIO, _sendData);												// write senddata to MCP GPIO output register
-	usleep(50);																									// sleep 50µs to wait that the display read the data from the MCP output register
+	int _status = LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_GPIO, _sendData);							// write senddata to MCP GPIO output register
+	if (LCD_MCP23008_I2C::_busymode == false && LCD_MCP23008_I2C::_expander.Scheduled() == false) {							// the i2c transaction is a long enough pulse in busy mode, scheduled writes are merged into blocks like SendBlock
+		LCD_MCP23008_I2C::_hal->Delay(50);																		// sleep 50µs to wait that the display read the data from the MCP output register
+	}
 	
 	_sendData &= ~LCD_EN;																						// set Enablebit to 0 in sendData (set pulse to off)
-	LCD_MCP23008_I2C::MCP23008_reg_write(REGISTER_GPIO, _sendData);												// write senddata to MCP GPIO output register
-	usleep(50);																									// sleep 50µs to wait that the display read the data from the MCP output register
+	int _off = LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_GPIO, _sendData);								// write senddata to MCP GPIO output register
+	if (LCD_MCP23008_I2C::_busymode == false && LCD_MCP23008_I2C::_expander.Scheduled() == false) {							// in busy mode the 4 writes of the next byte take longer than the 37µs of this one
+		LCD_MCP23008_I2C::_hal->Delay(50);																		// sleep 50µs to wait that the display read the data from the MCP output register
+	}
+	return _status < 0 ? _status : _off;
+}
+
+int LCD_MCP23008_I2C::ReadBusy(){
+	/* In 4-bit mode the busy flag is DB7 of the high nibble (GPA6).
+	 * Both nibbles must be clocked out with the enable bit, the low nibble is not needed,
+	 * so its pulse is sent in one block write with the end of the first pulse (3 transactions per read).
+	 */
+	uint8_t _read = LCD_MCP23008_I2C::backlightval | LCD_READ;													// R/W high, RS low: read busy flag and address
+	uint8_t _pulses[3] = { _read, (uint8_t)(_read | LCD_EN), _read };											// pulse off, pulse on / off for the low nibble
+	int _high = 0;
+	
+	LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_GPIO, _read | LCD_EN);										// pulse on: LCD puts the high nibble on the data pins
+	_high = LCD_MCP23008_I2C::_expander.ReadRegister(REGISTER_GPIO);													// read the data pins
+	LCD_MCP23008_I2C::_expander.WriteBlock(_pulses, 3);
+	
+	if (_high < 0) {																							// i2c read failed
+		return _high;
+	}
+	return (_high & LCD_BUSYFLAG) ? 1 : 0;
+}
+
+void LCD_MCP23008_I2C::WaitReady(int _us){
+	if (LCD_MCP23008_I2C::_busymode == true) {																	// if busy mode on
+		int _busy = 1;
+		LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_IODIR, LCD_DATA_PINS);									// data pins as input, all other as output (once for all reads)
+		for (int i = 0; i < LCD_BUSY_POLLS && _busy == 1; i++) {
+			_busy = LCD_MCP23008_I2C::ReadBusy();																// poll till the LCD is ready
+		}
+		LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_GPIO, LCD_MCP23008_I2C::backlightval);					// R/W low again
+		LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_IODIR, MCP23008_IODIR_ALL_OUTPUT);						// all pins as output again
+		if (_busy == 0) {																						// LCD is ready
+			return;
+		}
+		LCD_MCP23008_I2C::BusyMode(false);																		// read failed or the flag never cleared (R/W not connected?): use the fixed delays
+	}
+	LCD_MCP23008_I2C::_expander.Pause(_us);																				// fixed delay for the worst case
+}
+
+int LCD_MCP23008_I2C::SendBlock(const uint8_t _data[], int _count, uint8_t _mode){
+	/* Every byte needs 4 GPIO states: high nibble with enable on / off, low nibble with enable on / off.
+	 * One i2c byte takes 90µs at 100kHz (22.5µs at 400kHz), so the enable pulse and the 37µs
+	 * the LCD needs for a character are given by the bus clock and no usleep is needed.
+	 */
+	uint8_t _buffer[MCP23008_BLOCK_MAX];																		// GPIO states for one block write
+	int _fill = 0;
+	int _status = 0;																							// first i2c error
+	int _block;
+	
+	for (int i = 0; i < _count; i++) {																			// for every byte
+		uint8_t _nibble[2] = { (uint8_t)((_data[i] & 0xf0)>>4), (uint8_t)(_data[i] & 0x0f) };					// high nibble first, then low nibble
+		for (int n = 0; n < 2; n++) {
+			uint8_t _sendData = LCD_MCP23008_I2C::backlightval | (_nibble[n]<<3) | _mode;						// same bits as Send4Bits
+			_buffer[_fill++] = _sendData | LCD_EN;																// pulse on
+			_buffer[_fill++] = _sendData & ~LCD_EN;																// pulse off
+		}
+		if (_fill == MCP23008_BLOCK_MAX) {																		// block is full (32 GPIO states = 8 characters)
+			if ((_block = LCD_MCP23008_I2C::_expander.WriteBlock(_buffer, _fill)) < 0 && _status == 0) {		// send it
+				_status = _block;
+			}
+			_fill = 0;
+		}
+	}
+	if (_fill > 0) {																							// send the rest
+		if ((_block = LCD_MCP23008_I2C::_expander.WriteBlock(_buffer, _fill)) < 0 && _status == 0) {
+			_status = _block;
+		}
+	}
+	return _status;
 }
 
 void LCD_MCP23008_I2C::Command(uint8_t _cmd){
@@ -184,7 +264,10 @@ void LCD_MCP23008_I2C::LeftToRight(bool _direction) {
 
 void LCD_MCP23008_I2C::Clear() {
 	LCD_MCP23008_I2C::Command(LCD_CLEARDISPLAY);																// send Command LCD_CLEARDISPLAY (clear display, set cursor position to zero)
-	usleep(2000);  																								// this command takes a long time!  --> sleep 2msec
+	LCD_MCP23008_I2C::WaitReady(2000);																			// this command takes a long time!  --> busy flag or sleep 2msec
+	LCD_MCP23008_I2C::ClearFrame();																				// framebuffer and display are empty now, the CGRAM keeps the glyphs
+	LCD_MCP23008_I2C::_cursor_row = 0;
+	LCD_MCP23008_I2C::_cursor_col = 0;
 }
 
 void LCD_MCP23008_I2C::SetCursor(uint8_t _row, uint8_t _col){
@@ -193,29 +276,354 @@ void LCD_MCP23008_I2C::SetCursor(uint8_t _row, uint8_t _col){
 		_row = LCD_MCP23008_I2C::rows-1;    																	// set the given _row to max on initialize - 1, then we start count rows by 0
 	}
 	LCD_MCP23008_I2C::Command(LCD_SETDDRAMADDR | (_col + row_offsets[_row]));									// send Command to set Cursor Position into DRAM
+	LCD_MCP23008_I2C::_cursor_row = _row;
+	LCD_MCP23008_I2C::_cursor_col = _col;
 }
 
 void LCD_MCP23008_I2C::Home() {
 	LCD_MCP23008_I2C::Command(LCD_RETURNHOME);																	// set cursor position to zero
-	usleep(2000);																								// this command takes a long time! see Datasheet: 1.52msec --> sleep 2msec
+	LCD_MCP23008_I2C::WaitReady(2000);																			// this command takes a long time! see Datasheet: 1.52msec --> busy flag or sleep 2msec
+	LCD_MCP23008_I2C::_cursor_row = 0;
+	LCD_MCP23008_I2C::_cursor_col = 0;
 }
 
 void LCD_MCP23008_I2C::Print(const char _text[], int _delay){
-	if (int(strlen(_text))>LCD_MCP23008_I2C::cols){																// if the given _text longer than the cols from the display
-		for (int i=0; i < LCD_MCP23008_I2C::cols; i++) {														// do for character in the text til the end of the Display arrived
-			LCD_MCP23008_I2C::Send((int)(_text[i]), (LCD_RW));													// send ASCII-Code of the character and dr mode LCD_RW to Send function
-			usleep((_delay*1000));																				// to set the print _delay, wait the given time in msec before the next character printed
+	int _count = int(strlen(_text));
+	if (_count > LCD_MCP23008_I2C::cols){																		// if the given _text longer than the cols from the display
+		_count = LCD_MCP23008_I2C::cols;																		// print only the characters til the end of the Display
+	}
+	LCD_MCP23008_I2C::PrintRaw((const uint8_t *)_text, _count, _delay);
+}
+
+int LCD_MCP23008_I2C::PrintRaw(const uint8_t _data[], int _count, int _delay){
+	int _status = 0;																							// first i2c error
+	
+	if (LCD_MCP23008_I2C::_batch == true && _delay == 0) {														// if batch mode on and no delay between the characters
+		_status = LCD_MCP23008_I2C::SendBlock(_data, _count, LCD_RW);											// send all characters as block writes
+		for (int i=0; i < _count; i++) {
+			LCD_MCP23008_I2C::Track(_data[i]);																	// note the characters for the framebuffer
 		}
+		return _status;
 	}
-	else {
-		for (int i=0; i < int(strlen(_text)); i++) {															// for every character in the text
-			LCD_MCP23008_I2C::Send((int)(_text[i]), (LCD_RW));													// send ASCII-Code of the character and dr mode LCD_RW to Send function
-			usleep((_delay*1000));																				// to set the print _delay, wait the given time in msec before the next character printed
+	
+	for (int i=0; i < _count; i++) {																			// for every character
+		int _sent = LCD_MCP23008_I2C::Send(_data[i], (LCD_RW));													// send ASCII-Code of the character and dr mode LCD_RW to Send function
+		if (_sent < 0 && _status == 0) {
+			_status = _sent;
 		}
+		LCD_MCP23008_I2C::Track(_data[i]);																		// note the character for the framebuffer
+		LCD_MCP23008_I2C::_expander.Pause(_delay*1000);																	// to set the print _delay, wait the given time in msec before the next character printed (scheduled: without blocking)
 	}
+	return _status;
 }
 
 void LCD_MCP23008_I2C::PrintLine(const char _text[], uint8_t _line){
 	LCD_MCP23008_I2C::SetCursor(_line,0);																		// set coursor to the given line on first position
 	LCD_MCP23008_I2C::Print(_text,0);																			// Print the given _text without delay
 }
+
+void LCD_MCP23008_I2C::Track(uint8_t _char){
+	if (LCD_MCP23008_I2C::_cursor_row < LCD_MAX_ROWS && LCD_MCP23008_I2C::_cursor_col < LCD_MAX_COLS) {		// inside the DDRAM line (not after a CGRAM upload)
+		LCD_MCP23008_I2C::_ddram[LCD_MCP23008_I2C::_cursor_row][LCD_MCP23008_I2C::_cursor_col] = _char;		// the display shows this character now
+	}
+	if (LCD_MCP23008_I2C::_displaymode & LCD_ENTRYLEFT) {														// cursor moves like the entry mode
+		LCD_MCP23008_I2C::_cursor_col++;
+	}
+	else {
+		LCD_MCP23008_I2C::_cursor_col--;																		// 0 - 1 = 255: outside, not tracked anymore
+	}
+}
+
+void LCD_MCP23008_I2C::Write(uint8_t _row, uint8_t _col, const char _text[]){
+	if (_row >= LCD_MCP23008_I2C::rows) {																		// not an row of the display
+		return;
+	}
+	for (int i=0; _text[i] != 0 && _col+i < LCD_MCP23008_I2C::cols; i++) {									// for every character till the end of the line
+		LCD_MCP23008_I2C::_frame[_row][_col+i] = (uint8_t)_text[i];												// only into the framebuffer
+	}
+}
+
+void LCD_MCP23008_I2C::WriteLine(const char _text[], uint8_t _line){
+	if (_line >= LCD_MCP23008_I2C::rows) {																		// not an row of the display
+		return;
+	}
+	for (int c=0; c < LCD_MCP23008_I2C::cols; c++) {															// empty line
+		LCD_MCP23008_I2C::_frame[_line][c] = ' ';
+	}
+	LCD_MCP23008_I2C::Write(_line, 0, _text);																	// and the text at position 0
+}
+
+int LCD_MCP23008_I2C::Flush(){
+	int _sent = 0;																								// bytes sent to the display
+	int _full = LCD_MCP23008_I2C::rows * (1 + LCD_MCP23008_I2C::cols);											// bytes to rewrite all lines: SetCursor + characters
+	
+	for (int r=0; r < LCD_MCP23008_I2C::rows; r++) {
+		int c = 0;
+		while (c < LCD_MCP23008_I2C::cols) {
+			if (LCD_MCP23008_I2C::_frame[r][c] == LCD_MCP23008_I2C::_ddram[r][c]) {							// display shows this character already
+				c++;
+				continue;
+			}
+			
+			// collect a run of changed characters. A single unchanged character between two changes
+			// costs the same byte as a new SetCursor, so it is sent with the run.
+			int _start = c;
+			int _end = c + 1;																					// first character after the run
+			while (_end < LCD_MCP23008_I2C::cols) {
+				if (LCD_MCP23008_I2C::_frame[r][_end] != LCD_MCP23008_I2C::_ddram[r][_end]) {
+					_end++;																						// changed: part of the run
+				}
+				else if (_end+1 < LCD_MCP23008_I2C::cols && LCD_MCP23008_I2C::_frame[r][_end+1] != LCD_MCP23008_I2C::_ddram[r][_end+1]) {
+					_end += 2;																					// one unchanged character, then the next change
+				}
+				else {
+					break;
+				}
+			}
+			
+			// the address counter moves like the entry mode: right to left the run is sent from its end
+			bool _left = (LCD_MCP23008_I2C::_displaymode & LCD_ENTRYLEFT) != 0;
+			int _first = _left ? _start : _end - 1;															// column of the first character sent
+			uint8_t _chars[LCD_MAX_COLS];																		// character codes of the run in the order they are sent
+			for (int i=_start; i < _end; i++) {
+				uint16_t _cell = LCD_MCP23008_I2C::_frame[r][i];
+				int _k = _left ? i - _start : _end - 1 - i;
+				if (_cell < LCD_GLYPH_BASE) {
+					_chars[_k] = _cell;
+				}
+				else {
+					unsigned _misses = LCD_MCP23008_I2C::_glyph_misses;
+					int _slot = LCD_MCP23008_I2C::GlyphSlot(_cell - LCD_GLYPH_BASE);							// uploads move the address counter into the CGRAM
+					_chars[_k] = _slot >= 0 ? _slot : LCD_GLYPH_MISSING;
+					if (_slot >= 0 && LCD_MCP23008_I2C::_glyph_misses != _misses) {
+						_sent += 1 + LCD_GLYPH_ROWS;															// uploaded: SetCGRAMAddr + pattern, the SetCursor back is counted below
+					}
+				}
+			}
+			
+			if (LCD_MCP23008_I2C::_cursor_row != r || LCD_MCP23008_I2C::_cursor_col != _first) {
+				LCD_MCP23008_I2C::SetCursor(r, _first);															// move the cursor only if it is not there already
+				_sent++;
+			}
+			int _status = LCD_MCP23008_I2C::PrintRaw(_chars, _end - _start, 0);									// send the run, PrintRaw notes the character codes in _ddram
+			if (_status < 0) {																					// not all shown: the next Flush sends the run again
+				for (int i=_start; i < _end; i++) {
+					LCD_MCP23008_I2C::_ddram[r][i] = LCD_DDRAM_UNKNOWN;
+				}
+				LCD_MCP23008_I2C::_cursor_row = LCD_MAX_ROWS;													// the address counter is unknown too: SetCursor first
+				return _status;
+			}
+			for (int i=_start; i < _end; i++) {
+				if (LCD_MCP23008_I2C::_frame[r][i] >= LCD_GLYPH_BASE && _chars[_left ? i - _start : _end - 1 - i] != LCD_GLYPH_MISSING) {
+					LCD_MCP23008_I2C::_ddram[r][i] = LCD_MCP23008_I2C::_frame[r][i];							// the glyph is shown, not only its slot
+				}
+			}
+			_sent += _end - _start;
+			c = _end;
+		}
+	}
+	
+	return _full - _sent;
+}
+
+int LCD_MCP23008_I2C::DefineGlyph(const uint8_t _pattern[LCD_GLYPH_ROWS]){
+	int _count = LCD_MCP23008_I2C::_glyphs.size() / LCD_GLYPH_ROWS;
+	for (int g=0; g < _count; g++) {																			// registered already?
+		int i = 0;
+		while (i < LCD_GLYPH_ROWS && LCD_MCP23008_I2C::_glyphs[g*LCD_GLYPH_ROWS + i] == (_pattern[i] & 0x1F)) {
+			i++;
+		}
+		if (i == LCD_GLYPH_ROWS) {
+			return g;
+		}
+	}
+	for (int i=0; i < LCD_GLYPH_ROWS; i++) {
+		LCD_MCP23008_I2C::_glyphs.push_back(_pattern[i] & 0x1F);												// only 5 dots per row
+	}
+	return _count;
+}
+
+void LCD_MCP23008_I2C::WriteGlyph(uint8_t _row, uint8_t _col, int _glyph){
+	if (_row >= LCD_MCP23008_I2C::rows || _col >= LCD_MCP23008_I2C::cols) {									// not on the display
+		return;
+	}
+	if (_glyph < 0 || _glyph >= (int)(LCD_MCP23008_I2C::_glyphs.size() / LCD_GLYPH_ROWS)) {					// not registered
+		return;
+	}
+	LCD_MCP23008_I2C::_frame[_row][_col] = LCD_GLYPH_BASE + _glyph;											// only into the framebuffer
+}
+
+unsigned LCD_MCP23008_I2C::GlyphHits(){
+	return LCD_MCP23008_I2C::_glyph_hits;
+}
+
+unsigned LCD_MCP23008_I2C::GlyphMisses(){
+	return LCD_MCP23008_I2C::_glyph_misses;
+}
+
+int LCD_MCP23008_I2C::GlyphSlot(int _glyph){
+	int _slot = -1;
+	
+	for (int i=0; i < LCD_CGRAM_SLOTS; i++) {
+		if (LCD_MCP23008_I2C::_slot_glyph[i] == _glyph) {
+			_slot = i;
+		}
+	}
+	if (_slot >= 0) {																							// hit: the CGRAM has the pattern already
+		LCD_MCP23008_I2C::_slot_used[_slot] = ++LCD_MCP23008_I2C::_glyph_clock;
+		LCD_MCP23008_I2C::_glyph_hits++;
+		return _slot;
+	}
+	
+	// miss: replace the least recently used slot, but not a slot of a glyph in the framebuffer,
+	// it is (or will be) visible and would change its look on the display
+	bool _visible[LCD_CGRAM_SLOTS] = {false};
+	for (int r=0; r < LCD_MCP23008_I2C::rows; r++) {
+		for (int c=0; c < LCD_MCP23008_I2C::cols; c++) {
+			for (int i=0; i < LCD_CGRAM_SLOTS && LCD_MCP23008_I2C::_frame[r][c] >= LCD_GLYPH_BASE; i++) {
+				if (LCD_MCP23008_I2C::_slot_glyph[i] == LCD_MCP23008_I2C::_frame[r][c] - LCD_GLYPH_BASE) {
+					_visible[i] = true;
+				}
+			}
+		}
+	}
+	for (int i=0; i < LCD_CGRAM_SLOTS; i++) {
+		if (_visible[i] == true) {
+			continue;
+		}
+		if (_slot < 0 || LCD_MCP23008_I2C::_slot_used[i] < LCD_MCP23008_I2C::_slot_used[_slot]) {				// free slots have the lowest value
+			_slot = i;
+		}
+	}
+	LCD_MCP23008_I2C::_glyph_misses++;
+	if (_slot < 0) {																							// more than 8 different glyphs visible
+		return -1;
+	}
+	
+	LCD_MCP23008_I2C::Command(LCD_SETCGRAMADDR | (_slot << 3));													// 8 bytes per slot
+	if (LCD_MCP23008_I2C::_batch == true) {
+		LCD_MCP23008_I2C::SendBlock(&LCD_MCP23008_I2C::_glyphs[_glyph*LCD_GLYPH_ROWS], LCD_GLYPH_ROWS, LCD_RW);	// upload the pattern as block write
+	}
+	else {
+		for (int i=0; i < LCD_GLYPH_ROWS; i++) {
+			LCD_MCP23008_I2C::Send(LCD_MCP23008_I2C::_glyphs[_glyph*LCD_GLYPH_ROWS + i], LCD_RW);
+		}
+	}
+	LCD_MCP23008_I2C::_cursor_row = LCD_MAX_ROWS;																// the address counter is in the CGRAM, the next print needs SetCursor
+	LCD_MCP23008_I2C::_slot_glyph[_slot] = _glyph;
+	LCD_MCP23008_I2C::_slot_used[_slot] = ++LCD_MCP23008_I2C::_glyph_clock;
+	return _slot;
+}
+
+int LCD_MCP23008_I2C::Marquee(const char _text[], uint8_t _line, int _delay){
+	LCD_MCP23008_I2C::StopMarquee();
+	if (LCD_MCP23008_I2C::rows > 2 || _line >= LCD_MCP23008_I2C::rows || _delay <= 0) {					// 4 row displays share one DDRAM line between 2 rows
+		return 0;
+	}
+	
+	std::string _ring = _text;
+	if (_ring.size() > LCD_MAX_COLS) {																			// longer than the DDRAM line: gap before the text starts again
+		_ring.append(LCD_MARQUEE_GAP, ' ');
+	}
+	else {
+		_ring.resize(LCD_MAX_COLS, ' ');																		// the DDRAM line is a ring of 40 characters, the rest is the gap
+	}
+	LCD_MCP23008_I2C::_marquee_text = _ring;
+	LCD_MCP23008_I2C::_marquee_line = _line;
+	LCD_MCP23008_I2C::_marquee_period = _delay * 1000;
+	
+	LCD_MCP23008_I2C::Home();																					// no display shift
+	LCD_MCP23008_I2C::SetCursor(_line, 0);
+	LCD_MCP23008_I2C::PrintRaw((const uint8_t *)_ring.c_str(), LCD_MAX_COLS, 0);								// load the whole DDRAM line once
+	LCD_MCP23008_I2C::_marquee_stop = false;
+	LCD_MCP23008_I2C::_marquee = std::thread(&LCD_MCP23008_I2C::MarqueeRun, this);
+	return 1;
+}
+
+void LCD_MCP23008_I2C::StopMarquee(){
+	if (LCD_MCP23008_I2C::_marquee.joinable() == false) {														// no marquee
+		return;
+	}
+	LCD_MCP23008_I2C::_marquee_stop = true;
+	LCD_MCP23008_I2C::_marquee.join();
+	LCD_MCP23008_I2C::Home();																					// set the display shift back, so the framebuffer fits again
+}
+
+void LCD_MCP23008_I2C::MarqueeRun(){
+	int _len = LCD_MCP23008_I2C::_marquee_text.size();
+	int _first = 0;																								// text position of the first visible character
+	uint32_t _next = LCD_MCP23008_I2C::_hal->Tick() + LCD_MCP23008_I2C::_marquee_period;					// tick of the next step
+	
+	while (LCD_MCP23008_I2C::_marquee_stop == false) {
+		int32_t _rest = _next - LCD_MCP23008_I2C::_hal->Tick();
+		if (_rest > 0) {																						// sleep in slices, so stop is seen in time
+			LCD_MCP23008_I2C::_hal->Delay(_rest < LCD_MARQUEE_SLICE ? _rest : LCD_MARQUEE_SLICE);
+			continue;
+		}
+		_next += LCD_MCP23008_I2C::_marquee_period;
+		
+		LCD_MCP23008_I2C::Command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVELEFT);							// one byte per step, the DDRAM stays
+		if (_len > LCD_MAX_COLS) {																				// the column, which went out on the left, comes in on the right after 39 steps:
+			int _col = _first % LCD_MAX_COLS;																	// refill it with the text of then
+			LCD_MCP23008_I2C::SetCursor(LCD_MCP23008_I2C::_marquee_line, _col);
+			LCD_MCP23008_I2C::Send(LCD_MCP23008_I2C::_marquee_text[(_first + LCD_MAX_COLS) % _len], LCD_RW);
+			LCD_MCP23008_I2C::Track(LCD_MCP23008_I2C::_marquee_text[(_first + LCD_MAX_COLS) % _len]);
+		}
+		_first = (_first + 1) % (_len * LCD_MAX_COLS);															// the text and the DDRAM line are at the start again
+	}
+}
+
+void LCD_MCP23008_I2C::ClearFrame(){
+	for (int r=0; r < LCD_MAX_ROWS; r++) {
+		for (int c=0; c < LCD_MAX_COLS; c++) {
+			LCD_MCP23008_I2C::_frame[r][c] = ' ';
+			LCD_MCP23008_I2C::_ddram[r][c] = ' ';
+		}
+	}
+}
+
+void LCD_MCP23008_I2C::BatchMode(bool _on){
+	LCD_MCP23008_I2C::_batch = _on;																				// used by Send and Print
+}
+
+bool LCD_MCP23008_I2C::BusyMode(bool _on){
+	if (_on == true && LCD_MCP23008_I2C::_busymode == false && LCD_MCP23008_I2C::_expander.Scheduled() == false) {		// switch on, scheduled writes use pauses instead of reading the busy flag
+		LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_GPPU, LCD_DATA_PINS);										// pull ups on the data pins: not driven pins read as busy, so busy mode falls back
+		LCD_MCP23008_I2C::_busymode = true;
+		LCD_MCP23008_I2C::WaitReady(0);																			// first read of the busy flag, falls back if it fails
+	}
+	else if (_on == false && LCD_MCP23008_I2C::_busymode == true) {											// switch off
+		LCD_MCP23008_I2C::_busymode = false;
+		LCD_MCP23008_I2C::_expander.WriteRegister(REGISTER_GPPU, MCP23008_GPPU_ALL_DISABLED);						// disable all GPIO-Pins PullUp resistors
+	}
+	return LCD_MCP23008_I2C::_busymode;
+}
+
+unsigned LCD_MCP23008_I2C::Transactions(){
+	return LCD_MCP23008_I2C::_expander.Transactions();
+}
+
+void LCD_MCP23008_I2C::ResetTransactions(){
+	LCD_MCP23008_I2C::_expander.ResetTransactions();															// transactions, suppressed writes and errors
+}
+
+unsigned LCD_MCP23008_I2C::SuppressedWrites(){
+	return LCD_MCP23008_I2C::_expander.SuppressedWrites();
+}
+
+unsigned LCD_MCP23008_I2C::RecoveredErrors(){
+	return LCD_MCP23008_I2C::_expander.RecoveredErrors();
+}
+
+unsigned LCD_MCP23008_I2C::FailedTransfers(){
+	return LCD_MCP23008_I2C::_expander.FailedTransfers();
+}
+
+int LCD_MCP23008_I2C::SyncRegisters(){
+	return LCD_MCP23008_I2C::_expander.SyncRegisters();
+}
+
+void LCD_MCP23008_I2C::Scheduler(BusScheduler *_scheduler, int _priority){
+	LCD_MCP23008_I2C::BusyMode(false);																			// the busy flag would block the caller again
+	LCD_MCP23008_I2C::_expander.Scheduler(_scheduler, _priority);												// leaves the old scheduler after it has sent the queued writes
+}
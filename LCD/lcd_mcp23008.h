@@ -1,4 +1,11 @@
+#pragma once
+#include "../Common/hal.h"												// time of the Raspberry Pi or the simulation
+#include "../MCP23008/mcp23008.h"										// the i/o expander of the LCD
 #include <inttypes.h>													// used for the int types like uint8_t
+#include <vector>														// patterns of the custom characters
+#include <string>														// text of the marquee
+#include <thread>														// timer of the marquee
+#include <atomic>
 
 class LCD_MCP23008_I2C{
 	/* class for an LCD Display with an MCP23008 controler and an I2C comunication. 
@@ -15,8 +22,8 @@ class LCD_MCP23008_I2C{
 	 *     A0-->|    2    |<->GPA4 <---> data bit 1
 	 * ~RESET-->|    3    |<->GPA3 <---> data bit 0
 	 *    ~CS-->|    0    |<->GPA2 ----> Enable bit
-	 *    INT<--|    0    |<->GPA1 ----> R/W bit
-	 *    VSS-->|    8    |<->GPA0 ----> Command / RS bit
+	 *    INT<--|    0    |<->GPA1 ----> Command / RS bit (LCD_RW of the driver = data)
+	 *    VSS-->|    8    |<->GPA0 ----> R/W bit (LCD_READ)
 	 *          '---------'
 	 * 
 	 * Hardware Address Pins(A0-A2)
@@ -32,34 +39,12 @@ class LCD_MCP23008_I2C{
 	 * 
 	 */
 	
-	/* Used by MCP23008 */
-	#define REGISTER_IODIR				0x00								// register for Input / Output direction (0 = output / 1 = input for each pin)
-	#define REGISTER_IOPOL				0x01								// register for Input / Output polarisation (0 = noninverted / 1 = inverted for each pin)
-	#define REGISTER_GPINTEN			0x02
-	#define REGISTER_DEFVAL				0x03
-	#define REGISTER_INTCON				0x04
-	#define REGISTER_IOCON				0x05
-	#define REGISTER_GPPU				0x06								// register for PullUp resistors (0 = disable pullup resistors / 1 = configure internal PullUp resistor for pin)
-	#define REGISTER_INTF				0x07
-	#define REGISTER_INTCAP				0x08
-	#define REGISTER_GPIO				0x09								// register for pin state ( 0 = GPIO-Pin are low / 1 = GPIO-Pin are high)
-	#define REGISTER_OLAT				0x0A
-	#define MCP23008_IODIR_ALL_OUTPUT	0x00
-	#define MCP23008_IODIR_ALL_INPUT	0xFF
-	#define MCP23008_IPOL_ALL_NORMAL    0x00
-	#define MCP23008_IPOL_ALL_INVERTED  0xFF
-	#define MCP23008_GPPU_ALL_DISABLED  0x00
-	#define MCP23008_GPPU_ALL_ENABLED   0xFF
-	#define MCP23008_GPPU_ALL_DISABLED  0x00
-	#define MCP23008_GPPU_ALL_ENABLED   0xFF
-	#define MCP23008_GPIO_ALL_LOW     	0x00
-	#define MCP23008_GPIO_ALL_HIGH    	0xFF
-
 	/* used by the LCD display */
 	#define LCD_EN 						4									// Enable Bit
 	#define LCD_RW 						2									// Read/Write Bit
 	#define LCD_RS 						1									// Register select Bit
 	#define LCD_CMD 					0									// Bit for Commands
+	#define LCD_READ					1									// GPA0: R/W line for reading the busy flag (Print uses GPA1 as data register select)
 
 	#define LCD_CLEARDISPLAY 			0x01								// command "clear display"
 	#define LCD_RETURNHOME 				0x02								// command "return home"
@@ -96,12 +81,28 @@ class LCD_MCP23008_I2C{
 
 	#define LCD_BACKLIGHT 				0x08
 	#define LCD_NOBACKLIGHT 			0x00
+
+	#define LCD_DATA_PINS				0x78								// GPA3 - GPA6: data bits, inputs while the busy flag is read
+	#define LCD_BUSYFLAG				0x40								// GPA6: data bit 3 of the high nibble = busy flag (DB7)
+	#define LCD_BUSY_POLLS				20									// max reads of the busy flag before falling back to the fixed delays
+
+	#define LCD_MAX_ROWS				4									// max rows of the HD44780 (see row offsets in SetCursor)
+	#define LCD_MAX_COLS				40									// max characters of one DDRAM line
+
+	#define LCD_MARQUEE_GAP				4									// spaces between the end and the start of a long marquee text
+	#define LCD_MARQUEE_SLICE			20000								// max µs the marquee timer sleeps, before it checks stop
+
+	#define LCD_CGRAM_SLOTS				8									// custom characters of the HD44780 (5x8 dots), character codes 0 - 7
+	#define LCD_GLYPH_ROWS				8									// bytes of one custom character, the low 5 bits are the dots of a row
+	#define LCD_GLYPH_BASE				0x100								// framebuffer cells >= this value show the custom glyph (cell - LCD_GLYPH_BASE)
+	#define LCD_GLYPH_MISSING			' '									// shown if all CGRAM slots hold visible glyphs
+	#define LCD_DDRAM_UNKNOWN			0xFFFF								// DDRAM cell after a failed write, Flush sends it again
 	
 public:
 	/* public functions for the user */
-	LCD_MCP23008_I2C(int _addr, int rows, int cols);													// constructor --> set variables for the class
+	LCD_MCP23008_I2C(int _addr, int rows, int cols, HAL *_hal=HAL::Default());						// constructor --> set variables for the class, _hal = hardware backend
 	virtual ~LCD_MCP23008_I2C();																		// destructor
-	void Init();																						// initialise the display conection and config
+	int Init();																							// initialise the display conection and config, return 0 = okay, < 0 = error of PiGPIO / i2c
 	void Term();																						// terminate the display
 	void Backlight(bool _on);																			// turn on/off the backlight
 	void Display(bool _on);																				// turn on/off the display
@@ -115,26 +116,66 @@ public:
 	void SetCursor(uint8_t _row, uint8_t _col);															// set cursor to Poition (x,y)
 	void Print(const char _text[], int _delay);															// print an text at current position
 	void PrintLine(const char _text[], uint8_t _line);													// print an text at the given line starts on position 0
+	void BatchMode(bool _on);																			// turn on/off sending whole texts as i2c block writes (on by default)
+	void Write(uint8_t _row, uint8_t _col, const char _text[]);										// write an text into the framebuffer at the given position (no i2c)
+	void WriteLine(const char _text[], uint8_t _line);													// write an text into the framebuffer line and fill the rest with spaces (no i2c)
+	int Flush();																						// send the changed characters of the framebuffer, return the bytes saved against rewriting all lines (CGRAM uploads count as sent) or < 0 = i2c error (the next Flush sends the rest)
+	int DefineGlyph(const uint8_t _pattern[LCD_GLYPH_ROWS]);											// register a custom 5x8 character, return its glyph id (no i2c, the same pattern gets the same id)
+	void WriteGlyph(uint8_t _row, uint8_t _col, int _glyph);											// write a custom character into the framebuffer, Flush uploads it into a CGRAM slot if needed
+	unsigned GlyphHits();																				// count of glyphs found in the CGRAM by Flush
+	unsigned GlyphMisses();																				// count of glyphs uploaded into the CGRAM by Flush
+	int Marquee(const char _text[], uint8_t _line, int _delay);										// scroll _text through the line, one step every _delay msec by a timer, return 1 = started, 0 = not possible
+	void StopMarquee();																					// stop the marquee and set the display shift back
+	bool BusyMode(bool _on);																			// turn on/off waiting by the busy flag instead of fixed delays, return if it is used
+	unsigned Transactions();																			// count of i2c transactions since Init / ResetTransactions
+	void ResetTransactions();																			// set the count of i2c transactions, suppressed writes and errors to 0
+	unsigned SuppressedWrites();																		// count of register writes not sent, because the register has the value already
+	unsigned RecoveredErrors();																			// count of i2c errors, which a retry of the MCP23008 recovered since Init / ResetTransactions
+	unsigned FailedTransfers();																			// count of i2c transfers given up after the retries since Init / ResetTransactions
+	int SyncRegisters();																				// read all MCP23008 registers into the shadow copy, return 0 = okay, < 0 = i2c error
+	void Scheduler(BusScheduler *_scheduler, int _priority=BUS_PRIO_NORMAL);							// queue the i2c writes on the bus scheduler (NULL = send directly), then Print with delay doesn't block
 
 private:
-	/* private functions for the MCP23008 expander */
-	uint8_t MCP23008_reg_read(uint8_t reg);
-	void MCP23008_reg_write(uint8_t reg, uint8_t data);
-
 	/* private functions for the LCD Display */
-	void Send(uint8_t _data, uint8_t _mode);
-	void Send4Bits(uint8_t _data, uint8_t _mode);
+	int Send(uint8_t _data, uint8_t _mode);																// return 0 = okay, < 0 = i2c error
+	int Send4Bits(uint8_t _data, uint8_t _mode);
+	int SendBlock(const uint8_t _data[], int _count, uint8_t _mode);
 	void Command(uint8_t _cmd);
+	int ReadBusy();																						// read the busy flag: 1 = busy, 0 = ready, < 0 = error
+	void WaitReady(int _us);																			// wait till the LCD is ready, by busy flag or _us µs
+	int PrintRaw(const uint8_t _data[], int _count, int _delay);										// print _count characters at current position, return 0 = okay, < 0 = i2c error
+	void Track(uint8_t _char);																			// note a character written into the DDRAM at the cursor
+	int GlyphSlot(int _glyph);																			// CGRAM slot of the glyph, uploaded on a miss (least recently used slot), -1 = all slots visible
+	void ClearFrame();																					// framebuffer and display are empty
+	void MarqueeRun();																					// the timer thread of the marquee
 
 
 	/* private variables for the class */
-	uint8_t addr;
+	HAL *_hal;																							// hardware backend (PiGPIO or simulation)
+	MCP23008 _expander;																					// i2c, shadow registers and scheduling of the MCP23008
 	uint8_t rows;
 	uint8_t cols;
 	uint8_t lines;
-	unsigned _handle;
+	bool _acquired = false;																				// true between Init and Term
 	uint8_t backlightval;
 	uint8_t _displayfunction;
 	uint8_t _displaycontrol;
 	uint8_t _displaymode;
+	uint16_t _frame[LCD_MAX_ROWS][LCD_MAX_COLS];														// framebuffer written by Write / WriteLine / WriteGlyph
+	uint16_t _ddram[LCD_MAX_ROWS][LCD_MAX_COLS];														// what the display shows (written by Print / Flush)
+	uint8_t _cursor_row = 0;																			// cursor position in the DDRAM
+	uint8_t _cursor_col = 0;
+	bool _batch = true;
+	bool _busymode = false;
+	std::vector<uint8_t> _glyphs;																		// patterns of the registered glyphs, LCD_GLYPH_ROWS bytes each
+	int _slot_glyph[LCD_CGRAM_SLOTS];																	// glyph in the CGRAM slot, -1 = unknown
+	uint32_t _slot_used[LCD_CGRAM_SLOTS];																// last use of the slot, the lowest one is replaced
+	uint32_t _glyph_clock = 0;
+	unsigned _glyph_hits = 0;
+	unsigned _glyph_misses = 0;
+	std::thread _marquee;																				// timer thread, joinable while the marquee runs
+	std::atomic<bool> _marquee_stop{false};
+	std::string _marquee_text;																			// text of the marquee, min LCD_MAX_COLS characters
+	uint8_t _marquee_line = 0;
+	uint32_t _marquee_period = 0;																		// µs per step
 };
@@ -0,0 +1,134 @@
+/* Bar graph and sparkline widgets for the LCD Display */
+#include "lcd_widgets.h"																					// own header file
+
+LCD_Bar::LCD_Bar(LCD_MCP23008_I2C &_lcd, uint8_t _row, uint8_t _col, uint8_t _width, float _min, float _max) : _lcd(_lcd){
+	LCD_Bar::_row = _row;
+	LCD_Bar::_col = _col;
+	LCD_Bar::_width = _width;
+	LCD_Bar::_min = _min;
+	LCD_Bar::_max = _max;
+	for (int k=1; k < LCD_BAR_STEPS; k++) {																		// k dot columns from the left
+		uint8_t _pattern[LCD_GLYPH_ROWS];
+		for (int i=0; i < LCD_GLYPH_ROWS; i++) {
+			_pattern[i] = (0x1F << (LCD_BAR_STEPS - k)) & 0x1F;
+		}
+		LCD_Bar::_glyphs[k] = _lcd.DefineGlyph(_pattern);
+	}
+}
+
+void LCD_Bar::Set(float _value){
+	int _steps = LCD_Bar::_width * LCD_BAR_STEPS;
+	int _filled = 0;																							// filled dot columns
+
+	if (LCD_Bar::_max > LCD_Bar::_min) {
+		_filled = (int)((_value - LCD_Bar::_min) / (LCD_Bar::_max - LCD_Bar::_min) * _steps + 0.5f);
+	}
+	if (_filled < 0) {
+		_filled = 0;
+	}
+	if (_filled > _steps) {
+		_filled = _steps;
+	}
+
+	for (int c=0; c < LCD_Bar::_width; c++) {
+		int _dots = _filled - c * LCD_BAR_STEPS;																// dot columns of this character
+		if (_dots >= LCD_BAR_STEPS) {
+			LCD_Bar::_lcd.Write(LCD_Bar::_row, LCD_Bar::_col + c, LCD_WIDGET_FULL);
+		}
+		else if (_dots > 0) {
+			LCD_Bar::_lcd.WriteGlyph(LCD_Bar::_row, LCD_Bar::_col + c, LCD_Bar::_glyphs[_dots]);
+		}
+		else {
+			LCD_Bar::_lcd.Write(LCD_Bar::_row, LCD_Bar::_col + c, " ");
+		}
+	}
+}
+
+LCD_Sparkline::LCD_Sparkline(LCD_MCP23008_I2C &_lcd, uint8_t _row, uint8_t _col, uint8_t _width, uint8_t _height, float _min, float _max, int _mode) : _lcd(_lcd){
+	LCD_Sparkline::_row = _row;
+	LCD_Sparkline::_col = _col;
+	LCD_Sparkline::_width = _width;
+	LCD_Sparkline::_height = _height;
+	if (_height < 1) {
+		LCD_Sparkline::_height = 1;
+	}
+	if (_height > LCD_MAX_ROWS) {
+		LCD_Sparkline::_height = LCD_MAX_ROWS;
+	}
+	LCD_Sparkline::_min = _min;
+	LCD_Sparkline::_max = _max;
+	LCD_Sparkline::_mode = _mode;
+	LCD_Sparkline::_levels.assign(_width, 0);
+	for (int k=1; k < LCD_SPARK_STEPS; k++) {																	// k dot rows from the bottom
+		uint8_t _pattern[LCD_GLYPH_ROWS];
+		for (int i=0; i < LCD_GLYPH_ROWS; i++) {
+			_pattern[i] = (i >= LCD_GLYPH_ROWS - k) ? 0x1F : 0x00;
+		}
+		LCD_Sparkline::_glyphs[k] = _lcd.DefineGlyph(_pattern);
+	}
+}
+
+void LCD_Sparkline::Add(float _value){
+	if (LCD_Sparkline::_width == 0) {
+		return;
+	}
+	if (LCD_Sparkline::_mode == LCD_SPARK_SWEEP) {
+		LCD_Sparkline::_levels[LCD_Sparkline::_next] = LCD_Sparkline::Level(_value);
+		LCD_Sparkline::Draw(LCD_Sparkline::_next);
+		LCD_Sparkline::_next = (LCD_Sparkline::_next + 1) % LCD_Sparkline::_width;
+		if (LCD_Sparkline::_width > 1) {
+			LCD_Sparkline::_levels[LCD_Sparkline::_next] = 0;													// gap in front of the newest sample
+			LCD_Sparkline::Draw(LCD_Sparkline::_next);
+		}
+		return;
+	}
+
+	LCD_Sparkline::_levels.erase(LCD_Sparkline::_levels.begin());											// the oldest sample goes out on the left
+	LCD_Sparkline::_levels.push_back(LCD_Sparkline::Level(_value));
+	for (int c=0; c < LCD_Sparkline::_width; c++) {															// the framebuffer decides, what is sent
+		LCD_Sparkline::Draw(c);
+	}
+}
+
+void LCD_Sparkline::Clear(){
+	LCD_Sparkline::_levels.assign(LCD_Sparkline::_width, 0);
+	LCD_Sparkline::_next = 0;
+	for (int c=0; c < LCD_Sparkline::_width; c++) {
+		LCD_Sparkline::Draw(c);
+	}
+}
+
+void LCD_Sparkline::Draw(int _column){
+	int _level = LCD_Sparkline::_levels[_column];
+
+	for (int r=0; r < LCD_Sparkline::_height; r++) {
+		int _dots = _level - (LCD_Sparkline::_height - 1 - r) * LCD_SPARK_STEPS;								// dot rows of this character, the bottom row first
+		uint8_t _row = LCD_Sparkline::_row + r;
+		uint8_t _col = LCD_Sparkline::_col + _column;
+		if (_dots >= LCD_SPARK_STEPS) {
+			LCD_Sparkline::_lcd.Write(_row, _col, LCD_WIDGET_FULL);
+		}
+		else if (_dots > 0) {
+			LCD_Sparkline::_lcd.WriteGlyph(_row, _col, LCD_Sparkline::_glyphs[_dots]);
+		}
+		else {
+			LCD_Sparkline::_lcd.Write(_row, _col, " ");
+		}
+	}
+}
+
+int LCD_Sparkline::Level(float _value){
+	int _steps = LCD_Sparkline::_height * LCD_SPARK_STEPS;
+	int _level = 1;																								// the minimum is one dot row, so every sample is visible
+
+	if (LCD_Sparkline::_max > LCD_Sparkline::_min) {
+		_level = 1 + (int)((_value - LCD_Sparkline::_min) / (LCD_Sparkline::_max - LCD_Sparkline::_min) * (_steps - 1) + 0.5f);
+	}
+	if (_level < 1) {
+		_level = 1;
+	}
+	if (_level > _steps) {
+		_level = _steps;
+	}
+	return _level;
+}
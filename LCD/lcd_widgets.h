@@ -0,0 +1,78 @@
+#pragma once
+#include "lcd_mcp23008.h"												// the widgets draw into the framebuffer of the LCD
+#include <inttypes.h>													// needed for using int types like uint8_t
+#include <vector>
+
+#define LCD_WIDGET_FULL				"\xFF"									// full block of the HD44780 character ROM (as text for Write), needs no CGRAM slot
+#define LCD_BAR_STEPS				5										// dot columns of one character
+#define LCD_SPARK_STEPS				8										// dot rows of one character
+#define LCD_SPARK_SCROLL			0										// mode of LCD_Sparkline: the samples move to the left
+#define LCD_SPARK_SWEEP				1										// mode of LCD_Sparkline: the new sample replaces the oldest in place
+
+class LCD_Bar {
+	/* horizontal bar graph of _width characters with a resolution of 5 dots per character.
+	 * The partly filled character is one of 4 custom glyphs, full characters are the ROM block,
+	 * so the bar needs max 4 CGRAM slots.
+	 *
+	 * Set only writes into the framebuffer, LCD_MCP23008_I2C::Flush sends the changed characters
+	 * (so more widgets can be drawn and sent with one Flush).
+	 *
+	*/
+	public:
+		LCD_Bar(LCD_MCP23008_I2C &_lcd, uint8_t _row, uint8_t _col, uint8_t _width, float _min, float _max);
+		/* constructor of this class, the bar is at _row / _col and shows _min (empty) - _max (full)
+		*/
+		void Set(float _value);
+		/* This function draws the bar of _value, values outside _min - _max are shown as empty / full bar
+		*/
+
+	private:
+		LCD_MCP23008_I2C &_lcd;
+		uint8_t _row;
+		uint8_t _col;
+		uint8_t _width;
+		float _min;
+		float _max;
+		int _glyphs[LCD_BAR_STEPS];										// glyph of 1 - 4 filled dot columns (index 0 isn't used)
+};
+
+class LCD_Sparkline {
+	/* vertical sparkline: one sample per character column, _height rows of 8 dots each.
+	 * The columns are custom glyphs of 1 - 7 filled dot rows (7 CGRAM slots) or the ROM block.
+	 *
+	 * LCD_SPARK_SCROLL: the new sample comes in on the right, the others move to the left.
+	 *                   Flush sends only the characters, whose level differs from the left neighbour,
+	 *                   so slow changing values (temperature) cost a few bytes.
+	 * LCD_SPARK_SWEEP:  the new sample replaces the oldest one in place, a blank column in front of it
+	 *                   marks the position. A sample costs max 2 columns and one cursor move.
+	 *
+	 * Add only writes into the framebuffer, LCD_MCP23008_I2C::Flush sends the changed characters.
+	 *
+	*/
+	public:
+		LCD_Sparkline(LCD_MCP23008_I2C &_lcd, uint8_t _row, uint8_t _col, uint8_t _width, uint8_t _height, float _min, float _max, int _mode=LCD_SPARK_SCROLL);
+		/* constructor of this class, the sparkline starts at _row / _col (top left), _height = 1 - LCD_MAX_ROWS rows
+		*/
+		void Add(float _value);
+		/* This function appends a sample and draws the changed columns
+		*/
+		void Clear();
+		/* This function removes all samples
+		*/
+
+	private:
+		void Draw(int _column);											// draw one column of _levels
+		int Level(float _value);										// dot rows of the value: 1 - _height * 8
+
+		LCD_MCP23008_I2C &_lcd;
+		uint8_t _row;
+		uint8_t _col;
+		uint8_t _width;
+		uint8_t _height;
+		float _min;
+		float _max;
+		int _mode;
+		std::vector<uint8_t> _levels;									// dot rows of every column, 0 = no sample
+		int _next = 0;													// column of the next sample in sweep mode
+		int _glyphs[LCD_SPARK_STEPS];									// glyph of 1 - 7 filled dot rows (index 0 isn't used)
+};
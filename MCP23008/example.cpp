@@ -0,0 +1,38 @@
+/* example for the MCP23008 i/o expander: 4 buttons on GPA0 - GPA3, 4 LEDs / relays on GPA4 - GPA7
+ * INT of the MCP23008 is wired to GPIO 17 of the Raspberry Pi
+ *
+ * commands:
+ * compile: g++ -Wall -c mcp23008.cpp "%f"
+ * build: g++ -Wall -o "%e" mcp23008.cpp ../Common/hal_pigpio.cpp ../Common/pi_context.cpp ../Common/bus_trace.cpp ../Common/bus_scheduler.cpp "%f" -lpigpio -pthread
+*/
+
+#include "mcp23008.h"													// include the driver
+#include <unistd.h>														// for sleep
+#include <stdio.h>														// for printf
+
+MCP23008 Buttons(0x22);
+
+void pressed(uint8_t _flags, uint8_t _levels, void *_userdata){
+	/* called by the interrupt: the buttons pull the pins low */
+	for (int i = 0; i < 4; i++){
+		if (_flags & (1 << i)){
+			printf("button %d %s\n", i, (_levels & (1 << i)) ? "released" : "pressed");
+			Buttons.WritePin(4 + i, !(_levels & (1 << i)));				// LED on while the button is pressed
+		}
+	}
+}
+
+int main(){
+	if (Buttons.Init() < 0){											// no PiGPIO or no MCP23008 on the i2c
+		return 1;
+	}
+	Buttons.Direction(0x0F);											// GPA0 - GPA3 inputs, GPA4 - GPA7 outputs
+	Buttons.PullUp(0x0F);
+	Buttons.Write(0x00);
+	Buttons.Interrupt(0x0F, 17, pressed, NULL);							// no polling: the INT line tells us about changes
+
+	sleep(30);
+
+	printf("%u interrupts, %u i2c transactions\n", Buttons.Interrupts(), Buttons.Transactions());
+	Buttons.Term();
+}
@@ -0,0 +1,416 @@
+/* MCP23008 i/o expander with I2C */
+#include "mcp23008.h"																							// own header file
+#include <stdio.h>																								// for printf
+
+MCP23008::MCP23008(int _addr, HAL *_hal){
+	MCP23008::_hal = _hal;																						// i2c and time by this backend
+	MCP23008::addr = _addr;
+}
+
+MCP23008::~MCP23008(){
+	MCP23008::Term();																							// release i2c and PiGPIO if Term was not called
+}
+
+int MCP23008::Init(){
+	if (MCP23008::_acquired == true){																			// Init was called before
+		MCP23008::Term();
+	}
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+	int _status = MCP23008::_hal->Init();
+	if (_status < 0){																							// if initialisation of pigpio failed
+		printf("##############################################\n");
+		printf("#              Can't use PIGPIO!             #\n");
+		printf("# Maybe PIGPIO is used by an other instance? #\n");
+		printf("##############################################\n");
+		return _status;																							// the caller decides, if the program ends
+	}
+	for (int _try = 0; _try < HAL_I2C_RETRIES; _try++){														// try to open i2c (shared with other drivers of this address)
+		if (_try > 0){
+			MCP23008::_hal->Delay(HAL_I2C_RETRY_US);
+		}
+		if ((_status=MCP23008::_handle=MCP23008::_hal->I2C_Open(1,MCP23008::addr)) >= 0){
+			MCP23008::_generation = MCP23008::_hal->I2C_Generation(MCP23008::_handle);
+			break;
+		}
+	}
+	if (_status < 0){
+		printf("##############################################\n");
+		printf("#               Can't open I2C!              #\n");
+		printf("# Maybe device is used by an other instance? #\n");
+		printf("##############################################\n");
+		MCP23008::_hal->Term();																					// release pigpio again
+		return _status;
+	}
+	MCP23008::_acquired = true;
+	MCP23008::_shadow_valid = 0;																				// the chip state is unknown (power up, other program)
+	uint8_t _iocon = MCP23008_IOCON_SEQOP;																		// no address increment: block and merged writes stay on one register
+	_status = MCP23008::Transfer(BUS_TRACE_WRITE, REGISTER_IOCON, &_iocon, 1);									// directly, before the writes are queued
+	MCP23008::_transactions++;
+	if (_status < 0){																							// no answer even after the retries: no chip on this address
+		MCP23008::Term();
+		return _status;
+	}
+	MCP23008::_shadow[REGISTER_IOCON] = _iocon;
+	MCP23008::_shadow_valid |= 1 << REGISTER_IOCON;
+	if (MCP23008::_scheduler != NULL) {																			// queue all writes from now on
+		MCP23008::_scheduler->Attach(MCP23008::_handle, MCP23008::addr, BUS_MERGE_SAME);
+		MCP23008::_scheduled_errors = 0;
+		MCP23008::_scheduled_recovered = 0;
+	}
+	return 0;
+}
+
+void MCP23008::Term(){
+	if (MCP23008::_acquired == false){																			// nothing to close
+		return;
+	}
+	MCP23008::Interrupt(0, 0, NULL, NULL);																		// no alerts on the closed handle
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+	MCP23008::_acquired = false;
+	if (MCP23008::_scheduler != NULL) {																			// send the queued writes first
+		MCP23008::_handle = MCP23008::_scheduler->Detach(MCP23008::_handle);									// the bus thread may have opened it again
+	}
+	MCP23008::_hal->I2C_Close(MCP23008::_handle);																// close i2c connection
+	MCP23008::_hal->Term();																						// terminate pigpio, if no other driver uses it
+}
+
+int MCP23008::Direction(uint8_t _inputs){
+	return MCP23008::WriteRegister(REGISTER_IODIR, _inputs);
+}
+
+int MCP23008::PullUp(uint8_t _pins){
+	return MCP23008::WriteRegister(REGISTER_GPPU, _pins);
+}
+
+int MCP23008::Polarity(uint8_t _inverted){
+	return MCP23008::WriteRegister(REGISTER_IOPOL, _inverted);
+}
+
+int MCP23008::Read(){
+	return MCP23008::ReadRegister(REGISTER_GPIO);																// inputs are never cached
+}
+
+int MCP23008::ReadPin(uint8_t _pin){
+	int _levels = MCP23008::Read();
+	if (_levels < 0) {																							// i2c read failed
+		return _levels;
+	}
+	return (_levels >> (_pin & 0x07)) & 1;
+}
+
+int MCP23008::Write(uint8_t _levels){
+	return MCP23008::WriteRegister(REGISTER_GPIO, _levels);
+}
+
+int MCP23008::WritePin(uint8_t _pin, bool _high){
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+	int _latch = MCP23008::ReadRegister(REGISTER_OLAT);														// from the shadow copy, if it is known
+	if (_latch < 0) {
+		return _latch;
+	}
+	if (_high == true) {
+		_latch |= 1 << (_pin & 0x07);
+	}
+	else {
+		_latch &= ~(1 << (_pin & 0x07));
+	}
+	return MCP23008::WriteRegister(REGISTER_GPIO, _latch);
+}
+
+int MCP23008::WriteBlock(const uint8_t _levels[], int _count){
+	return MCP23008::WriteRegisterBlock(REGISTER_GPIO, _levels, _count);
+}
+
+int MCP23008::Interrupt(uint8_t _pins, unsigned _gpio, MCP23008_callback _func, void *_userdata, uint8_t _compare, uint8_t _defval){
+	if (MCP23008::_int_gpio >= 0) {																				// stop the interrupt of before
+		MCP23008::_hal->GPIO_Alert(MCP23008::_int_gpio, NULL, NULL);
+		MCP23008::_int_gpio = -1;
+		{
+			std::lock_guard<std::mutex> _lock(MCP23008::_int_lock);
+			MCP23008::_int_stop = true;
+		}
+		MCP23008::_int_wake.notify_all();
+		MCP23008::_int_thread.join();																			// a running callback ends first
+		MCP23008::WriteRegister(REGISTER_GPINTEN, 0x00);
+	}
+	MCP23008::_func = _func;
+	MCP23008::_userdata = _userdata;
+	if (_func == NULL) {
+		return 0;
+	}
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+
+	int _iocon = MCP23008::ReadRegister(REGISTER_IOCON);
+	if (_iocon < 0) {
+		return _iocon;
+	}
+	MCP23008::WriteRegister(REGISTER_IOCON, (_iocon & ~(MCP23008_IOCON_ODR | MCP23008_IOCON_INTPOL)) | MCP23008_IOCON_SEQOP);	// INT: push pull, active low, SEQOP stays
+	MCP23008::WriteRegister(REGISTER_DEFVAL, _defval);
+	MCP23008::WriteRegister(REGISTER_INTCON, _compare);
+	if (MCP23008::_hal->GPIO_Mode(_gpio, HAL_INPUT) < 0 || MCP23008::_hal->GPIO_Pull(_gpio, HAL_PUD_UP) < 0) {
+		return -1;
+	}
+	MCP23008::ReadRegister(REGISTER_INTCAP);																	// clear an old interrupt, so INT is high
+	MCP23008::_int_edge = false;
+	MCP23008::_int_stop = false;
+	if (MCP23008::_hal->GPIO_Alert(_gpio, MCP23008::Alert, this) < 0) {
+		return -1;
+	}
+	MCP23008::_int_gpio = _gpio;
+	MCP23008::_int_thread = std::thread(&MCP23008::Worker, this);												// an edge before finds _int_edge
+	MCP23008::WriteRegister(REGISTER_GPINTEN, _pins);															// last: an interrupt finds the alert
+	return 0;
+}
+
+unsigned MCP23008::Interrupts(){
+	return MCP23008::_interrupts;
+}
+
+void MCP23008::Alert(int _gpio, int _level, uint32_t _tick, void *_userdata){
+	MCP23008 *_self = (MCP23008 *)_userdata;
+
+	if (_level != HAL_LOW) {																					// only the falling edge: INT got active
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> _lock(_self->_int_lock);
+		_self->_int_edge = true;
+	}
+	_self->_int_wake.notify_all();																				// no i2c on the alert thread
+}
+
+void MCP23008::Worker(){
+	std::unique_lock<std::mutex> _lock(MCP23008::_int_lock);
+
+	while (true) {
+		MCP23008::_int_wake.wait(_lock, [this]{ return MCP23008::_int_edge || MCP23008::_int_stop; });
+		if (MCP23008::_int_stop == true) {
+			break;
+		}
+		MCP23008::_int_edge = false;
+		_lock.unlock();
+
+		int _flags, _levels;
+		{
+			std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+			_flags = MCP23008::ReadRegister(REGISTER_INTF);														// the pins, which caused it
+			_levels = MCP23008::ReadRegister(REGISTER_INTCAP);													// the levels then, INT goes high again
+		}
+		if (_flags > 0 && _levels >= 0) {																		// else read failed or no interrupt of this chip
+			MCP23008::_interrupts++;
+			MCP23008::_func(_flags, _levels, MCP23008::_userdata);												// without the lock: it may use the driver
+		}
+		_lock.lock();
+	}
+}
+
+int MCP23008::ReadRegister(uint8_t _reg, bool _cached){
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+	int reg_data;
+	MCP23008::Collect();
+	bool _output = _reg < MCP23008_REGISTERS && _reg != REGISTER_GPIO && _reg != REGISTER_INTF && _reg != REGISTER_INTCAP;	// registers, which only change by writes
+	if (_cached == true && _output == true && (MCP23008::_shadow_valid & (1 << _reg))) {						// known: no i2c
+		return MCP23008::_shadow[_reg];
+	}
+	if (MCP23008::_scheduler != NULL) {																			// scheduled: read after the queued writes
+		reg_data=MCP23008::_scheduler->Read(MCP23008::_handle, _reg);
+	}
+	else {
+		reg_data=MCP23008::Transfer(BUS_TRACE_READ, _reg, NULL, 1);											// read data of given register
+	}
+	MCP23008::_transactions++;
+	if (_output == true && reg_data >= 0) {
+		MCP23008::_shadow[_reg] = reg_data;
+		MCP23008::_shadow_valid |= 1 << _reg;
+	}
+	return reg_data;																							// return data
+}
+
+int MCP23008::WriteRegister(uint8_t _reg, uint8_t _data){
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+	MCP23008::Collect();																						// a lost queued write makes the shadow copy unknown
+	if (_reg == REGISTER_IOCON) {																				// block and merged writes need SEQOP, else they run into IODIR / IPOL
+		_data |= MCP23008_IOCON_SEQOP;
+	}
+	uint8_t _latch = (_reg == REGISTER_GPIO) ? REGISTER_OLAT : _reg;											// a GPIO write sets the output latch
+	if (_latch < MCP23008_REGISTERS && (MCP23008::_shadow_valid & (1 << _latch)) && MCP23008::_shadow[_latch] == _data) {
+		MCP23008::_suppressed++;																				// the register has this value already
+		return 0;
+	}
+	if (_latch < MCP23008_REGISTERS) {
+		MCP23008::_shadow[_latch] = _data;
+		MCP23008::_shadow_valid |= 1 << _latch;
+	}
+	int _status = 0;
+	if (MCP23008::_scheduler != NULL) {																			// scheduled: queue it, the bus thread merges back-to-back GPIO writes
+		MCP23008::_scheduler->Write(MCP23008::_handle, _reg, &_data, 1, MCP23008::_priority);
+	}
+	else {
+		_status = MCP23008::Transfer(BUS_TRACE_WRITE, _reg, &_data, 1);										// write data to given MCP register
+	}
+	MCP23008::_transactions++;
+	if (_status < 0 && _latch < MCP23008_REGISTERS) {															// the register value is unknown now
+		MCP23008::_shadow_valid &= ~(1 << _latch);
+	}
+	return _status;
+}
+
+int MCP23008::WriteRegisterBlock(uint8_t _reg, const uint8_t _data[], int _count){
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+	MCP23008::Collect();
+	uint8_t _latch = (_reg == REGISTER_GPIO) ? REGISTER_OLAT : _reg;											// IOCON SEQOP: all bytes go to the same register
+	if (_count <= 0 || _latch >= MCP23008_REGISTERS) {
+		return 0;
+	}
+	if (MCP23008::_shadow_valid & (1 << _latch)) {
+		int i = 0;
+		while (i < _count && _data[i] == MCP23008::_shadow[_latch]) {
+			i++;
+		}
+		if (i == _count) {																						// no byte changes the register
+			MCP23008::_suppressed++;
+			return 0;
+		}
+	}
+	MCP23008::_shadow[_latch] = _data[_count-1];																// the register keeps the last byte
+	MCP23008::_shadow_valid |= 1 << _latch;
+	int _status = 0;
+	if (MCP23008::_scheduler != NULL) {																			// scheduled: queue it
+		MCP23008::_scheduler->Write(MCP23008::_handle, _reg, _data, _count, MCP23008::_priority);
+	}
+	else {
+		_status = MCP23008::Transfer(BUS_TRACE_BLOCK, _reg, _data, _count);									// write all data bytes in one transaction
+	}
+	MCP23008::_transactions++;
+	if (_status < 0) {
+		MCP23008::_shadow_valid &= ~(1 << _latch);
+	}
+	return _status;
+}
+
+int MCP23008::SyncRegisters(){
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+	MCP23008::_shadow_valid = 0;																				// the chip may have been changed by an other program or a reset
+	for (uint8_t reg = 0; reg < MCP23008_REGISTERS; reg++) {													// IOCON SEQOP: no address increment, one read per register
+		int _value = MCP23008::ReadRegister(reg, false);
+		if (_value < 0) {
+			MCP23008::_shadow_valid = 0;																		// unknown again, the next writes are sent
+			return _value;
+		}
+		MCP23008::_shadow[reg] = _value;
+		MCP23008::_shadow_valid |= 1 << reg;
+	}
+	return 0;
+}
+
+unsigned MCP23008::Transactions(){
+	return MCP23008::_transactions;																				// counted by ReadRegister / WriteRegister / WriteRegisterBlock
+}
+
+unsigned MCP23008::SuppressedWrites(){
+	return MCP23008::_suppressed;
+}
+
+unsigned MCP23008::RecoveredErrors(){
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+	MCP23008::Collect();
+	return MCP23008::_recovered;
+}
+
+unsigned MCP23008::FailedTransfers(){
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+	MCP23008::Collect();
+	return MCP23008::_failed;
+}
+
+void MCP23008::ResetTransactions(){
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+	MCP23008::Collect();																						// errors of the bus thread before now are reset too
+	MCP23008::_transactions = 0;
+	MCP23008::_suppressed = 0;
+	MCP23008::_recovered = 0;
+	MCP23008::_failed = 0;
+}
+
+int MCP23008::Transfer(uint8_t _op, uint8_t _reg, const uint8_t _data[], int _count){
+	int _status = -1;
+	if (MCP23008::_acquired == false){																			// i2c isn't open
+		return _status;
+	}
+	for (int _try = 0; _try < HAL_I2C_RETRIES; _try++){
+		if (_try > 0){																							// bus glitch: wait and open the device again
+			MCP23008::_hal->Delay(HAL_I2C_RETRY_US);
+			int _handle = MCP23008::_hal->I2C_Reopen(MCP23008::_handle, 1, MCP23008::addr, MCP23008::_generation);
+			if (_handle >= 0) {
+				MCP23008::_handle = _handle;
+			}
+		}
+		uint32_t _start = BusTrace::Enabled() ? MCP23008::_hal->Tick() : 0;
+		if (_op == BUS_TRACE_READ) {
+			_status = MCP23008::_hal->I2C_ReadByteData(MCP23008::_handle, _reg);
+		}
+		else if (_op == BUS_TRACE_WRITE) {
+			_status = MCP23008::_hal->I2C_WriteByteData(MCP23008::_handle, _reg, _data[0]);
+		}
+		else {
+			_status = MCP23008::_hal->I2C_WriteBlockData(MCP23008::_handle, _reg, _data, _count);
+		}
+		if (BusTrace::Enabled()) {																				// tracing: measure the transaction
+			BusTrace::Record(MCP23008::addr, _op, _count + 1, _status, _start, MCP23008::_hal->Tick());
+		}
+		if (_status >= 0) {
+			if (_try > 0) {
+				MCP23008::_recovered++;
+			}
+			return _status;
+		}
+	}
+	MCP23008::_failed++;																						// given up, the caller gets the error
+	return _status;
+}
+
+
+void MCP23008::Scheduler(BusScheduler *_scheduler, int _priority){
+	std::lock_guard<std::recursive_mutex> _regs(MCP23008::_lock);
+	if (MCP23008::_acquired == true && MCP23008::_scheduler != NULL) {											// leave the old scheduler, after it has sent the queued writes
+		MCP23008::Collect();
+		MCP23008::_handle = MCP23008::_scheduler->Detach(MCP23008::_handle);
+	}
+	MCP23008::_scheduler = _scheduler;
+	MCP23008::_priority = _priority;
+	if (MCP23008::_acquired == true && _scheduler != NULL) {													// else Init attaches the device
+		_scheduler->Attach(MCP23008::_handle, MCP23008::addr, BUS_MERGE_SAME);
+		MCP23008::_scheduled_errors = _scheduler->Errors(MCP23008::_handle);
+		MCP23008::_scheduled_recovered = _scheduler->Recovered(MCP23008::_handle);
+	}
+}
+
+void MCP23008::Pause(uint32_t _us){
+	std::unique_lock<std::recursive_mutex> _regs(MCP23008::_lock);
+	if (MCP23008::_scheduler != NULL) {																			// the scheduler sends the other devices meanwhile
+		MCP23008::_scheduler->Pause(MCP23008::_handle, _us);
+	}
+	else {
+		_regs.unlock();																							// the interrupt thread may use the bus meanwhile
+		MCP23008::_hal->Delay(_us);
+	}
+}
+
+bool MCP23008::Scheduled(){
+	return MCP23008::_scheduler != NULL;
+}
+
+void MCP23008::Collect(){
+	if (MCP23008::_acquired == false || MCP23008::_scheduler == NULL) {
+		return;
+	}
+	unsigned _errors = MCP23008::_scheduler->Errors(MCP23008::_handle);											// queued writes, which failed on the bus thread
+	if (_errors != MCP23008::_scheduled_errors) {
+		MCP23008::_failed += _errors - MCP23008::_scheduled_errors;
+		MCP23008::_scheduled_errors = _errors;
+		MCP23008::_shadow_valid = 0;																			// which registers got the lost values isn't known: send all again
+	}
+	unsigned _recovered = MCP23008::_scheduler->Recovered(MCP23008::_handle);									// retries of the bus thread
+	MCP23008::_recovered += _recovered - MCP23008::_scheduled_recovered;
+	MCP23008::_scheduled_recovered = _recovered;
+}
\ No newline at end of file
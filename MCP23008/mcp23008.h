@@ -0,0 +1,152 @@
+#pragma once
+#include "../Common/hal.h"												// i2c, GPIO alerts and time of the Raspberry Pi or the simulation
+#include "../Common/bus_trace.h"										// optional tracing of the i2c transactions
+#include "../Common/bus_scheduler.h"									// optional queuing of the i2c writes
+#include <inttypes.h>													// used for the int types like uint8_t
+#include <atomic>														// counters used by the interrupt thread too
+#include <thread>														// interrupt thread
+#include <mutex>
+#include <condition_variable>
+
+typedef void (*MCP23008_callback)(uint8_t _flags, uint8_t _levels, void *_userdata);	// called on an interrupt: pins which caused it (INTF) and the pin levels at the interrupt (INTCAP)
+
+class MCP23008 {
+	/* class for the MCP23008 8 bit i/o expander with an I2C comunication.
+	 * It is used by the LCD driver and for other boards with buttons or relays.
+	 *
+	 * 			The MCP23008:
+	 *          .---   ---.
+	 *    SCK-->|1  \_/ 18|<--VDD
+	 *     SI-->|    M    |<->GPA7
+	 *     SO<--|    C    |<->GPA6
+	 *     A1-->|    P    |<->GPA5
+	 *     A0-->|    2    |<->GPA4
+	 * ~RESET-->|    3    |<->GPA3
+	 *    ~CS-->|    0    |<->GPA2
+	 *    INT<--|    0    |<->GPA1
+	 *    VSS-->|    8    |<->GPA0
+	 *          '---------'
+	 *
+	 * Hardware Address Pins(A0-A2): 0x20 (all GND) - 0x27 (all VCC)
+	 *
+	 * The driver keeps a shadow copy of the 11 registers. A write with the value the register
+	 * has already is not sent, reads of registers, which only change by writes, come from the copy.
+	 *
+	 * Init sets IOCON SEQOP (no address increment) and it stays set, so block writes and the
+	 * writes merged by the bus scheduler (BUS_MERGE_SAME) repeat the same register.
+	 *
+	 * A failed transfer (bus glitch) is tried again up to HAL_I2C_RETRIES times, the i2c
+	 * handle is opened again before each retry (by the bus thread, if the writes are queued
+	 * on a scheduler). Init and the direct writes return the status. A queued write, which
+	 * failed on the bus thread, is counted as failed transfer and makes the whole shadow
+	 * copy unknown, so the next writes are sent again.
+	 *
+	 * Inputs don't need polling: with Interrupt() the INT output is wired to a GPIO of the Pi.
+	 * On its falling edge the interrupt thread of the driver reads INTF and INTCAP (this
+	 * clears the interrupt) and calls the callback. The alert thread of PiGPIO only wakes it.
+	 * The registers and the shadow copy are guarded, so the driver may be used by the
+	 * callback and other threads at the same time.
+	 *
+	*/
+
+	#define REGISTER_IODIR				0x00								// register for Input / Output direction (0 = output / 1 = input for each pin)
+	#define REGISTER_IOPOL				0x01								// register for Input / Output polarisation (0 = noninverted / 1 = inverted for each pin)
+	#define REGISTER_GPINTEN			0x02								// register for interrupt on change (1 = enabled for the pin)
+	#define REGISTER_DEFVAL				0x03								// register for the compare value of the interrupt (INTCON = 1)
+	#define REGISTER_INTCON				0x04								// register for the interrupt compare (0 = with the last level / 1 = with DEFVAL)
+	#define REGISTER_IOCON				0x05
+	#define REGISTER_GPPU				0x06								// register for PullUp resistors (0 = disable pullup resistors / 1 = configure internal PullUp resistor for pin)
+	#define REGISTER_INTF				0x07								// register of the pins, which caused the interrupt
+	#define REGISTER_INTCAP				0x08								// register of the pin levels at the interrupt, reading it clears the interrupt
+	#define REGISTER_GPIO				0x09								// register for pin state ( 0 = GPIO-Pin are low / 1 = GPIO-Pin are high)
+	#define REGISTER_OLAT				0x0A
+	#define MCP23008_IODIR_ALL_OUTPUT	0x00
+	#define MCP23008_IODIR_ALL_INPUT	0xFF
+	#define MCP23008_IPOL_ALL_NORMAL    0x00
+	#define MCP23008_IPOL_ALL_INVERTED  0xFF
+	#define MCP23008_GPPU_ALL_DISABLED  0x00
+	#define MCP23008_GPPU_ALL_ENABLED   0xFF
+	#define MCP23008_GPIO_ALL_LOW     	0x00
+	#define MCP23008_GPIO_ALL_HIGH    	0xFF
+	#define MCP23008_IOCON_SEQOP		0x20								// IOCON bit: sequential operation disabled, block writes stay on the same register
+	#define MCP23008_IOCON_ODR			0x04								// IOCON bit: INT is an open drain output
+	#define MCP23008_IOCON_INTPOL		0x02								// IOCON bit: INT is active high
+	#define MCP23008_BLOCK_MAX			32									// max bytes of one i2c block write (PiGPIO)
+	#define MCP23008_REGISTERS			11									// REGISTER_IODIR - REGISTER_OLAT
+
+public:
+	MCP23008(int _addr, HAL *_hal=HAL::Default());														// constructor --> set variables for the class, _hal = hardware backend
+	virtual ~MCP23008();																				// destructor
+	int Init();																							// open the i2c connection and set IOCON SEQOP (the other registers aren't changed), return 0 = okay, < 0 = error of PiGPIO / i2c
+	void Term();																						// stop the interrupt and close the i2c connection
+
+	/* pins */
+	int Direction(uint8_t _inputs);																		// set the pins of _inputs as input, all other as output
+	int PullUp(uint8_t _pins);																			// turn on the pull up resistors of _pins, off for all other
+	int Polarity(uint8_t _inverted);																	// read the pins of _inverted inverted
+	int Read();																							// return the levels of all pins or < 0 on error
+	int ReadPin(uint8_t _pin);																			// return the level of the pin 0 - 7 or < 0 on error
+	int Write(uint8_t _levels);																			// set the levels of all output pins, return 0 = okay, < 0 = i2c error
+	int WritePin(uint8_t _pin, bool _high);																// set the level of one output pin, the others stay
+	int WriteBlock(const uint8_t _levels[], int _count);												// set the output pins _count times in one i2c transfer (IOCON SEQOP by Init)
+
+	/* interrupt on change */
+	int Interrupt(uint8_t _pins, unsigned _gpio, MCP23008_callback _func, void *_userdata, uint8_t _compare=0x00, uint8_t _defval=0x00);
+	/* call _func, if an input of _pins changes. INT (active low) is wired to the Pi _gpio.
+	 * The pins of _compare cause the interrupt while they differ from _defval,
+	 * the other pins on every change. _func = NULL stops the interrupt.
+	 *
+	 * return 0 = okay
+	 *      < 0 = GPIO of the Pi can't be used
+	 *
+	*/
+	unsigned Interrupts();																				// count of interrupts given to the callback
+
+	/* registers */
+	int ReadRegister(uint8_t _reg, bool _cached=true);													// return the register value or < 0 on error, output registers from the shadow copy if _cached
+	int WriteRegister(uint8_t _reg, uint8_t _data);														// write the register, if it hasn't the value already, return 0 = okay, < 0 = i2c error
+	int WriteRegisterBlock(uint8_t _reg, const uint8_t _data[], int _count);							// write _count bytes beginning at _reg in one transfer (IOCON SEQOP: all to _reg), return like WriteRegister
+	int SyncRegisters();																				// read all registers into the shadow copy, return 0 = okay, < 0 = i2c error
+	unsigned Transactions();																			// count of i2c transactions since Init / ResetTransactions
+	unsigned SuppressedWrites();																		// count of register writes not sent, because the register has the value already
+	unsigned RecoveredErrors();																			// count of failed transfers, which worked after a retry, since Init / ResetTransactions
+	unsigned FailedTransfers();																			// count of transfers, which failed after HAL_I2C_RETRIES tries, since Init / ResetTransactions
+	void ResetTransactions();																			// set the count of i2c transactions, suppressed writes and errors to 0
+
+	/* bus */
+	void Scheduler(BusScheduler *_scheduler, int _priority=BUS_PRIO_NORMAL);							// queue the i2c writes on the bus scheduler (NULL = send directly)
+	void Pause(uint32_t _us);																			// wait _us µs, or pause the device on the scheduler without blocking
+	bool Scheduled();																					// true if the writes are queued on a scheduler
+
+private:
+	static void Alert(int _gpio, int _level, uint32_t _tick, void *_userdata);							// edge of the INT line, wakes the interrupt thread
+	void Worker();																						// interrupt thread: reads INTF and INTCAP and calls the callback
+	int Transfer(uint8_t _op, uint8_t _reg, const uint8_t _data[], int _count);							// one direct transfer (BUS_TRACE_READ / WRITE / BLOCK) with retries, return like the HAL
+	void Collect();																						// count the retries and failed writes of the scheduler, failed writes make the shadow copy unknown
+
+	HAL *_hal;																							// hardware backend (PiGPIO or simulation)
+	uint8_t addr;
+	int _handle;
+	unsigned _generation = 0;																			// reopens of the device known by this driver, see HAL::I2C_Reopen
+	bool _acquired = false;																				// true between Init and Term
+	uint8_t _shadow[MCP23008_REGISTERS];																// last value written to / read from the registers
+	uint16_t _shadow_valid = 0;																			// bit n = _shadow[n] is known
+	std::atomic<unsigned> _transactions{0};
+	std::atomic<unsigned> _suppressed{0};
+	std::atomic<unsigned> _recovered{0};																// transfers, which worked after a retry
+	std::atomic<unsigned> _failed{0};																	// transfers given up
+	BusScheduler *_scheduler = NULL;																	// NULL = i2c writes on the caller's thread
+	int _priority = BUS_PRIO_NORMAL;																	// priority of the scheduled writes
+	unsigned _scheduled_errors = 0;																		// BusScheduler::Errors taken by Collect
+	unsigned _scheduled_recovered = 0;																	// BusScheduler::Recovered taken by Collect
+	int _int_gpio = -1;																					// Pi GPIO of the INT line, -1 = no interrupt
+	MCP23008_callback _func = NULL;
+	void *_userdata = NULL;
+	std::atomic<unsigned> _interrupts{0};
+	std::recursive_mutex _lock;																			// guards the registers, the shadow copy and the handle
+	std::thread _int_thread;
+	std::mutex _int_lock;
+	std::condition_variable _int_wake;																	// the alert wakes the thread by _int_edge
+	bool _int_edge = false;
+	bool _int_stop = false;
+};
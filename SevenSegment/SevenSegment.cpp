@@ -5,41 +5,70 @@
 */
 
 #include "SevenSegment.h"																			// own header file
-#include <pigpio.h>																					// needed for GPIO comunication
 #include <unistd.h>																					// needed for sleep / usleep
 #include <stdio.h>																					// needed for printf / scanf
-#include <stdlib.h>																					// needed by the exit function
 
-SevenSegment::SevenSegment(int _i2c_addr){
-	if (gpioInitialise() < 0){																		// Initialise PiGPIO, if initialisation of pigpio failed
+SevenSegment::SevenSegment(int _i2c_addr, HAL *_hal){
+	SevenSegment::_hal = _hal;																		// i2c by this backend
+	SevenSegment::_addr = _i2c_addr;
+	if ((SevenSegment::_status=SevenSegment::_hal->Init()) < 0){									// Initialise PiGPIO, if initialisation of pigpio failed
 		printf("##############################################\n");									// print error message
 		printf("#              Can't use PIGPIO!             #\n");
 		printf("# Maybe PIGPIO is used by an other instance? #\n");
 		printf("##############################################\n");
-		exit (EXIT_FAILURE);																		// and exit the program with errorcode
-	}
-	else {																							// if initialisation passed
-		if ((SevenSegment::_handle=i2cOpen(1,_i2c_addr,0)) < 0) {									// try to open i2c comunication an if it fails
-			printf("##############################################\n");								// print error message
-			printf("#               Can't open I2C!              #\n");
-			printf("# Maybe device is used by an other instance? #\n");
-			printf("##############################################\n");
-			exit (EXIT_FAILURE);																	// and exit the program with errorcode
-		} 
-		else {																						// if comunication passed
-			// initialise the 7-segment display. see datasheet of HT13K66 page 32
-			SevenSegment::set_oscillator(true); 													// send command to activate the oscillator
-			SevenSegment::set_display(true); 														// send command to activate the display
-			SevenSegment::set_brightness(16); 														// send command to set the display brightness to min (with dimming level 16 = 1/16 pulse width)
+		return;																						// get_status returns the error
+	}
+	SevenSegment::_hal_ready = true;
+	for (int _try = 0; _try < HAL_I2C_RETRIES; _try++) {											// try to open i2c comunication, a glitch gets retries
+		if (_try > 0) {
+			SevenSegment::_hal->Delay(HAL_I2C_RETRY_US);
+		}
+		if ((SevenSegment::_status=SevenSegment::_handle=SevenSegment::_hal->I2C_Open(1,_i2c_addr)) >= 0) {
+			SevenSegment::_generation = SevenSegment::_hal->I2C_Generation(SevenSegment::_handle);
+			break;
 		}
 	}
+	if (SevenSegment::_status < 0) {																// if it fails
+		printf("##############################################\n");									// print error message
+		printf("#               Can't open I2C!              #\n");
+		printf("# Maybe device is used by an other instance? #\n");
+		printf("##############################################\n");
+		return;
+	}
+	// initialise the 7-segment display. see datasheet of HT13K66 page 32
+	if ((SevenSegment::_status=SevenSegment::send_command(CMD_SYSTEM_SETUP | OSCILLATOR_ON)) < 0) {	// send command to activate the oscillator, no answer even after the retries: no HT16K33
+		return;
+	}
+	SevenSegment::_status = 0;
+	SevenSegment::set_display(true); 																// send command to activate the display
+	SevenSegment::set_brightness(16); 																// send command to set the display brightness to min (with dimming level 16 = 1/16 pulse width)
 }
 
 SevenSegment::~SevenSegment(){
-	SevenSegment::set_display(false);																// send command to deactivate the display
-	SevenSegment::set_oscillator(false); 															// send command to deactivate the oscillator
-	i2cClose(SevenSegment::_handle);																// close i2c comunication
-	gpioTerminate();																				// terminate PiGPIO
+	SevenSegment::set_keyscan(0, NULL);																// stop the key scan thread
+	if (SevenSegment::_handle >= 0) {
+		SevenSegment::set_display(false);															// send command to deactivate the display
+		SevenSegment::set_oscillator(false); 														// send command to deactivate the oscillator
+		SevenSegment::set_scheduler(NULL);															// send the queued writes
+		SevenSegment::_hal->I2C_Close(SevenSegment::_handle);										// close i2c comunication
+	}
+	if (SevenSegment::_hal_ready == true) {
+		SevenSegment::_hal->Term();																	// terminate PiGPIO, if no other driver uses it
+	}
+}
+
+int SevenSegment::get_status(){
+	return SevenSegment::_status;
+}
+
+unsigned SevenSegment::get_recovered_errors(){
+	SevenSegment::collect_errors();
+	return SevenSegment::_recovered;
+}
+
+unsigned SevenSegment::get_failed_transfers(){
+	SevenSegment::collect_errors();
+	return SevenSegment::_failed;
 }
 
 void SevenSegment::set_oscillator(bool _on){
@@ -100,6 +129,7 @@ void SevenSegment::set_mirrored(bool _on){
 	else {																							// if _on is not true
 		SevenSegment::_mirrored = false;															// set _mirrored to false
 	}
+	SevenSegment::select_glyphs();																	// table for the new option
 }
 
 void SevenSegment::set_inverted(bool _on){
@@ -109,6 +139,7 @@ void SevenSegment::set_inverted(bool _on){
 	else {																							// if _on is not true
 		SevenSegment::_inverted=false;																// set _inverted to false
 	}
+	SevenSegment::select_glyphs();																	// table for the new option
 }
 
 void SevenSegment::set_collon(bool _on){
@@ -142,23 +173,12 @@ void SevenSegment::set_digit(int _pos, uint8_t _data, bool _decimal){
 			reg = 2* (_pos + offset);																// target register = (given _pos + offset) * 2 
 		}
 		
-		bitmask = SevenSegment::get_bitmask(_data);													//get LED bitmask for the hex value of _data
+		bitmask = SevenSegment::get_bitmask(_data);													// get LED bitmask of _data, already mirrored / inverted
 		
-		// recalculate bitmask with _decimal option
 		if (_decimal==true){																		// if _decimal option set
-			bitmask = bitmask | 0x80;																// add MSB to bitmask (bitmask or 0b10000000)
-		}
-		else {																						// if it not set
-			bitmask = bitmask & 0x7F;																// remove MSB from bitmask (bitmask and 0b01111111)
-		}
-		
-		// recalculate bitmask with invertet option
-		if (SevenSegment::_inverted==true){																		// if inverted option true
-			SevenSegment::send_data(reg,(0xFF - bitmask));											// invert bitmask by calculate (0xFF - bitmask) and send it to the calculated register
-		}
-		else {																						// if its not true
-			SevenSegment::send_data(reg,bitmask);													// send bitmask to the calculated register
+			bitmask = bitmask ^ GLYPH_DP;															// toggle the decimal point (the inverted tables have it on)
 		}
+		SevenSegment::send_data(reg,bitmask);														// send bitmask to the calculated register
 	}
 }
 
@@ -193,6 +213,122 @@ void SevenSegment::set_digit_raw(int _pos, uint8_t _data){
 	}
 }
 
+int SevenSegment::set_text(const char _text[]){
+	uint8_t _chars[4] = {' ', ' ', ' ', ' '};														// unused digits are blank
+	bool _decimal[4] = {false, false, false, false};
+	bool _collon = false;
+	int _pos = 0;																					// next digit
+	int _rest = 0;																					// characters, which didn't fit
+	
+	for (int i = 0; _text[i] != 0; i++) {
+		uint8_t _char = (uint8_t)_text[i];
+		if (_char == 0xC2) {																		// first byte of the UTF-8 "°" (0xC2 0xB0), the second one is the degree glyph
+			continue;
+		}
+		if (_char == ':') {																			// the collon sits between digit 1 and 2
+			_collon = true;
+			continue;
+		}
+		if (_char == '.' && _pos > 0 && _decimal[_pos-1] == false) {								// decimal point of the digit before
+			_decimal[_pos-1] = true;
+			continue;
+		}
+		if (_pos > 3) {
+			_rest++;
+			continue;
+		}
+		if (_char == '.') {																			// point without digit before: blank digit with point
+			_chars[_pos] = ' ';
+			_decimal[_pos] = true;
+		}
+		else {
+			_chars[_pos] = _char;
+		}
+		_pos++;
+	}
+	
+	for (int i = 0; i < 4; i++) {
+		SevenSegment::set_digit(i, _chars[i], _decimal[i]);										// one table load per digit
+	}
+	SevenSegment::set_collon(_collon);
+	return _rest;
+}
+
+int SevenSegment::show_int(int _value){
+	return SevenSegment::show_fixed(_value, 0);
+}
+
+int SevenSegment::show_fixed(int _value, int _decimals){
+	uint8_t _chars[4];
+	
+	if (_decimals < 0 || _decimals > 3 || SevenSegment::format_number(_value, _decimals + 1, _chars) == false) {	// at least one digit before the point
+		uint8_t _overflow[4] = {'-', '-', '-', '-'};
+		int _status = SevenSegment::show_frame(_overflow, -1, false);
+		return _status < 0 ? _status : 0;
+	}
+	return SevenSegment::show_frame(_chars, _decimals > 0 ? 3 - _decimals : -1, false);			// the point is behind the last digit before the decimals
+}
+
+int SevenSegment::show_hex(uint16_t _value, bool _zeros){
+	uint8_t _chars[4];
+	
+	for (int i = 3; i >= 0; i--) {																	// lowest nibble right
+		_chars[i] = _value & 0x0F;																	// 0 - 15 are the hex glyphs
+		_value >>= 4;
+		if (_zeros == false && _value == 0) {														// blank the leading zeros, but keep the last digit
+			for (int k = i - 1; k >= 0; k--) {
+				_chars[k] = ' ';
+			}
+			break;
+		}
+	}
+	return SevenSegment::show_frame(_chars, -1, false);
+}
+
+int SevenSegment::show_time(int _hours, int _minutes){
+	if (_hours < 0 || _hours > 99 || _minutes < 0 || _minutes > 59) {								// not a time
+		uint8_t _overflow[4] = {'-', '-', '-', '-'};
+		int _status = SevenSegment::show_frame(_overflow, -1, false);
+		return _status < 0 ? _status : 0;
+	}
+	uint8_t _chars[4] = {(uint8_t)(_hours / 10), (uint8_t)(_hours % 10), (uint8_t)(_minutes / 10), (uint8_t)(_minutes % 10)};
+	return SevenSegment::show_frame(_chars, -1, true);
+}
+
+bool SevenSegment::format_number(int _value, int _min_digits, uint8_t _chars[4]){
+	unsigned _abs = _value < 0 ? 0u - (unsigned)_value : (unsigned)_value;
+	int _pos = 3;																					// from the right
+	
+	for (int i = 0; i < 4; i++) {
+		_chars[i] = ' ';
+	}
+	do {
+		if (_pos < 0) {																				// too many digits
+			return false;
+		}
+		_chars[_pos--] = _abs % 10;																	// 0 - 9 are the digit glyphs
+		_abs /= 10;
+		_min_digits--;
+	} while (_abs > 0 || _min_digits > 0);
+	
+	if (_value < 0) {
+		if (_pos < 0) {																				// no digit left for the sign
+			return false;
+		}
+		_chars[_pos] = '-';
+	}
+	return true;
+}
+
+int SevenSegment::show_frame(const uint8_t _chars[4], int _point, bool _collon){
+	for (int i = 0; i < 4; i++) {
+		SevenSegment::set_digit(i, _chars[i], i == _point);										// only into the shadow RAM
+	}
+	SevenSegment::set_collon(_collon);
+	int _status = SevenSegment::commit();															// whole frame in one transaction
+	return _status < 0 ? _status : 1;																// 0 of commit: the frame is shown already
+}
+
 void SevenSegment::display_clear(){
 	for (int i = 0; i<=15; i++) {																	// for all 16 registers (0x00 - 0x0F)
 		SevenSegment::send_data(i,0x00);															// send data 0x00 to clear in the register
@@ -200,6 +336,16 @@ void SevenSegment::display_clear(){
 }
 
 int SevenSegment::display_selftest(bool _automatic){
+	BusScheduler *_scheduler = SevenSegment::_scheduler;
+	int _priority = SevenSegment::_priority;
+	
+	SevenSegment::set_scheduler(NULL);																// the selftest uses the i2c directly, so send the queued writes and leave the scheduler
+	int _result = SevenSegment::run_selftest(_automatic);
+	SevenSegment::set_scheduler(_scheduler, _priority);
+	return _result;
+}
+
+int SevenSegment::run_selftest(bool _automatic){
 	char _input[0];
 	
 	// test read/write to the data register
@@ -209,8 +355,8 @@ int SevenSegment::display_selftest(bool _automatic){
 		uint8_t _bits = 0b00000001;																	// start with 0x01
 		for (uint8_t _data = 0; _data <=7; _data++){												// do it 8 times
 			printf("Register: %d\twrite: %d\t",_register, (_bits << _data));
-			i2cWriteByteData(SevenSegment::_handle,_register,(_bits << _data));						// direct i2c access, independent from this class. send to _register the _bits moved by counter _data
-			uint8_t _read = i2cReadByteData(SevenSegment::_handle, _register);						// read the register directly. save value in _read.
+			SevenSegment::_hal->I2C_WriteByteData(SevenSegment::_handle,_register,(_bits << _data));						// direct i2c access, independent from this class. send to _register the _bits moved by counter _data
+			uint8_t _read = SevenSegment::_hal->I2C_ReadByteData(SevenSegment::_handle, _register);						// read the register directly. save value in _read.
 			printf("read: %d\t\t",_read);
 			if (_data <=3){																			// only for displaying at console
 				printf("\t");
@@ -223,8 +369,9 @@ int SevenSegment::display_selftest(bool _automatic){
 				printf("OK\n");
 			}
 		}
-		i2cWriteByteData(_handle,_register,0xFF);													// at the end with this register, set all LED's on, needet by next test
+		SevenSegment::_hal->I2C_WriteByteData(_handle,_register,0xFF);													// at the end with this register, set all LED's on, needet by next test
 	}
+	SevenSegment::_sent_valid = false;																// display RAM was written directly, send all at the next commit
 	printf("Register r/w test finished...\n");
 	
 	// test all LED's are ok
@@ -307,6 +454,7 @@ int SevenSegment::display_selftest(bool _automatic){
 	}
 	
 	SevenSegment::display_clear();																	// clear the display
+	SevenSegment::commit();
 	
 	if (_automatic==false){
 		printf("\n\nAll tests passed...\n");
@@ -318,126 +466,268 @@ int SevenSegment::display_selftest(bool _automatic){
 	return 0;																						// return no error
 }
 
-void SevenSegment::send_command(uint8_t _data){
-	i2cWriteByte(SevenSegment::_handle,_data);																	// send one byte of data to HT13K66 LED Driver
+void SevenSegment::set_scheduler(BusScheduler *_scheduler, int _priority){
+	std::lock_guard<std::recursive_mutex> _bus(SevenSegment::_bus_lock);
+	if (SevenSegment::_scheduler != NULL) {															// leave the old scheduler, after it has sent the queued writes
+		SevenSegment::collect_errors();
+		SevenSegment::_handle = SevenSegment::_scheduler->Detach(SevenSegment::_handle);			// the bus thread may have opened it again
+	}
+	SevenSegment::_scheduler = _scheduler;
+	SevenSegment::_priority = _priority;
+	if (_scheduler != NULL) {
+		_scheduler->Attach(SevenSegment::_handle, SevenSegment::_addr, BUS_MERGE_NEXT);				// the display RAM address increments by itself
+		SevenSegment::_scheduled_errors = _scheduler->Errors(SevenSegment::_handle);
+		SevenSegment::_scheduled_recovered = _scheduler->Recovered(SevenSegment::_handle);
+	}
+}
+
+int SevenSegment::set_keyscan(int _gpio, Key_callback _func, void *_userdata){
+	if (SevenSegment::_key_gpio >= 0) {																// stop the key scan of before
+		SevenSegment::_hal->GPIO_Alert(SevenSegment::_key_gpio, NULL, NULL);
+		SevenSegment::_key_gpio = -1;
+		{
+			std::lock_guard<std::mutex> _lock(SevenSegment::_key_lock);
+			SevenSegment::_key_stop = true;
+		}
+		SevenSegment::_key_wake.notify_all();
+		SevenSegment::_key_thread.join();
+		SevenSegment::send_command(CMD_ROWINT_SET | ROWINT_ROW);									// ROW/INT drives a row again
+	}
+	SevenSegment::_key_func = _func;
+	SevenSegment::_key_userdata = _userdata;
+	SevenSegment::_keys = 0;
+	SevenSegment::_key_reads = 0;
+	if (_func == NULL) {
+		return 0;
+	}
+
+	if (SevenSegment::_hal->GPIO_Mode(_gpio, HAL_INPUT) < 0 || SevenSegment::_hal->GPIO_Pull(_gpio, HAL_PUD_UP) < 0) {
+		return -1;
+	}
+	SevenSegment::_key_edge = true;																	// first read: keys held already and an old INT
+	SevenSegment::_key_stop = false;
+	if (SevenSegment::_hal->GPIO_Alert(_gpio, SevenSegment::key_alert, this) < 0) {
+		return -1;
+	}
+	SevenSegment::_key_gpio = _gpio;
+	SevenSegment::_key_thread = std::thread(&SevenSegment::key_run, this);
+	SevenSegment::send_command(CMD_ROWINT_SET | ROWINT_INT_LOW);									// last: an interrupt finds the alert
+	return 0;
+}
+
+uint64_t SevenSegment::get_keys(){
+	return SevenSegment::_keys;
+}
+
+unsigned SevenSegment::get_key_reads(){
+	return SevenSegment::_key_reads;
+}
+
+void SevenSegment::key_alert(int _gpio, int _level, uint32_t _tick, void *_userdata){
+	SevenSegment *_self = (SevenSegment *)_userdata;
+
+	if (_level != HAL_LOW) {																		// only the falling edge: a key was found by the scan
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> _lock(_self->_key_lock);
+		_self->_key_edge = true;
+	}
+	_self->_key_wake.notify_all();																	// no i2c on the alert thread
+}
+
+void SevenSegment::key_run(){
+	uint64_t _state = 0;																			// debounced keys
+	uint64_t _last = 0;																				// keys of the last read
+	bool _polling = false;																			// keys held or a change not confirmed: read without interrupt
+	std::unique_lock<std::mutex> _lock(SevenSegment::_key_lock);
+
+	while (SevenSegment::_key_stop == false) {
+		if (_polling == false) {
+			SevenSegment::_key_wake.wait(_lock, [this]{ return SevenSegment::_key_edge || SevenSegment::_key_stop; });
+			if (SevenSegment::_key_stop == true) {
+				break;
+			}
+		}
+		bool _edge = SevenSegment::_key_edge;
+		SevenSegment::_key_edge = false;
+		_lock.unlock();
+
+		if (_polling == true) {
+			SevenSegment::_hal->Delay(KEYSCAN_RELEASE_US);
+		}
+		uint64_t _keys = 0;
+		int _status = SevenSegment::read_keys(_keys, _polling == false && _edge == true);		// on an edge only, if the flag is set
+		_lock.lock();
+		if (_status <= 0) {
+			continue;																				// no key or i2c error: wait for the next edge or read
+		}
+
+		if (_keys == _last && _keys != _state) {													// the same keys twice: confirmed
+			uint64_t _changed = _keys ^ _state;
+			_state = _keys;
+			SevenSegment::_keys = _state;
+			_lock.unlock();
+			for (int i = 0; i < KEY_RAM_SIZE * 8; i++) {
+				if (_changed & ((uint64_t)1 << i)) {
+					SevenSegment::_key_func(i, (_keys >> i) & 1, SevenSegment::_key_userdata);
+				}
+			}
+			_lock.lock();
+		}
+		_last = _keys;
+		_polling = _keys != 0 || _keys != _state;													// held keys or a release to confirm
+	}
+}
+
+int SevenSegment::read_keys(uint64_t &_keys, bool _check_flag){
+	uint8_t _ram[KEY_RAM_SIZE];
+	int _status;
+	std::lock_guard<std::recursive_mutex> _bus(SevenSegment::_bus_lock);
+
+	if (_check_flag == true) {
+		int _flag;
+		if (SevenSegment::_scheduler != NULL) {														// scheduled: read after the queued writes
+			_flag = SevenSegment::_scheduler->Read(SevenSegment::_handle, CMD_INT_FLAG_ADDRESS);
+		}
+		else {
+			_flag = SevenSegment::transfer(BUS_TRACE_READ, CMD_INT_FLAG_ADDRESS, NULL, 1);
+		}
+		if (_flag <= 0) {																			// i2c error or no key found by the scan
+			return _flag;
+		}
+	}
+
+	if (SevenSegment::_scheduler != NULL) {															// scheduled: read after the queued writes
+		_status = SevenSegment::_scheduler->Read(SevenSegment::_handle, CMD_KEY_DATA_ADDRESS, _ram, KEY_RAM_SIZE);
+	}
+	else {
+		_status = SevenSegment::transfer(BUS_TRACE_READ, CMD_KEY_DATA_ADDRESS, _ram, KEY_RAM_SIZE);	// all 3 rows in one transaction, this clears INT
+	}
+	if (_status != KEY_RAM_SIZE) {
+		return _status < 0 ? _status : -1;
+	}
+	SevenSegment::_key_reads++;
+
+	_keys = 0;
+	for (int i = 0; i < KEY_RAM_SIZE; i++) {														// 2 bytes per row, K1 - K13
+		_keys |= (uint64_t)_ram[i] << (i * 8);
+	}
+	return 1;
+}
+
+int SevenSegment::send_command(uint8_t _data){
+	std::lock_guard<std::recursive_mutex> _bus(SevenSegment::_bus_lock);
+	if (SevenSegment::_scheduler != NULL) {															// scheduled: queue it
+		SevenSegment::_scheduler->Write(SevenSegment::_handle, BUS_REG_NONE, &_data, 1, SevenSegment::_priority);
+		return 0;
+	}
+	return SevenSegment::transfer(BUS_TRACE_COMMAND, 0, &_data, 1);									// send one byte of data to HT13K66 LED Driver
 }
 
 void SevenSegment::send_data(int _pos, uint8_t _data){
-	i2cWriteByteData(SevenSegment::_handle,_pos,_data);															// send _data to register at _pos
+	if (_pos >= 0 && _pos < DISPLAY_RAM_SIZE){														// only registers of the display RAM
+		SevenSegment::_ram[_pos] = _data;															// set _data to register at _pos in the shadow RAM
+	}
 }
 
-uint8_t SevenSegment::get_bitmask(uint8_t _data){
-	uint8_t bitmask = 0;
+int SevenSegment::commit(){
+	std::lock_guard<std::recursive_mutex> _bus(SevenSegment::_bus_lock);
+	int _last = -1;																					// last changed register
 	
-    if (SevenSegment::_mirrored == true) {
-		switch (_data) {
-			case 0:
-				bitmask = 0x3F;
-				break;
-			case 1:
-				bitmask = 0x30;
-				break;
-			case 2:
-				bitmask = 0x5B;
-				break;
-			case 3:
-				bitmask = 0x79;
-				break;
-			case 4:
-				bitmask = 0x74;
-				break;
-			case 5:
-				bitmask = 0x6D;
-				break;
-			case 6:
-				bitmask = 0x6F;
-				break;
-			case 7:
-				bitmask = 0x38;
-				break;
-			case 8:
-				bitmask = 0x7F;
-				break;
-			case 9:
-				bitmask = 0x7D;
-				break;
-			case 10:
-				bitmask = 0x7E;
-				break;
-			case 11:
-				bitmask = 0x67;
-				break;
-			case 12:
-				bitmask = 0x0F;
-				break;
-			case 13:
-				bitmask = 0x73;
-				break;
-			case 14:
-				bitmask = 0x4F;
-				break;
-			case 15:
-				bitmask = 0x4E;
-				break;
-			default:
-				bitmask = 0x00;
-				break;
+	SevenSegment::collect_errors();																	// a lost frame is sent again
+	for (int i = 0; i < DISPLAY_RAM_SIZE; i++) {													// for all 16 registers
+		if (SevenSegment::_sent_valid == false || SevenSegment::_ram[i] != SevenSegment::_sent[i]) {
+			_last = i;
 		}
 	}
+	if (_last < 0) {																				// nothing changed
+		return 0;
+	}
+	
+	if (SevenSegment::_scheduler != NULL) {															// scheduled: queue it
+		SevenSegment::_scheduler->Write(SevenSegment::_handle, 0x00, SevenSegment::_ram, _last + 1, SevenSegment::_priority);
+	}
 	else {
-		switch (_data) {
-			case 0:
-				bitmask = 0x3F;
-				break;
-			case 1:
-				bitmask = 0x06;
-				break;
-			case 2:
-				bitmask = 0x5B;
-				break;
-			case 3:
-				bitmask = 0x4F;
-				break;
-			case 4:
-				bitmask = 0x66;
-				break;
-			case 5:
-				bitmask = 0x6D;
-				break;
-			case 6:
-				bitmask = 0x7D;
-				break;
-			case 7:
-				bitmask = 0x07;
-				break;
-			case 8:
-				bitmask = 0x7F;
-				break;
-			case 9:
-				bitmask = 0x6F;
-				break;
-			case 10:
-				bitmask = 0x77;
-				break;
-			case 11:
-				bitmask = 0x7C;
-				break;
-			case 12:
-				bitmask = 0x39;
-				break;
-			case 13:
-				bitmask = 0x5E;
-				break;
-			case 14:
-				bitmask = 0x79;
-				break;
-			case 15:
-				bitmask = 0x71;
-				break;
-			default:
-				bitmask = 0x00;
-				break;
+		int _status = SevenSegment::transfer(BUS_TRACE_BLOCK, 0x00, SevenSegment::_ram, _last + 1);	// send register 0x00 up to the last change in one block, the address increments by itself
+		if (_status < 0) {																			// not shown: the next commit sends it again
+			return _status;
 		}
 	}
-	return bitmask;
+	for (int i = 0; i <= _last; i++) {
+		SevenSegment::_sent[i] = SevenSegment::_ram[i];												// this is shown now
+	}
+	SevenSegment::_sent_valid = true;
+	return 1;
+}
+
+int SevenSegment::transfer(uint8_t _op, uint8_t _reg, uint8_t _data[], int _count){
+	int _status = -1;
+	std::lock_guard<std::recursive_mutex> _bus(SevenSegment::_bus_lock);							// the key scan thread may retry at the same time
+	
+	if (SevenSegment::_handle < 0) {																// i2c was never opened
+		return SevenSegment::_handle;
+	}
+	for (int _try = 0; _try < HAL_I2C_RETRIES; _try++) {
+		if (_try > 0) {																				// bus glitch: wait and open the device again
+			SevenSegment::_hal->Delay(HAL_I2C_RETRY_US);
+			int _handle = SevenSegment::_hal->I2C_Reopen(SevenSegment::_handle, 1, SevenSegment::_addr, SevenSegment::_generation);
+			if (_handle >= 0) {
+				SevenSegment::_handle = _handle;
+			}
+		}
+		uint32_t _start = BusTrace::Enabled() ? SevenSegment::_hal->Tick() : 0;
+		if (_op == BUS_TRACE_COMMAND) {
+			_status = SevenSegment::_hal->I2C_WriteByte(SevenSegment::_handle, _data[0]);
+		}
+		else if (_op == BUS_TRACE_BLOCK) {
+			_status = SevenSegment::_hal->I2C_WriteBlockData(SevenSegment::_handle, _reg, _data, _count);
+		}
+		else if (_data == NULL) {																	// one register
+			_status = SevenSegment::_hal->I2C_ReadByteData(SevenSegment::_handle, _reg);
+		}
+		else {
+			_status = SevenSegment::_hal->I2C_ReadBlockData(SevenSegment::_handle, _reg, _data, _count);
+		}
+		if (BusTrace::Enabled()) {																	// tracing: measure the transaction
+			BusTrace::Record(SevenSegment::_addr, _op, _op == BUS_TRACE_COMMAND ? 1 : _count + 1, _status, _start, SevenSegment::_hal->Tick());
+		}
+		if (_status >= 0) {
+			if (_try > 0) {
+				SevenSegment::_recovered++;
+			}
+			return _status;
+		}
+	}
+	SevenSegment::_failed++;																		// given up, the caller gets the error
+	return _status;
+}
+
+void SevenSegment::collect_errors(){
+	std::lock_guard<std::recursive_mutex> _bus(SevenSegment::_bus_lock);
+	if (SevenSegment::_scheduler == NULL) {
+		return;
+	}
+	unsigned _errors = SevenSegment::_scheduler->Errors(SevenSegment::_handle);
+	if (_errors != SevenSegment::_scheduled_errors) {
+		SevenSegment::_failed += _errors - SevenSegment::_scheduled_errors;
+		SevenSegment::_scheduled_errors = _errors;
+		SevenSegment::_sent_valid = false;
+	}
+	unsigned _recovered = SevenSegment::_scheduler->Recovered(SevenSegment::_handle);
+	SevenSegment::_recovered += _recovered - SevenSegment::_scheduled_recovered;
+	SevenSegment::_scheduled_recovered = _recovered;
+}
+
+uint8_t SevenSegment::get_bitmask(uint8_t _data){
+	return SevenSegment::_glyphs[_data];															// one load from the table of the current options (see glyphs.h)
+}
+
+void SevenSegment::select_glyphs(){
+	if (SevenSegment::_mirrored == true) {
+		SevenSegment::_glyphs = SevenSegment::_inverted ? GLYPHS_MIRRORED_INVERTED.led : GLYPHS_MIRRORED.led;
+	}
+	else {
+		SevenSegment::_glyphs = SevenSegment::_inverted ? GLYPHS_INVERTED.led : GLYPHS_NORMAL.led;
+	}
 }
@@ -1,4 +1,15 @@
+#pragma once
+#include "../Common/hal.h"												// i2c of the Raspberry Pi or the simulation
+#include "../Common/bus_trace.h"										// optional tracing of the i2c transactions
+#include "../Common/bus_scheduler.h"									// optional queuing of the i2c writes
+#include "glyphs.h"														// LED tables of the characters
 #include <inttypes.h>													// needed for using int types like uint8_t
+#include <thread>														// key scan thread
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+typedef void (*Key_callback)(int _key, bool _pressed, void *_userdata);	// debounced key event: _key = row * 16 + column (K1 = 0 ... K13 = 12 of each row)
 
 class SevenSegment {
 	// commands
@@ -17,19 +28,36 @@ class SevenSegment {
 	#define BLINK_DISPLAY_2Hz			0x02
 	#define BLINK_DISPLAY_1Hz			0x04
 	#define BLINK_DISPLAY_halfHz		0x06
+	#define DISPLAY_RAM_SIZE			16										// bytes of the display RAM (0x00 - 0x0F)
+	#define ROWINT_ROW					0x00									// ROW/INT pin is a row driver output
+	#define ROWINT_INT_LOW				0x01									// ROW/INT pin is the interrupt output, active low
+	#define KEY_RAM_SIZE				6										// bytes of the key RAM (0x40 - 0x45), 3 rows of 13 keys
+	#define KEYSCAN_RELEASE_US			20000									// µs between the reads while keys are held, a release gives no interrupt
 	const uint8_t dimmer[16] = {0x0F,0x0E,0x0D,0x0C,0x0B,0x0A,0x09,0x08,0x07,0x06,0x05,0x04,0x03,0x02,0x01,0x00}; // used as dimmer, define the pulse width for the 7-segment LED display
 	
 	public:
-		SevenSegment(int _i2c_addr);
+		SevenSegment(int _i2c_addr, HAL *_hal=HAL::Default());
 		/* constructor of this class.
-		 * He will be initalise the PiGPIO. If this fails, program will be display an message and exit with errorcode "EXIT_FAILTURE".
-		 * Then it will be try to open an i2c comunication with the given _i2c_addr. If this fails, program will be display second message and exit with errorcode "EXIT_FAILTURE" too.
+		 * _hal is the hardware backend (PiGPIO or simulation, see Common/hal.h).
+		 * He will be initalise the HAL (once for all drivers, see Common/hal.h). If this fails, program will be display an message and get_status returns the error.
+		 * Then it will be try to open an i2c comunication with the given _i2c_addr (HAL_I2C_RETRIES tries). If this fails, program will be display second message, get_status returns the error too.
 		 * If all works, then the HT16K33 LED driver and the 7-segment display will be initalise. 
 		 * see Datasheet pg. 32
 		*/
 		~SevenSegment();
 		/* destructor of this class
-		 * He will stop the 7-segment display and the oscillator, close the i2c connection and terminate the PiGPIO. 
+		 * He will stop the 7-segment display and the oscillator, close the i2c connection and release the PiGPIO.
+		 * PiGPIO is terminated when no other driver uses it anymore.
+		*/
+		int get_status();
+		/* return value: 0 = display ready, < 0 = error of PiGPIO or i2c in the constructor (the program can go on without the display)
+		*/
+		unsigned get_recovered_errors();
+		/* return value: count of failed i2c transfers, which worked after a retry.
+		 * A failed direct transfer is tried again up to HAL_I2C_RETRIES times, the i2c handle is opened again before each retry.
+		*/
+		unsigned get_failed_transfers();
+		/* return value: count of i2c transfers given up after the retries
 		*/
 		void set_oscillator(bool _on);
 		/* This function will be set the internal oscillator from the HT16K33 LED driver to the state from _on. 
@@ -72,8 +100,8 @@ class SevenSegment {
 		 * it set the dats 0x02 to the data register 0x04 to enable or data 0x00 to disable the collon.
 		*/
 		void set_digit(int _pos, uint8_t _data, bool _decimal=false);
-		/* This function set on the digit on given _pos of the 7-segment display an hex value of given _data.
-		 * This function show into the get_bitmask function to convert the given _data to the raw data of the 7-Segment LEDs. 
+		/* This function set on the digit on given _pos of the 7-segment display an hex value or character of given _data.
+		 * This function show into the glyph table (see glyphs.h) to convert the given _data to the raw data of the 7-Segment LEDs. 
 		 * 
 		 * possible values:
 		 * _pos: 0 - 3 --> stands for the digit position. 
@@ -81,13 +109,15 @@ class SevenSegment {
 		 * 3 = the 4th digit of the 7-segment display
 		 * 
 		 * _data: 0x00 - 0x0F --> displays "0" - "F" on the display
-		 * all other _data: clear the digit, not a posible value.
+		 * _data: ' ' - '~' --> displays the character (letters as good as possible, '-', '_', '=', ...)
+		 * _data: GLYPH_DEGREE (0xB0) --> displays the degree sign
+		 * all other _data: clear the digit.
 		 * 
 		 * If _decimal true, the decimal point will be shown at this _pos.
 		*/
 		void set_digit_raw(int _pos, uint8_t _data);
 		/* This function set on the digit on given _pos of the 7-segment display the LED bitmask by given _data.
-		 * This function is NOT looking into get_bitmask() to get the LED raw data.
+		 * This function is NOT looking into the glyph table to get the LED raw data.
 		 * So you can every LED address directly to power on/off.
 		 * 0b11111111
 		 *   ^^^^^^^^
@@ -107,10 +137,81 @@ class SevenSegment {
 		 * 
 		 * _data: 0x00 - 0xFF --> set power on/off the LED of this digit
 		*/
+		int set_text(const char _text[]);
+		/* This function shows a text on the 4 digits, e.g. "-12.5", "Err" or "21°C".
+		 * A '.' sets the decimal point of the digit before, a ':' turns on the collon
+		 * and the UTF-8 "°" is shown as degree sign. Unused digits are cleared.
+		 * 
+		 * return value: count of characters, which didn't fit on the display (0 = all shown)
+		 * 
+		*/
+		int show_int(int _value);
+		/* This function shows the signed integer _value right aligned, e.g. "  42" or " -17".
+		 * possible values: -999 - 9999
+		 * 
+		 * show_int, show_fixed, show_hex and show_time render the whole frame into the shadow RAM
+		 * and send it by commit() in one transaction, the collon is only used by show_time.
+		 * A value, which doesn't fit, is shown as "----".
+		 * 
+		 * return value: 1 = value shown, 0 = overflow ("----" shown)
+		 *             < 0 = i2c error after the retries, nothing shown (the next commit sends the frame again)
+		 * 
+		*/
+		int show_fixed(int _value, int _decimals);
+		/* This function shows the fixed-point number _value / 10^_decimals right aligned, e.g. show_fixed(-125, 1) = "-12.5".
+		 * A leading 0 is shown before the decimal point: show_fixed(5, 2) = "0.05"
+		 * possible values: _decimals 0 - 3, the digits and the sign must fit into 4 digits
+		*/
+		int show_hex(uint16_t _value, bool _zeros=true);
+		/* This function shows _value as 4 hex digits "0000" - "FFFF", 
+		 * without the leading zeros (right aligned) if _zeros is false.
+		*/
+		int show_time(int _hours, int _minutes);
+		/* This function shows a clock time "HH:MM" with the collon.
+		 * possible values: _hours 0 - 99, _minutes 0 - 59
+		*/
 		void display_clear();
 		/* This function clear the display and all data registers.
 		 * 
 		*/
+		int commit();
+		/* This function sends the shadow display RAM to the HT16K33 LED driver.
+		 * set_collon, set_digit, set_digit_raw and display_clear only change the shadow RAM,
+		 * so nothing is shown before commit() is called.
+		 * All bytes from 0x00 up to the last changed byte are sent in one auto incrementing
+		 * block write, so a frame needs one i2c transaction instead of 4 - 16.
+		 * 
+		 * return values:
+		 * 1 = display RAM written
+		 * 0 = nothing changed since the last commit, nothing sent
+		 * < 0 = i2c error after the retries, the frame is sent again by the next commit
+		 * 
+		*/
+		void set_scheduler(BusScheduler *_scheduler, int _priority=BUS_PRIO_HIGH);
+		/* This function queues the commands and commits on the bus scheduler, which is shared with the LCD.
+		 * So a long Print of the LCD doesn't hold back the display. NULL sends on the caller's thread again.
+		 * The display has a high priority by default, its frames are short.
+		 * 
+		*/
+		int set_keyscan(int _gpio, Key_callback _func, void *_userdata=NULL);
+		/* This function starts the key scan of the HT16K33 (keys on the row / column pins of the JoyPi matrix).
+		 * The ROW/INT pin is set as interrupt output (active low) and wired to the Pi _gpio.
+		 * On its falling edge a thread reads the INT flag (0x60) and, only if it is set, the 6 bytes of the key RAM
+		 * in one block read. A release gives no interrupt, so while keys are held the key RAM is read every KEYSCAN_RELEASE_US.
+		 * A change is given to _func, when two reads in a row have the same keys (debounced), one call per key.
+		 * _func runs on the key scan thread, _func = NULL stops the key scan and sets ROW/INT as row output again.
+		 * 
+		 * return values:
+		 * 0 = okay
+		 * < 0 = GPIO of the Pi can't be used
+		 * 
+		*/
+		uint64_t get_keys();
+		/* return value: debounced keys, bit (row * 16 + column) is set while the key is pressed
+		*/
+		unsigned get_key_reads();
+		/* return value: count of key RAM reads since set_keyscan
+		*/
 		int display_selftest(bool _automatic=false);
 		/* This function makes a litte selftest for the HT16K33 LED driver and the 7-segment LED display.
 		 * First, it compare write and read bits to all data register. automatic test.
@@ -132,8 +233,41 @@ class SevenSegment {
 		 * */
 	
 	private:
-		int _handle;
-		/* id used by the i2c comunication
+		HAL *_hal;
+		/* hardware backend used for the i2c comunication
+		*/
+		int _handle = -1;
+		/* id used by the i2c comunication, < 0 = not opened
+		*/
+		unsigned _generation = 0;
+		/* reopens of the device known by this driver, see HAL::I2C_Reopen
+		*/
+		std::recursive_mutex _bus_lock;
+		/* guards the handle, the scheduler and the retries with reopen of transfer,
+		 * used by the key scan thread and the caller's thread (commit, send_command, set_scheduler)
+		*/
+		bool _hal_ready = false;
+		/* true if the HAL was initialised by the constructor
+		*/
+		int _status = 0;
+		/* result of the constructor, see get_status
+		*/
+		std::atomic<unsigned> _recovered{0};
+		std::atomic<unsigned> _failed{0};
+		/* counters of the retries, see get_recovered_errors
+		*/
+		uint8_t _addr;
+		/* i2c address of the HT16K33, used as device of the bus trace
+		*/
+		BusScheduler *_scheduler = NULL;
+		/* bus scheduler of the i2c writes, NULL = send on the caller's thread
+		*/
+		int _priority = BUS_PRIO_HIGH;
+		/* priority of the scheduled writes
+		*/
+		unsigned _scheduled_errors = 0;
+		unsigned _scheduled_recovered = 0;
+		/* BusScheduler::Errors and Recovered of the device taken by collect_errors
 		*/
 		bool _inverted = false;
 		/* is used for inverting the display
@@ -141,23 +275,91 @@ class SevenSegment {
 		bool _mirrored = false;
 		/* is used to mirrored the display (on the head and left to right)
 		*/
+		uint8_t _ram[DISPLAY_RAM_SIZE] = {0};
+		/* shadow of the display RAM, written by send_data
+		*/
+		uint8_t _sent[DISPLAY_RAM_SIZE] = {0};
+		/* display RAM as it was sent by the last commit
+		*/
+		bool _sent_valid = false;
+		/* false if the display RAM is unknown (after start or selftest), then commit sends all bytes
+		*/
 		
-		void send_command(uint8_t _data);
+		int send_command(uint8_t _data);
 		/* This function send command to the HT16K33 LED driver
 		 * 
 		 * Input value: _data were set by other functions
+		 * return value: 0 = okay (or queued), < 0 = i2c error after the retries
+		*/
+		int transfer(uint8_t _op, uint8_t _reg, uint8_t _data[], int _count);
+		/* This function does one direct i2c transfer with retries, traced if the bus trace is on
+		 * _op: BUS_TRACE_COMMAND (_data[0]), BUS_TRACE_BLOCK (write _data), BUS_TRACE_READ (_data = NULL: one register, else _count bytes into _data)
+		 * 
+		 * return value: like the HAL, < 0 = error after HAL_I2C_RETRIES tries
 		*/
 		void send_data(int _pos, uint8_t _data);
-		/* This function sends the _data to the _pos register to display it on the 7-segment display
+		/* This function sets the _data into the _pos register of the shadow RAM, commit() sends it to the 7-segment display
 		 * 
 		 * input value: _pos and _data were set by other functions (see set_digit functions)
 		*/
 		
 		uint8_t get_bitmask(uint8_t _data);
-		/* This function convert the given _data (0 - 15) to the LED bitmask for one digit (0 - F)
-		 * If mirrored true, there return an alternative bitmask.
+		/* This function convert the given _data (hex value or character) to the LED bitmask for one digit.
+		 * It reads the glyph table of the mirrored and inverted option, so no conversion is done here.
 		 * 
 		 * return value: 8bit bitmask for the display
 		 * 
 		*/
+		bool format_number(int _value, int _min_digits, uint8_t _chars[4]);
+		/* This function writes the decimal digits of _value right aligned into _chars (at least _min_digits digits, with leading zeros)
+		 * 
+		 * return value: true = fits into 4 digits
+		 * 
+		*/
+		int show_frame(const uint8_t _chars[4], int _point, bool _collon);
+		/* This function sets the 4 digits (glyph index) with the decimal point at digit _point (-1 = none) and commits the frame.
+		 * return 1 = shown (or shown already), < 0 = i2c error of commit
+		*/
+		void select_glyphs();
+		/* This function selects the glyph table for the _mirrored and _inverted option
+		*/
+		static void key_alert(int _gpio, int _level, uint32_t _tick, void *_userdata);
+		/* This function is called on an edge of ROW/INT, it wakes the key scan thread
+		*/
+		void key_run();
+		/* The key scan thread: reads and debounces the key RAM and calls the callback
+		*/
+		void collect_errors();
+		/* This function counts the retries and the queued writes, which failed on the bus thread. After a failed write the display RAM is unknown and the next commit sends all bytes.
+		*/
+		int run_selftest(bool _automatic);
+		/* The tests of display_selftest, with the i2c used directly
+		*/
+		int read_keys(uint64_t &_keys, bool _check_flag);
+		/* This function reads the key RAM into _keys. If _check_flag, it reads the INT flag first and the key RAM only if it is set.
+		 * 
+		 * return value: 1 = read, 0 = flag not set, < 0 = i2c error
+		 * 
+		*/
+		int _key_gpio = -1;
+		/* Pi GPIO of ROW/INT, -1 = no key scan
+		*/
+		Key_callback _key_func = NULL;
+		void *_key_userdata = NULL;
+		std::thread _key_thread;
+		std::mutex _key_lock;
+		std::condition_variable _key_wake;
+		/* the alert wakes the thread by _key_edge
+		*/
+		bool _key_edge = false;
+		bool _key_stop = false;
+		std::atomic<uint64_t> _keys{0};
+		/* debounced keys
+		*/
+		std::atomic<unsigned> _key_reads{0};
+		/* count of key RAM reads
+		*/
+		const uint8_t *_glyphs = GLYPHS_NORMAL.led;
+		/* glyph table used by get_bitmask
+		*/
 };
@@ -0,0 +1,157 @@
+/* Frame rate limited animations for the 7-segment LED display on the JoyPi.
+ *
+*/
+
+#include "animator.h"																				// own header file
+#include <stdio.h>																					// needed for snprintf
+
+SegmentAnimator::SegmentAnimator(SevenSegment &_display, HAL *_hal) : _display(_display){
+	SegmentAnimator::_hal = _hal;
+}
+
+SegmentAnimator::~SegmentAnimator(){
+	SegmentAnimator::stop();																		// the timer must not outlive the animator
+}
+
+int SegmentAnimator::play(const char *_frames[], int _count, int _fps, bool _loop){
+	SegmentAnimator::stop();
+	SegmentAnimator::_frames.clear();
+	for (int i = 0; i < _count; i++) {
+		SegmentAnimator::_frames.push_back(_frames[i]);											// copy, the caller may free the texts
+	}
+	return SegmentAnimator::start(_count, _fps, _loop, [this](int _index, std::string &_text){ _text = SegmentAnimator::_frames[_index]; });
+}
+
+int SegmentAnimator::scroll(const char _text[], int _fps, bool _loop){
+	std::vector<std::string> _cells(3, " ");														// start with 3 blank digits, so the first character comes in on the right
+
+	SegmentAnimator::stop();
+	for (int i = 0; _text[i] != 0; i++) {															// one cell per digit
+		uint8_t _char = (uint8_t)_text[i];
+		if (_char == 0xC2 || _char == ':') {														// first byte of the UTF-8 "°" and the collon are not shown
+			continue;
+		}
+		if (_char == '.') {
+			if (_cells.back().back() != '.') {
+				_cells.back() += '.';																// point of the digit before
+			}
+			else {
+				_cells.push_back(" .");																// point without digit: blank digit with point
+			}
+			continue;
+		}
+		_cells.push_back(std::string(1, (char)_char));
+	}
+	for (int i = 0; i < 4; i++) {
+		_cells.push_back(" ");																		// the text goes out on the left, the last frame is blank
+	}
+
+	SegmentAnimator::_frames.clear();
+	for (size_t i = 0; i + 4 <= _cells.size(); i++) {												// window of 4 digits
+		SegmentAnimator::_frames.push_back(_cells[i] + _cells[i+1] + _cells[i+2] + _cells[i+3]);
+	}
+	return SegmentAnimator::start(SegmentAnimator::_frames.size(), _fps, _loop, [this](int _index, std::string &_text){ _text = SegmentAnimator::_frames[_index]; });
+}
+
+int SegmentAnimator::count(int _from, int _to, int _fps){
+	int _step = (_to >= _from) ? 1 : -1;
+
+	SegmentAnimator::stop();
+	return SegmentAnimator::start((_to - _from) * _step + 1, _fps, false, [_from, _step](int _index, std::string &_text){
+		char _buffer[16];
+		int _value = _from + _index * _step;
+		if (_value < -999 || _value > 9999) {														// doesn't fit into 4 digits
+			_text = "----";
+			return;
+		}
+		snprintf(_buffer, sizeof(_buffer), "%4d", _value);											// right aligned
+		_text = _buffer;
+	});
+}
+
+void SegmentAnimator::stop(){
+	SegmentAnimator::_stop = true;
+	if (SegmentAnimator::_thread.joinable()) {
+		SegmentAnimator::_thread.join();
+	}
+	SegmentAnimator::_stop = false;
+}
+
+void SegmentAnimator::wait(){
+	if (SegmentAnimator::_loop == false && SegmentAnimator::_thread.joinable()) {					// a loop never ends by itself
+		SegmentAnimator::_thread.join();
+	}
+}
+
+bool SegmentAnimator::running(){
+	return SegmentAnimator::_running;
+}
+
+Animator_stats SegmentAnimator::get_stats(){
+	Animator_stats _stats;
+	uint64_t _elapsed = SegmentAnimator::_elapsed;
+
+	_stats.sent = SegmentAnimator::_sent;
+	_stats.unchanged = SegmentAnimator::_unchanged;
+	_stats.dropped = SegmentAnimator::_dropped;
+	_stats.frames = _stats.sent + _stats.unchanged;
+	_stats.fps = _elapsed > 0 ? _stats.frames * 1000000.0 / _elapsed : 0.0;
+	return _stats;
+}
+
+int SegmentAnimator::start(int _count, int _fps, bool _loop, std::function<void(int, std::string &)> _render){
+	if (_count <= 0 || _fps < 1 || _fps > ANIMATOR_MAX_FPS) {
+		return 0;
+	}
+	SegmentAnimator::_render = _render;
+	SegmentAnimator::_count = _count;
+	SegmentAnimator::_period = 1000000 / _fps;
+	SegmentAnimator::_loop = _loop;
+	SegmentAnimator::_sent = 0;
+	SegmentAnimator::_unchanged = 0;
+	SegmentAnimator::_dropped = 0;
+	SegmentAnimator::_elapsed = 0;
+	SegmentAnimator::_running = true;
+	SegmentAnimator::_thread = std::thread(&SegmentAnimator::run, this);
+	return 1;
+}
+
+void SegmentAnimator::run(){
+	uint32_t _last = SegmentAnimator::_hal->Tick();
+	uint64_t _elapsed = 0;																			// µs since the start, the tick wraps around after ~72 minutes
+	int _next = 0;																					// next frame to show
+	std::string _text;
+
+	while (SegmentAnimator::_stop == false) {
+		uint32_t _now = SegmentAnimator::_hal->Tick();
+		_elapsed += _now - _last;
+		_last = _now;
+		SegmentAnimator::_elapsed = _elapsed;
+
+		uint64_t _due = _elapsed / SegmentAnimator::_period;										// frame, which should be shown now
+		if (_due < (uint64_t)_next) {																// too early: sleep till the next frame
+			uint64_t _rest = (uint64_t)_next * SegmentAnimator::_period - _elapsed;
+			SegmentAnimator::_hal->Delay(_rest < ANIMATOR_SLICE ? _rest : ANIMATOR_SLICE);
+			continue;
+		}
+		if (SegmentAnimator::_loop == false && _due >= (uint64_t)SegmentAnimator::_count) {		// late at the end: the last frame is shown anyway
+			_due = SegmentAnimator::_count - 1;
+		}
+		SegmentAnimator::_dropped += _due - _next;													// the bus fell behind: skip the frames in between
+
+		SegmentAnimator::_render(SegmentAnimator::_loop ? _due % SegmentAnimator::_count : _due, _text);
+		SegmentAnimator::_display.set_text(_text.c_str());											// render into the shadow RAM
+		if (SegmentAnimator::_display.commit() > 0) {												// sent only if it differs from the shown frame
+			SegmentAnimator::_sent++;
+		}
+		else {
+			SegmentAnimator::_unchanged++;
+		}
+
+		_next = _due + 1;
+		if (SegmentAnimator::_loop == false && _next >= SegmentAnimator::_count) {				// last frame shown
+			break;
+		}
+	}
+	SegmentAnimator::_running = false;
+}
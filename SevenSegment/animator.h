@@ -0,0 +1,88 @@
+#pragma once
+#include "SevenSegment.h"												// the animated display
+#include <inttypes.h>													// needed for using int types like uint8_t
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <atomic>
+
+#define ANIMATOR_MAX_FPS			100										// max frames per second
+#define ANIMATOR_SLICE				20000									// max µs the timer sleeps, before it checks stop
+
+struct Animator_stats {
+	unsigned frames;													// frames shown (sent or equal to the shown one)
+	unsigned sent;														// frames sent to the display
+	unsigned unchanged;													// frames equal to the shown one, nothing sent
+	unsigned dropped;													// frames skipped, because the bus fell behind
+	float fps;															// achieved frames per second
+};
+
+class SegmentAnimator {
+	/* frame rate limited animations on the 7-segment display.
+	 * A timer thread shows the frames at the given frames per second.
+	 * If a frame is late (the bus fell behind), the frames in between are dropped
+	 * and the timer goes on with the frame, which is due now.
+	 * Every frame is rendered into the shadow RAM, commit() only sends it,
+	 * if it differs from the frame shown.
+	 *
+	 * Don't use the display while an animation runs.
+	 *
+	*/
+	public:
+		SegmentAnimator(SevenSegment &_display, HAL *_hal=HAL::Default());
+		/* constructor of this class, _hal is the time source (the same as the one of the display)
+		*/
+		~SegmentAnimator();
+		/* destructor of this class, stops the animation
+		*/
+		int play(const char *_frames[], int _count, int _fps, bool _loop=false);
+		/* This function starts an animation of _count frames. Every frame is a text for SevenSegment::set_text.
+		 *
+		 * return value: 1 = started, 0 = no frames or _fps not 1 - ANIMATOR_MAX_FPS
+		 *
+		*/
+		int scroll(const char _text[], int _fps, bool _loop=false);
+		/* This function scrolls _text from right to left through the display, one character per frame.
+		 * A '.' stays with the character before, "°" is one character.
+		*/
+		int count(int _from, int _to, int _fps);
+		/* This function counts from _from to _to (up or down), one number per frame, right aligned.
+		 * The frames are rendered when they are due, so long counts need no memory.
+		*/
+		void stop();
+		/* This function stops the animation and waits for the timer thread
+		*/
+		void wait();
+		/* This function waits till an animation without loop is done
+		*/
+		bool running();
+		/* return value: true while an animation runs
+		*/
+		Animator_stats get_stats();
+		/* return value: counters of the current or last animation
+		*/
+
+	private:
+		int start(int _count, int _fps, bool _loop, std::function<void(int, std::string &)> _render);
+		/* This function starts the timer thread, _render writes the text of frame n
+		*/
+		void run();
+		/* The timer thread
+		*/
+
+		SevenSegment &_display;
+		HAL *_hal;
+		std::thread _thread;
+		std::atomic<bool> _stop{false};
+		std::atomic<bool> _running{false};
+		std::function<void(int, std::string &)> _render;
+		std::vector<std::string> _frames;								// frames of play / scroll
+		int _count = 0;
+		uint32_t _period = 0;											// µs per frame
+		bool _loop = false;
+		std::atomic<unsigned> _sent{0};
+		std::atomic<unsigned> _unchanged{0};
+		std::atomic<unsigned> _dropped{0};
+		std::atomic<uint64_t> _elapsed{0};								// µs since the start
+};
@@ -2,28 +2,37 @@
  * 
  * commands:
  * compile: g++ -Wall -c SevenSegment.cpp "%f"
- * build: g++ -Wall -o "%e" SevenSegment.cpp "%f" -lpigpio
+ * build: g++ -Wall -o "%e" SevenSegment.cpp animator.cpp ../Common/hal_pigpio.cpp ../Common/pi_context.cpp ../Common/bus_trace.cpp ../Common/bus_scheduler.cpp "%f" -lpigpio -pthread
 */
 
 #include "SevenSegment.h"																			// own header file
+#include "animator.h"																				// frame rate limited animations
 #include <unistd.h>																					// needed for sleep / usleep
+#include <stdio.h>																					// needed for printf
 
 int main(int argc, char **argv) {
     SevenSegment driver(0x70);																		// initialise the 7-segemnt as driver
-    uint32_t count=0x00000000;																		// set count to 0 
+    SegmentAnimator animator(driver);																// animations on the driver
     
     driver.display_clear();																			// clear the 7-segment display
 	driver.set_brightness(16);																		// set brightnett to low (powersaving)
 	driver.set_blink(0);																			// no blinking
 	driver.set_collon(false);																		// no collon
+	driver.commit();																				// show the cleared display
 
-	while (count <= 65535) {
-		driver.set_digit(0,(((count/16)/16)/16)%16);												// extract the highest hex digit from count
-		driver.set_digit(1,((count/16)/16)%16);
-		driver.set_digit(2,(count/16)%16);
-		driver.set_digit(3,count%16);																// extract the lowest hex digit from count
-		count++;
-	}
+	animator.scroll("JoyPi", 4);																	// scroll a text with 4 frames per second
+	animator.wait();
+	animator.count(0, 500, 50);																		// count with 50 frames per second instead of flooding the bus
+	animator.wait();
+	
+	Animator_stats stats = animator.get_stats();
+	printf("%u frames sent, %u dropped, %.1f fps\n", stats.sent, stats.dropped, stats.fps);
+	
+	driver.show_hex(0xBEEF);																		// 4 hex digits in one transaction
+	sleep(2);
+	
+	driver.set_text("21°C");																		// letters and signs by the glyph table
+	driver.commit();
 	sleep(5);																						// wait 5 seconts till end
 	
     return 0;
@@ -0,0 +1,134 @@
+#pragma once
+#include <inttypes.h>													// used for the int types like uint8_t
+
+/* Glyph tables of the 7-segment display, built at compile time.
+ * One canonical table gives the LEDs of every character:
+ * 0b11111111
+ *   ^^^^^^^^
+ *   |||||||└ LED "A"													   A
+ *   ||||||└ LED "B"													   -
+ *   |||||└ LED "C"														F | | B
+ *   ||||└ LED "D"														 G -
+ *   |||└ LED "E"														E | | C
+ *   ||└ LED "F"														   - .
+ *   |└ LED "G"															   D DP
+ *   └ decimal point
+ *
+ * The index is the character: 0 - 15 are the hex digits (like set_digit always did),
+ * 32 - 127 the printable ASCII characters and 0xB0 the degree sign (Latin-1 / 2nd byte of UTF-8 "°").
+ * Characters, which a 7-segment display can't show, are blank.
+ *
+ * The mirrored table (display on the head) and the inverted tables are derived from it,
+ * so set_digit needs one table load per digit.
+*/
+
+#define GLYPH_DP					0x80									// decimal point
+#define GLYPH_DEGREE				0xB0									// index of the degree sign
+
+struct Glyph_table {
+	uint8_t led[256];
+};
+
+constexpr uint8_t glyph_canonical(int _char){
+	/* LEDs of _char on a normal display */
+	switch (_char){
+		case 0x0: case '0': return 0x3F;
+		case 0x1: case '1': return 0x06;
+		case 0x2: case '2': return 0x5B;
+		case 0x3: case '3': return 0x4F;
+		case 0x4: case '4': return 0x66;
+		case 0x5: case '5': case 'S': case 's': return 0x6D;
+		case 0x6: case '6': return 0x7D;
+		case 0x7: case '7': return 0x07;
+		case 0x8: case '8': return 0x7F;
+		case 0x9: case '9': return 0x6F;
+		case 0xA: case 'A': return 0x77;
+		case 0xB: case 'B': case 'b': return 0x7C;
+		case 0xC: case 'C': case '[': case '(': return 0x39;
+		case 0xD: case 'D': case 'd': return 0x5E;
+		case 0xE: case 'E': return 0x79;
+		case 0xF: case 'F': case 'f': return 0x71;
+		case 'a': return 0x5F;
+		case 'c': return 0x58;
+		case 'e': return 0x7B;
+		case 'G': return 0x3D;
+		case 'g': case 'q': case 'Q': return 0x67;
+		case 'H': case 'X': case 'x': return 0x76;
+		case 'h': return 0x74;
+		case 'I': case 'l': return 0x30;
+		case 'i': return 0x10;
+		case 'J': return 0x1E;
+		case 'j': return 0x0E;
+		case 'K': case 'k': return 0x75;
+		case 'L': return 0x38;
+		case 'M': case 'm': return 0x15;
+		case 'N': return 0x37;
+		case 'n': return 0x54;
+		case 'O': return 0x3F;
+		case 'o': return 0x5C;
+		case 'P': case 'p': return 0x73;
+		case 'R': case 'r': return 0x50;
+		case 'T': case 't': return 0x78;
+		case 'U': case 'V': return 0x3E;
+		case 'u': case 'v': return 0x1C;
+		case 'W': case 'w': return 0x2A;
+		case 'Y': case 'y': return 0x6E;
+		case 'Z': case 'z': return 0x5B;
+		case '-': return 0x40;
+		case '_': return 0x08;
+		case '=': return 0x48;
+		case '"': return 0x22;
+		case '\'': return 0x02;
+		case ']': case ')': return 0x0F;
+		case '?': return 0x53;
+		case '.': return GLYPH_DP;
+		case GLYPH_DEGREE: case '*': return 0x63;
+		default: return 0x00;											// blank
+	}
+}
+
+constexpr uint8_t glyph_mirror(uint8_t _led){
+	/* turn the LEDs on the head: A <-> D, B <-> E, C <-> F, G and the decimal point stay */
+	return (_led & 0xC0)
+		| ((_led & 0x01) << 3) | ((_led & 0x08) >> 3)					// A <-> D
+		| ((_led & 0x02) << 3) | ((_led & 0x10) >> 3)					// B <-> E
+		| ((_led & 0x04) << 3) | ((_led & 0x20) >> 3);					// C <-> F
+}
+
+constexpr Glyph_table glyph_build(bool _mirrored, bool _inverted){
+	/* table of all 256 characters, inverted tables have the decimal point on (set_digit toggles it) */
+	Glyph_table table = {};
+	for (int i = 0; i < 256; i++){
+		uint8_t led = glyph_canonical(i) & 0x7F;						// the decimal point is set by set_digit
+		if (_mirrored){
+			led = glyph_mirror(led);
+		}
+		if (_inverted){
+			led = 0xFF - led;
+		}
+		table.led[i] = led;
+	}
+	return table;
+}
+
+static constexpr Glyph_table GLYPHS_NORMAL = glyph_build(false, false);
+static constexpr Glyph_table GLYPHS_MIRRORED = glyph_build(true, false);
+static constexpr Glyph_table GLYPHS_INVERTED = glyph_build(false, true);
+static constexpr Glyph_table GLYPHS_MIRRORED_INVERTED = glyph_build(true, true);
+
+/* check the derived tables against the former hand written switch tables of get_bitmask (hex digits 0 - F) */
+constexpr uint8_t GLYPHS_HEX_NORMAL[16] = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F, 0x77, 0x7C, 0x39, 0x5E, 0x79, 0x71};
+constexpr uint8_t GLYPHS_HEX_MIRRORED[16] = {0x3F, 0x30, 0x5B, 0x79, 0x74, 0x6D, 0x6F, 0x38, 0x7F, 0x7D, 0x7E, 0x67, 0x0F, 0x73, 0x4F, 0x4E};
+
+constexpr bool glyph_check(const Glyph_table &_table, const uint8_t _expected[16]){
+	for (int i = 0; i < 16; i++){
+		if (_table.led[i] != _expected[i]){
+			return false;
+		}
+	}
+	return true;
+}
+
+static_assert(glyph_check(GLYPHS_NORMAL, GLYPHS_HEX_NORMAL), "normal glyphs differ from the hex digits of get_bitmask");
+static_assert(glyph_check(GLYPHS_MIRRORED, GLYPHS_HEX_MIRRORED), "mirrored glyphs differ from the hex digits of get_bitmask");
+static_assert(GLYPHS_INVERTED.led[8] == 0x80 && GLYPHS_MIRRORED_INVERTED.led[1] == 0xCF, "inverted glyphs differ from 0xFF - bitmask");
@@ -0,0 +1,36 @@
+/* example for the whole JoyPi board
+ * 
+ * commands:
+ * build: g++ -Wall -o "%e" JoyPi.cpp DHT11/dht.cpp LCD/lcd_mcp23008.cpp MCP23008/mcp23008.cpp SevenSegment/SevenSegment.cpp Common/hal_pigpio.cpp Common/pi_context.cpp Common/bus_trace.cpp Common/bus_scheduler.cpp "%f" -lpigpio -pthread
+*/
+
+#include "JoyPi.h"																					// the whole board
+#include <stdio.h>																					// needed for printf / snprintf
+
+int main(){
+	JoyPi board;																					// DHT11 on pin 4, LCD and 7-segment display
+	int seconds = 0;
+
+	board.Every("values", 1000000, [&]{																// once a second: show the values, the tasks of the board send them
+		DHT_sample sample;
+		char text[17];
+		if (board.Sensor().Get_Sample(sample) == 1) {
+			snprintf(text, sizeof(text), "%.1f C  %.0f %%", sample.temp, sample.humi);
+		}
+		else {
+			snprintf(text, sizeof(text), "no reading");
+		}
+		board.Lcd().WriteLine(text, 0);
+		board.Segment().show_time(seconds / 60, seconds % 60);
+		seconds++;
+	});
+
+	board.Run(60000000);																			// one minute on this thread
+
+	for (int i = 0; i < board.Tasks(); i++) {
+		JoyPi_task_stats stats;
+		board.Stats(i, stats);
+		printf("%-8s %u runs, %u deadline misses, %u skipped, max %u us late\n", stats.name, stats.runs, stats.misses, stats.skipped, stats.max_late);
+	}
+	return 0;
+}